@@ -0,0 +1,31 @@
+##*****************************************************************************
+## $Id$
+##*****************************************************************************
+#  SYNOPSIS:
+#    AC_ATOMIC
+#
+#  DESCRIPTION:
+#    Check whether the compiler provides the __atomic builtins used
+#    for lock-free counters.  Without them a mutex is used instead.
+#
+#  WARNINGS:
+#    This macro must be placed after AC_PROG_CC or equivalent.
+##*****************************************************************************
+
+AC_DEFUN([AC_ATOMIC],
+[AC_CACHE_CHECK([for __atomic builtins], ac_cv_have_atomic_builtins,
+[
+  AC_LINK_IFELSE([AC_LANG_PROGRAM([[]],
+   [[long x = 0; long y;
+     y = __atomic_add_fetch (&x, 1, __ATOMIC_RELAXED);
+     y = __atomic_exchange_n (&x, y, __ATOMIC_ACQ_REL);
+     __atomic_store_n (&x, y, __ATOMIC_RELEASE);
+     return (int) __atomic_load_n (&x, __ATOMIC_ACQUIRE);]])],
+   [ac_cv_have_atomic_builtins=yes],[ac_cv_have_atomic_builtins=no])
+])
+
+if test "$ac_cv_have_atomic_builtins" = "yes"; then
+  AC_DEFINE([HAVE_ATOMIC_BUILTINS], [1],
+            [Define if the compiler provides __atomic builtins.])
+fi
+])
@@ -9,6 +9,7 @@
 #
 #  DESCRIPTION:
 #    Checks for poll() and select() and determines which to use.
+#    Also checks for epoll, used for persistent poll sets if available.
 #
 #  WARNINGS:
 #    This macro must be placed after AC_PROG_CC or equivalent.
@@ -29,4 +30,14 @@ AC_DEFUN([AC_POLLSELECT],
                        get a real operating system!!!])
      fi
    fi
+
+   dnl  Poll sets fall back to poll() for fds that epoll refuses
+   ac_have_epoll=no
+   if test "$ac_have_poll" = "yes" ; then
+      AC_CHECK_HEADER([sys/epoll.h],
+         [AC_CHECK_FUNC([epoll_create1], [ac_have_epoll=yes])])
+   fi
+   if test "$ac_have_epoll" = "yes" ; then
+      AC_DEFINE([HAVE_EPOLL], [1], [Define to use epoll for poll sets])
+   fi
 ])
@@ -76,6 +76,21 @@ void err_no_strip_domain ()
     keep_host_domain = true;
 }
 
+/*
+ * Copy [hostname] into [buf] of [len] bytes as printed by the %S
+ *  conversion, i.e. with any domain removed.
+ */
+void err_host_label(char *buf, int len, const char *hostname)
+{
+    char *q;
+
+    snprintf(buf, len, "%s", hostname);
+    if (  !isdigit(*buf)
+       && !keep_host_domain
+       && (q = strchr(buf, '.')))
+        *q = '\0';
+}
+
 /*
  * Free heap storage allocated by err_init()
  */
@@ -101,7 +116,6 @@ void err_cleanup(void)
 static void _verr(FILE * stream, char *format, va_list ap)
 {
     char *buf = NULL;
-    char *q;
     int percent = 0;
     char tmpstr[LINEBUFSIZE];
 
@@ -114,11 +128,7 @@ static void _verr(FILE * stream, char *format, va_list ap)
             if (*format == 's') {       /* %s - string */
                 xstrcat(&buf, va_arg(ap, char *));
             } else if (*format == 'S') {        /* %S - string, trunc */
-                snprintf(tmpstr, sizeof(tmpstr), "%s", va_arg(ap, char *));
-                if (  !isdigit(*tmpstr) 
-                   && !keep_host_domain 
-                   && (q = strchr(tmpstr, '.')))
-                    *q = '\0';
+                err_host_label(tmpstr, sizeof(tmpstr), va_arg(ap, char *));
                 xstrcat(&buf, tmpstr);
             } else if (*format == 'z') {        /* %z - same as %.3d */
                 snprintf(tmpstr, sizeof(tmpstr), "%.3d", va_arg(ap, int));
@@ -32,6 +32,7 @@
 
 void err_init(char *);
 void err_no_strip_domain();
+void err_host_label(char *, int, const char *);
 void err(char *, ...);
 void out(char *, ...);
 void errx(char *, ...);
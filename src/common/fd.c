@@ -204,6 +204,34 @@ fd_write_n (int fd, void *buf, size_t n)
 }
 
 
+ssize_t
+fd_writev_n (int fd, struct iovec *iov, int iovcnt)
+{
+    ssize_t n = 0;
+    ssize_t nwritten;
+
+    while (iovcnt > 0) {
+        if ((nwritten = writev (fd, iov, iovcnt)) < 0) {
+            if (errno == EINTR)
+                continue;
+            else
+                return (-1);
+        }
+        n += nwritten;
+        while (iovcnt > 0 && nwritten >= (ssize_t) iov->iov_len) {
+            nwritten -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (nwritten > 0) {
+            iov->iov_base = (char *) iov->iov_base + nwritten;
+            iov->iov_len -= nwritten;
+        }
+    }
+    return (n);
+}
+
+
 ssize_t
 fd_read_line (int fd, void *buf, size_t maxlen)
 {
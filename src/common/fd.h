@@ -34,6 +34,7 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 
@@ -109,6 +110,13 @@ ssize_t fd_write_n (int fd, void *buf, size_t n);
  *  Returns the number of bytes written, or -1 on error.
  */
 
+ssize_t fd_writev_n (int fd, struct iovec *iov, int iovcnt);
+/*
+ *  Writes all data described by the [iovcnt] entries of [iov] to [fd].
+ *  The [iov] array is modified if a partial write occurs.
+ *  Returns the number of bytes written, or -1 on error.
+ */
+
 ssize_t fd_read_line (int fd, void *buf, size_t maxlen);
 /*
  *  Reads at most [maxlen-1] bytes up to a newline from [fd] into [buf].
@@ -0,0 +1,125 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include "hist.h"
+#include "xatomic.h"
+#include "xmalloc.h"
+
+#define HIST_SUB_BITS     5
+#define HIST_SUB_BUCKETS  (1 << HIST_SUB_BITS)
+#define HIST_NBUCKETS     ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+struct hist {
+    long count;
+    long bucket[HIST_NBUCKETS];
+};
+
+/*
+ *  Values below HIST_SUB_BUCKETS get a bucket each. Above that, the
+ *   bucket is chosen by the position of the most significant bit and
+ *   the HIST_SUB_BITS bits below it.
+ */
+static int _bucket (unsigned long long v)
+{
+    int msb = HIST_SUB_BITS;
+
+    if (v < HIST_SUB_BUCKETS)
+        return ((int) v);
+    while (msb < 63 && (v >> (msb + 1)))
+        msb++;
+    return ((msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS
+            + (int) ((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1)));
+}
+
+/*
+ *  Midpoint of the range of values in bucket `i'.
+ */
+static unsigned long long _bucket_value (int i)
+{
+    int shift;
+    unsigned long long low;
+
+    if (i < HIST_SUB_BUCKETS)
+        return ((unsigned long long) i);
+    shift = i / HIST_SUB_BUCKETS - 1;
+    low = (unsigned long long) (HIST_SUB_BUCKETS + i % HIST_SUB_BUCKETS)
+          << shift;
+    return (low + ((1ULL << shift) >> 1));
+}
+
+hist_t hist_create (void)
+{
+    return ((hist_t) Malloc (sizeof (struct hist)));
+}
+
+void hist_destroy (hist_t h)
+{
+    Free ((void **) &h);
+}
+
+void hist_add (hist_t h, unsigned long long v)
+{
+    xatomic_add (&h->bucket[_bucket (v)], 1);
+    xatomic_add (&h->count, 1);
+}
+
+long hist_count (hist_t h)
+{
+    return (xatomic_load (&h->count));
+}
+
+unsigned long long hist_percentile (hist_t h, double pct)
+{
+    long count = hist_count (h);
+    long seen = 0;
+    long target;
+    int i;
+
+    if (count == 0)
+        return (0);
+
+    target = (long) (count * pct / 100.0 + 0.999999);
+    if (target < 1)
+        target = 1;
+    if (target > count)
+        target = count;
+
+    for (i = 0; i < HIST_NBUCKETS; i++) {
+        if ((seen += xatomic_load (&h->bucket[i])) >= target)
+            return (_bucket_value (i));
+    }
+    return (_bucket_value (HIST_NBUCKETS - 1));
+}
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
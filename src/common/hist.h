@@ -0,0 +1,64 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _HIST_H
+#define _HIST_H
+
+/*
+ *  Latency histograms with logarithmic buckets.
+ *
+ *  Each power of two is split into HIST_SUB_BUCKETS linear buckets,
+ *   so any percentile is reported to within about 3% of the true
+ *   value over the whole 64-bit range, in constant memory. Values are
+ *   added with atomic increments and may be added from any thread.
+ */
+
+typedef struct hist *hist_t;
+
+/*
+ *  Create an empty histogram. Aborts on allocation failure.
+ */
+hist_t hist_create (void);
+
+void hist_destroy (hist_t h);
+
+/*
+ *  Record value `v'.
+ */
+void hist_add (hist_t h, unsigned long long v);
+
+/*
+ *  Number of values recorded.
+ */
+long hist_count (hist_t h);
+
+/*
+ *  Return the value below which `pct' percent of the recorded values
+ *   fall (e.g. pct = 99.9 for p999), or 0 if the histogram is empty.
+ */
+unsigned long long hist_percentile (hist_t h, double pct);
+
+#endif /* !_HIST_H */
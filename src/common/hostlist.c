@@ -43,6 +43,8 @@
 #include <assert.h>
 #include <errno.h>
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <sys/param.h>
 #include <unistd.h>
 
@@ -100,9 +102,6 @@
 /* max host suffix value */
 #define MAX_HOST_SUFFIX 1<<25
 
-/* max number of ranges that will be processed between brackets */
-#define MAX_RANGES    10240    /* 10K Ranges */
-
 /* size of internal hostname buffer (+ some slop), hostnames will probably
  * be truncated if longer than MAXHOSTNAMELEN */
 #ifndef MAXHOSTNAMELEN
@@ -172,9 +171,13 @@ struct hostlist {
 };
 
 
-/* a hostset is a wrapper around a hostlist */
+/* a hostset is a wrapper around a sorted, unique hostlist
+ * with an index for fast lookup (see "hostset index" below) */
+struct hostset_index;
+
 struct hostset {
     hostlist_t hl;
+    struct hostset_index *idx;
 };
 
 struct hostlist_iterator {
@@ -238,8 +241,12 @@ static hostlist_t _hostlist_create_bracketed(const char *, char *, char *);
 static int         hostlist_resize(hostlist_t, size_t);
 static int         hostlist_expand(hostlist_t);
 static int         hostlist_push_range(hostlist_t, hostrange_t);
+static int         hostlist_append_hr(hostlist_t, const char *, int,
+                                      unsigned long, unsigned long, int);
+#if WANT_RECKLESS_HOSTRANGE_EXPANSION
 static int         hostlist_push_hr(hostlist_t, char *, unsigned long,
                                     unsigned long, int);
+#endif
 static int         hostlist_insert_range(hostlist_t, hostrange_t, int);
 static void        hostlist_delete_range(hostlist_t, int n);
 static void        hostlist_coalesce(hostlist_t hl);
@@ -248,12 +255,16 @@ static hostlist_t _hostlist_create(const char *, char *, char *);
 static void        hostlist_shift_iterators(hostlist_t, int, int, int);
 static int        _attempt_range_join(hostlist_t, int);
 static int        _is_bracket_needed(hostlist_t, int);
+static int        _hostlist_radix_sort(hostlist_t, int);
+static unsigned long _pow10(int);
+static int        _num_digits(unsigned long);
+static int        _ulong_digits(void);
+static unsigned long _family_hash(const char *, int, int);
 
 static hostlist_iterator_t hostlist_iterator_new(void);
 static void               _iterator_advance(hostlist_iterator_t);
 static void               _iterator_advance_range(hostlist_iterator_t);
 
-static int hostset_find_host(hostset_t, const char *);
 
 /* ------[ macros ]------ */
 
@@ -1112,12 +1123,14 @@ static int hostlist_resize(hostlist_t hl, size_t newsize)
     return 1;
 }
 
-/* Resize hostlist by one HOSTLIST_CHUNK
+/* Grow hostlist by at least one HOSTLIST_CHUNK, doubling the size of
+ * large lists so that pushing n ranges costs O(n) rather than O(n^2).
  * Assumes that hostlist hl is locked by caller
  */
 static int hostlist_expand(hostlist_t hl)
 {
-    if (!hostlist_resize(hl, hl->size + HOSTLIST_CHUNK))
+    size_t grow = hl->size > HOSTLIST_CHUNK ? hl->size : HOSTLIST_CHUNK;
+    if (!hostlist_resize(hl, hl->size + grow))
         return 0;
     else
         return 1;
@@ -1163,6 +1176,7 @@ static int hostlist_push_range(hostlist_t hl, hostrange_t hr)
 
 
 
+#if WANT_RECKLESS_HOSTRANGE_EXPANSION
 /* Same as hostlist_push_range() above, but prefix, lo, hi, and width
  * are passed as args 
  */
@@ -1175,6 +1189,7 @@ hostlist_push_hr(hostlist_t hl, char *prefix, unsigned long lo,
     hostrange_destroy(hr);
     return retval;
 }
+#endif
 
 /* Insert a range object hr into position n of the hostlist hl
  * Assumes that hl->mutex is already held by calling process
@@ -1384,110 +1399,254 @@ hostlist_t _hostlist_create(const char *hostlist, char *sep, char *r_op)
 
 #endif                /* WANT_RECKLESS_HOSTRANGE_EXPANSION */
 
+/*
+ *  Bracketed hostlist parsing.
+ *
+ *  Each token is split into literal text and bracketed range lists,
+ *   e.g. "rack[1-200]-node[001-512]", and expands to the cartesian
+ *   product of its range lists. Range lists are parsed in place from
+ *   a single copy of the input into arrays that are reused for every
+ *   token. Hosts are not materialized one by one: the last range list
+ *   of a token is pushed as hostranges under each expanded prefix, so
+ *   the example above costs 200 ranges, not 102400 hosts. Only a token
+ *   with text after its last bracket, e.g. "n[1-4]-ib", must be
+ *   expanded host by host.
+ */
 struct _range {
     unsigned long lo, hi;
     int width;
 };
 
-/* Grab a single range from str 
- * returns 1 if str contained a valid number or range,
- *         0 if conversion of str to a range failed.
+struct _bracket {
+    const char *lit;        /* literal text preceding the bracket      */
+    int litlen;
+    int first;              /* ranges of this bracket in ranges[]      */
+    int n;
+};
+
+struct _parser {
+    hostlist_t hl;
+    struct _range *ranges;
+    int nranges, rangesize;
+    struct _bracket *br;
+    int nbr, brsize;
+    const char *suffix;     /* text after the last bracket             */
+    char *name;             /* buffer in which hostnames are built     */
+    size_t namesize;
+};
+
+/* Grow *array of *size elements of size len to hold at least n.
+ * Returns 0, or -1 if memory could not be allocated.
  */
-static int _parse_single_range(const char *str, struct _range *range)
+static int _parser_grow(void **array, int *size, int n, size_t len)
 {
-    char *p, *q;
-    char *orig = strdup(str);
-    if (!orig) 
-        seterrno_ret(ENOMEM, 0);
+    void *new;
+    int newsize = *size ? *size : 16;
 
-    if ((p = strchr(str, '-'))) {
-        *p++ = '\0';
-        if (*p == '-')     /* do NOT allow negative numbers */
-            goto error;
+    if (n <= *size)
+        return 0;
+    while (newsize < n)
+        newsize *= 2;
+    if (!(new = realloc(*array, newsize * len)))
+        seterrno_ret(ENOMEM, -1);
+    *array = new;
+    *size = newsize;
+    return 0;
+}
+
+/* Parse an unsigned decimal number of at most _ulong_digits() digits
+ * from the len chars at str. Returns the number of digits, or 0.
+ */
+static int _parse_ulong(const char *str, int len, unsigned long *valp)
+{
+    unsigned long v = 0;
+    int n;
+
+    for (n = 0; n < len && isdigit((int) str[n]); n++) {
+        if (n == _ulong_digits())
+            return 0;
+        v = v * 10 + (str[n] - '0');
     }
-    range->lo = strtoul(str, &q, 10);
-    if (q == str) 
-        goto error;
+    *valp = v;
+    return n;
+}
+
+/* Parse a single range "lo" or "lo-hi" of len chars at str.
+ * Blanks around the range are ignored.
+ * Returns 1 on success, 0 with errno set on failure.
+ */
+static int _parse_single_range(const char *str, int len, struct _range *range)
+{
+    const char *orig = str;
+    int origlen = len;
+    int n;
 
-    range->hi = (p && *p) ? strtoul(p, &q, 10) : range->lo;
+    while (len > 0 && isspace((int) *str)) {
+        str++;
+        len--;
+    }
+    while (len > 0 && isspace((int) str[len - 1]))
+        len--;
 
-    if (q == p || *q != '\0') 
+    if (!(n = _parse_ulong(str, len, &range->lo)))
         goto error;
+    range->width = n;
+    range->hi = range->lo;
+
+    if (n < len) {
+        if (str[n++] != '-')
+            goto error;
+        if (n < len) {
+            int m = _parse_ulong(str + n, len - n, &range->hi);
+            if (m == 0 || n + m != len)
+                goto error;
+        }
+    }
 
-    if (range->lo > range->hi) 
+    if (range->lo > range->hi)
         goto error;
 
-    if (range->hi - range->lo + 1 > MAX_RANGE ) {
-        _error(__FILE__, __LINE__, "Too many hosts in range `%s'", orig);
-        free(orig);
+    if (range->hi - range->lo + 1 > MAX_RANGE) {
+        _error(__FILE__, __LINE__, "Too many hosts in range `%.*s'",
+               origlen, orig);
         seterrno_ret(ERANGE, 0);
     }
-
-    free(orig);
-    range->width = strlen(str);
     return 1;
 
   error:
-    _error(__FILE__, __LINE__, "Invalid range: `%s'", orig);
-    free(orig);
+    _error(__FILE__, __LINE__, "Invalid range: `%.*s'", origlen, orig);
     seterrno_ret(EINVAL, 0);
 }
 
-
 /*
- * Convert 'str' containing comma separated digits and ranges into an array
- *  of struct _range types (max 'len' elements).  
+ * Append the comma separated digits and ranges in the len chars at str
+ *  to the ranges of parser ps.
  *
- * Return number of ranges created, or -1 on error.
+ * Return number of ranges added, or -1 on error.
  */
-static int _parse_range_list(char *str, struct _range *ranges, int len)
+static int _parse_range_list(struct _parser *ps, const char *str, int len)
 {
-    char *p;
+    const char *end = str + len;
     int count = 0;
 
-    while (str) {
-        if (count == len)
+    for (;;) {
+        const char *p = memchr(str, ',', end - str);
+        if (p == NULL)
+            p = end;
+        if (_parser_grow((void **) &ps->ranges, &ps->rangesize,
+                         ps->nranges + 1, sizeof(struct _range)) < 0)
+            return -1;
+        if (!_parse_single_range(str, p - str, &ps->ranges[ps->nranges]))
             return -1;
-        if ((p = strchr(str, ',')))
-            *p++ = '\0';
-        if (!_parse_single_range(str, &ranges[count++])) 
-            return -1;  
-        str = p;
+        ps->nranges++;
+        count++;
+        if (p == end)
+            return count;
+        str = p + 1;
     }
-    return count;
 }
 
-static void
-_push_range_list(hostlist_t hl, char *pfx, struct _range *rng,
-             int n)
+/* Split tok into literals and bracketed range lists, and parse the
+ * range lists. Returns the number of brackets, 0 if tok is a plain
+ * hostname, or -1 on error.
+ */
+static int _parse_brackets(struct _parser *ps, const char *tok)
 {
-    int i;
-    for (i = 0; i < n; i++) {
-        hostlist_push_hr(hl, pfx, rng->lo, rng->hi, rng->width);
-        rng++;
+    const char *p, *q;
+    unsigned long nhosts = 1;
+    size_t len = 1;
+    int j;
+
+    ps->nranges = ps->nbr = 0;
+
+    while ((p = strchr(tok, '[')) && (q = strchr(p, ']'))) {
+        struct _bracket *b;
+        unsigned long n = 0;
+        int maxlen = 0;
+
+        if (_parser_grow((void **) &ps->br, &ps->brsize, ps->nbr + 1,
+                         sizeof(struct _bracket)) < 0)
+            return -1;
+        b = &ps->br[ps->nbr++];
+        b->lit = tok;
+        b->litlen = p - tok;
+        b->first = ps->nranges;
+        if ((b->n = _parse_range_list(ps, p + 1, q - p - 1)) < 0)
+            return -1;
+
+        for (j = b->first; j < b->first + b->n; j++) {
+            struct _range *r = &ps->ranges[j];
+            int w = _num_digits(r->hi);
+            if (w < r->width)
+                w = r->width;
+            if (w > maxlen)
+                maxlen = w;
+            n += r->hi - r->lo + 1;
+        }
+        if (n > INT_MAX / nhosts) {
+            _error(__FILE__, __LINE__, "Too many hosts in `%s'",
+                   ps->br[0].lit);
+            seterrno_ret(ERANGE, -1);
+        }
+        nhosts *= n;
+        len += b->litlen + maxlen;
+        tok = q + 1;
+    }
+    ps->suffix = tok;
+    len += strlen(tok);
+
+    if (len > ps->namesize) {
+        char *name = realloc(ps->name, len);
+        if (name == NULL)
+            seterrno_ret(ENOMEM, -1);
+        ps->name = name;
+        ps->namesize = len;
     }
+    return ps->nbr;
 }
 
-static void
-_push_range_list_with_suffix(hostlist_t hl, char *pfx, char *sfx, 
-                             struct _range *rng, int n)
+/* Push the hosts of bracket k onward, where the first off chars of
+ * ps->name are the hostname built from brackets before k.
+ * Returns 0, or -1 if memory could not be allocated.
+ */
+static int _push_brackets(struct _parser *ps, int k, int off)
 {
+    struct _bracket *b = &ps->br[k];
+    unsigned long v;
     int i;
-    unsigned long j;
-    for (i = 0; i < n; i++) {
-        for (j = rng->lo; j <= rng->hi; j++) {
-            char host[4096];
-            hostrange_t hr;
-            snprintf (host, 4096, "%s%0*lu%s", pfx, rng->width, j, sfx);
-            hr = hostrange_create_single (host);
-            hostlist_push_range (hl, hr);
-            /*
-             * hr is copied in hostlist_push_range. Need to free here.
-             */
-            hostrange_destroy (hr);
+
+    if (k == ps->nbr) {
+        strcpy(ps->name + off, ps->suffix);
+        return (hostlist_append_hr(ps->hl, ps->name, strlen(ps->name),
+                                   0, 0, -1) ? 0 : -1);
+    }
+
+    memcpy(ps->name + off, b->lit, b->litlen);
+    off += b->litlen;
+
+    for (i = b->first; i < b->first + b->n; i++) {
+        struct _range *r = &ps->ranges[i];
+
+        /*
+         *  The last bracket of a token with no suffix is pushed as
+         *   a range under the prefix built so far.
+         */
+        if (k == ps->nbr - 1 && *ps->suffix == '\0') {
+            if (!hostlist_append_hr(ps->hl, ps->name, off,
+                                    r->lo, r->hi, r->width))
+                return -1;
+            continue;
+        }
+
+        for (v = r->lo; ; v++) {
+            int n = sprintf(ps->name + off, "%0*lu", r->width, v);
+            if (_push_brackets(ps, k + 1, off + n) < 0)
+                return -1;
+            if (v == r->hi)
+                break;
         }
-        rng++;
     }
+    return 0;
 }
 
 /*
@@ -1498,10 +1657,9 @@ static hostlist_t
 _hostlist_create_bracketed(const char *hostlist, char *sep, char *r_op)
 {
     hostlist_t new = hostlist_new();
-    struct _range ranges[MAX_RANGES];
-    int nr, err;
-    char *p, *tok, *str, *orig;
-    char cur_tok[1024];
+    struct _parser ps;
+    int nbr, err;
+    char *tok, *str, *orig;
 
     if (hostlist == NULL)
         return new;
@@ -1511,38 +1669,30 @@ _hostlist_create_bracketed(const char *hostlist, char *sep, char *r_op)
         return NULL;
     }
 
-    while ((tok = _next_tok(sep, &str)) != NULL) {
-        strncpy(cur_tok, tok, 1024);
-
-        if ((p = strchr(tok, '[')) != NULL) {
-            char *q, *prefix = tok;
-            *p++ = '\0';
-
-            if ((q = strchr(p, ']'))) {
-                *q = '\0';
-                nr = _parse_range_list(p, ranges, MAX_RANGES);
-                if (nr < 0) 
-                    goto error;
-
-                if (*(++q) != '\0')
-                    _push_range_list_with_suffix (new, prefix, q, ranges, nr);
-                else
-                    _push_range_list(new, prefix, ranges, nr);
-
-                
-            } else
-                hostlist_push_host(new, cur_tok);
+    memset(&ps, 0, sizeof(ps));
+    ps.hl = new;
 
-        } else
-            hostlist_push_host(new, cur_tok);
+    while ((tok = _next_tok(sep, &str)) != NULL) {
+        if ((nbr = _parse_brackets(&ps, tok)) < 0)
+            goto error;
+        if (nbr == 0)
+            hostlist_push_host(new, tok);
+        else if (_push_brackets(&ps, 0, 0) < 0)
+            goto error;
     }
 
+    free(ps.ranges);
+    free(ps.br);
+    free(ps.name);
     free(orig);
     return new;
 
   error:
     err = errno;
     hostlist_destroy(new);
+    free(ps.ranges);
+    free(ps.br);
+    free(ps.name);
     free(orig);
     seterrno_ret(err, NULL);
 }
@@ -1608,6 +1758,13 @@ int hostlist_push(hostlist_t hl, const char *hosts)
     int retval;
     if (hosts == NULL)
         return 0;
+#if !WANT_RECKLESS_HOSTRANGE_EXPANSION
+    /*
+     *  A single name without separators or brackets needs no parsing.
+     */
+    if (*hosts != '\0' && !strpbrk(hosts, "\t, ["))
+        return hostlist_push_host(hl, hosts);
+#endif
     new = hostlist_create(hosts);
     if (!new)
         return 0;
@@ -1619,28 +1776,78 @@ int hostlist_push(hostlist_t hl, const char *hosts)
     return retval;
 }
 
+/* Append hosts lo through hi, whose prefix is the first plen characters
+ * of str, to hl, extending the last range when the hosts follow it.
+ * A negative width appends the single host str with no valid numeric
+ * suffix. Unlike hostlist_push_range(), at most one range and its
+ * prefix are allocated, which keeps building large lists cheap.
+ * Returns 1, or 0 if there was an error allocating memory.
+ */
+static int hostlist_append_hr(hostlist_t hl, const char *str, int plen,
+                              unsigned long lo, unsigned long hi, int width)
+{
+    hostrange_t tail, hr;
+
+    LOCK_HOSTLIST(hl);
+
+    if (width >= 0 && hl->nranges > 0) {
+        tail = hl->hr[hl->nranges - 1];
+        if (!tail->singlehost
+            && lo > 0 && tail->hi == lo - 1
+            && strncmp(tail->prefix, str, plen) == 0
+            && tail->prefix[plen] == '\0'
+            && _width_equiv(tail->lo, &tail->width, lo, &width)) {
+            tail->hi = hi;
+            goto done;
+        }
+    }
+
+    if (hl->size == hl->nranges && !hostlist_expand(hl))
+        goto error;
+
+    hr = hostrange_new();
+    if (!(hr->prefix = malloc(plen + 1))) {
+        free(hr);
+        goto error;
+    }
+    memcpy(hr->prefix, str, plen);
+    hr->prefix[plen] = '\0';
+    hr->singlehost = (width < 0);
+    hr->lo = hr->singlehost ? 0L : lo;
+    hr->hi = hr->singlehost ? 0L : hi;
+    hr->width = hr->singlehost ? 0 : width;
+    hl->hr[hl->nranges++] = hr;
+
+  done:
+    hl->nhosts += (width < 0) ? 1 : (int) (hi - lo + 1);
+    UNLOCK_HOSTLIST(hl);
+    return 1;
+
+  error:
+    UNLOCK_HOSTLIST(hl);
+    return 0;
+}
+
 int hostlist_push_host(hostlist_t hl, const char *str)
 {
-    hostrange_t hr;
-    hostname_t hn;
+    unsigned long num = 0;
+    int len, idx;
+    char *p;
 
     if (str == NULL)
         return 0;
 
-    hn = hostname_create(str);
-
-    if (hostname_suffix_is_valid(hn)) {
-        hr = hostrange_create(hn->prefix, hn->num, hn->num,
-                      hostname_suffix_width(hn));
-    } else
-        hr = hostrange_create_single(str);
-
-    hostlist_push_range(hl, hr);
+    len = strlen(str);
+    idx = host_prefix_end(str);
 
-    hostrange_destroy(hr);
-    hostname_destroy(hn);
+    if (idx < len - 1) {
+        num = strtoul(str + idx + 1, &p, 10);
+        if (*p == '\0' && num <= MAX_HOST_SUFFIX)
+            return hostlist_append_hr(hl, str, idx + 1, num, num,
+                                      len - idx - 1);
+    }
 
-    return 1;
+    return hostlist_append_hr(hl, str, len, 0, 0, -1);
 }
 
 int hostlist_push_list(hostlist_t h1, hostlist_t h2)
@@ -1661,6 +1868,58 @@ int hostlist_push_list(hostlist_t h1, hostlist_t h2)
 }
 
 
+int hostlist_split(hostlist_t hl, int n, hostlist_t parts[])
+{
+    struct hostrange_components sub;
+    unsigned long per, room, count, take;
+    int i, j = 0;
+
+    if (n < 1)
+        seterrno_ret(EINVAL, -1);
+
+    LOCK_HOSTLIST(hl);
+
+    if (n > hl->nhosts)
+        n = hl->nhosts > 0 ? hl->nhosts : 1;
+    per = (hl->nhosts + n - 1) / n;
+    room = per;
+
+    if (!(parts[0] = hostlist_new()))
+        goto error;
+
+    for (i = 0; i < hl->nranges; i++) {
+        sub = *hl->hr[i];
+        count = hostrange_count(&sub);
+        while (count > 0) {
+            if (room == 0) {
+                if (!(parts[++j] = hostlist_new()))
+                    goto error;
+                room = per;
+            }
+            take = count < room ? count : room;
+            if (!sub.singlehost)
+                sub.hi = sub.lo + take - 1;
+            if (hostlist_push_range(parts[j], &sub) < 0) {
+                j++;
+                goto error;
+            }
+            sub.lo = sub.hi + 1;
+            sub.hi = hl->hr[i]->hi;
+            count -= take;
+            room -= take;
+        }
+    }
+
+    UNLOCK_HOSTLIST(hl);
+    return j + 1;
+
+  error:
+    UNLOCK_HOSTLIST(hl);
+    while (j-- > 0)
+        hostlist_destroy(parts[j]);
+    seterrno_ret(ENOMEM, -1);
+}
+
 char *hostlist_pop(hostlist_t hl)
 {
     char *host = NULL;
@@ -1951,6 +2210,7 @@ int _cmp(const void *hr1, const void *hr2)
 void hostlist_sort(hostlist_t hl)
 {
     hostlist_iterator_t i;
+    int coalesce = 0;
     LOCK_HOSTLIST(hl);
 
     if (hl->nranges <= 1) {
@@ -1958,7 +2218,11 @@ void hostlist_sort(hostlist_t hl)
         return;
     }
 
-    qsort(hl->hr, hl->nranges, sizeof(hostrange_t), &_cmp);
+    /* The radix sort coalesces as it goes */
+    if (_hostlist_radix_sort(hl, 0) < 0) {
+        qsort(hl->hr, hl->nranges, sizeof(hostrange_t), &_cmp);
+        coalesce = 1;
+    }
 
     /* reset all iterators */
     for (i = hl->ilist; i; i = i->next)
@@ -1966,7 +2230,8 @@ void hostlist_sort(hostlist_t hl)
 
     UNLOCK_HOSTLIST(hl);
 
-    hostlist_coalesce(hl);
+    if (coalesce)
+        hostlist_coalesce(hl);
 
 }
 
@@ -2065,109 +2330,1014 @@ static int _attempt_range_join(hostlist_t hl, int loc)
     return ndup;
 }
 
-void hostlist_uniq(hostlist_t hl)
-{
-    int i = 1;
-    hostlist_iterator_t hli;
-    LOCK_HOSTLIST(hl);
-    if (hl->nranges <= 1) {
-        UNLOCK_HOSTLIST(hl);
-        return;
-    }
-    qsort(hl->hr, hl->nranges, sizeof(hostrange_t), &_cmp);
+/* ----[ linear time sort and uniq ]---- */
 
-    while (i < hl->nranges) {
-        if (_attempt_range_join(hl, i) < 0) /* No range join occurred */
-            i++;
-    }
+/*
+ *  hostlist_sort() and hostlist_uniq() avoid qsort() with hostrange_cmp()
+ *   and joining ranges one array shift at a time. Instead the ranges are
+ *   radix sorted as "runs" on a 64 bit key of (prefix rank, width, lo),
+ *   which is the order hostrange_cmp() gives. With the prefix and width
+ *   fixed each suffix prints one way, so two hosts of the same class
+ *   (same key less lo) are equal exactly when their suffixes are, and
+ *   each class can be merged in one pass while the new range array is
+ *   built.
+ *
+ *   The same host may appear in classes of different width, e.g. n10 in
+ *   both n[9-11] and n10. For uniq the ranges are therefore first cut
+ *   into runs whose suffixes all print with the same number of digits,
+ *   and either all or none with leading zeros, and sorted on (prefix
+ *   rank, padded, printed digits, lo), which puts equal hosts in the
+ *   same class. The union of each class is then sorted again by the
+ *   smallest width it was given with.
+ *
+ *   Lists which do not fit the key fall back to the qsort() method.
+ */
+#define HOSTRUN_LO_BITS     30
+#define HOSTRUN_LEN_BITS    6
+#define HOSTRUN_PAD_BIT     (HOSTRUN_LO_BITS + HOSTRUN_LEN_BITS)
+#define HOSTRUN_RANK_BITS   (64 - HOSTRUN_PAD_BIT - 1)
+#define HOSTRUN_CLASS(k)    ((k) >> HOSTRUN_LO_BITS)
+
+struct hostrun {
+    uint64_t key;
+    unsigned long lo, hi;
+    int idx;                /* index of the run's range in hl->hr[] */
+    int width;              /* width of that range                  */
+};
 
-    /* reset all iterators */
-    for (hli = hl->ilist; hli; hli = hli->next)
-        hostlist_iterator_reset(hli);
+#define HOSTRUN_KEY(rank, width, lo)                                \
+    (((uint64_t) (rank) << (64 - HOSTRUN_RANK_BITS))                \
+     | ((uint64_t) (width) << HOSTRUN_LO_BITS) | (lo))
 
-    UNLOCK_HOSTLIST(hl);
-}
+struct hostrun_prefix {
+    const char *prefix;
+    int singlehost;
+    int rank;
+};
 
+struct hostrun_out {
+    hostrange_t *hr;        /* new range array                         */
+    int n, size;
+    hostrange_t *orig;      /* old range array, recycled where possible */
+    char *used;             /* true if orig[i] has been recycled        */
+    int nhosts;
+};
 
-ssize_t hostlist_deranged_string(hostlist_t hl, size_t n, char *buf)
+static int _hostrun_prefix_cmp(const void *x, const void *y)
 {
-    int i;
-    int len = 0;
-    int truncated = 0;
+    const struct hostrun_prefix *a = *(struct hostrun_prefix **) x;
+    const struct hostrun_prefix *b = *(struct hostrun_prefix **) y;
+    int rc = strcmp(a->prefix, b->prefix);
+    return rc ? rc : b->singlehost - a->singlehost;
+}
+
+/* Rank the distinct (prefix, singlehost) pairs of hl in hostrange_cmp()
+ * order, storing the rank of each range in rank[].
+ * Returns the number of distinct prefixes, or -1 on failure.
+ */
+static int _hostrun_rank(hostlist_t hl, int *rank)
+{
+    struct hostrun_prefix *p, **sorted;
+    int *table, *slot;
+    unsigned long h, mask;
+    int i, n = 0;
+
+    for (mask = 1; mask < 2 * (unsigned long) hl->nranges; mask <<= 1) {;}
+    if (!(table = malloc(mask * sizeof(int))))
+        return -1;
+    p = malloc(hl->nranges * sizeof(*p));
+    sorted = malloc(hl->nranges * sizeof(*sorted));
+    if (!p || !sorted) {
+        free(table);
+        free(p);
+        free(sorted);
+        return -1;
+    }
+    memset(table, 0xff, mask * sizeof(int));
+    mask--;
 
-    LOCK_HOSTLIST(hl);
     for (i = 0; i < hl->nranges; i++) {
-        size_t m = (n - len) <= n ? n - len : 0;
-        int ret = hostrange_to_string(hl->hr[i], m, buf + len, ",");
-        if (ret < 0 || ret > m) {
-            len = n;
-            truncated = 1;
-            break;
+        hostrange_t hr = hl->hr[i];
+        h = _family_hash(hr->prefix, strlen(hr->prefix), hr->singlehost);
+        for (slot = &table[h & mask]; *slot >= 0; slot = &table[h & mask]) {
+            if (p[*slot].singlehost == hr->singlehost
+                && strcmp(p[*slot].prefix, hr->prefix) == 0)
+                break;
+            h++;
         }
-        len+=ret;
-        buf[len++] = ',';
+        if (*slot < 0) {
+            p[n].prefix = hr->prefix;
+            p[n].singlehost = hr->singlehost;
+            sorted[n] = &p[n];
+            *slot = n++;
+        }
+        rank[i] = *slot;
     }
-    UNLOCK_HOSTLIST(hl);
 
-    buf[len > 0 ? --len : 0] = '\0';
-    if (len == n)
-        truncated = 1;
+    qsort(sorted, n, sizeof(*sorted), &_hostrun_prefix_cmp);
+    for (i = 0; i < n; i++)
+        sorted[i]->rank = i;
+    for (i = 0; i < hl->nranges; i++)
+        rank[i] = p[rank[i]].rank;
 
-    return truncated ? -1 : len;
+    free(table);
+    free(p);
+    free(sorted);
+    return n;
 }
 
-/* return true if a bracket is needed for the range at i in hostlist hl */
-static int _is_bracket_needed(hostlist_t hl, int i)
+/* Stable LSD radix sort of runs[] on key, 16 bits at a time, skipping
+ * digits which are the same in every key.
+ */
+static int _hostrun_radix_sort(struct hostrun *runs, int n)
 {
-    hostrange_t h1 = hl->hr[i];
-    hostrange_t h2 = i < hl->nranges - 1 ? hl->hr[i + 1] : NULL;
-    return hostrange_count(h1) > 1 || hostrange_within_range(h1, h2);
+    struct hostrun *tmp, *src = runs, *dst;
+    int *count;
+    int shift, i;
+
+    if (!(tmp = malloc(n * sizeof(*tmp))))
+        return -1;
+    if (!(count = malloc(65536 * sizeof(int)))) {
+        free(tmp);
+        return -1;
+    }
+    dst = tmp;
+
+    for (shift = 0; shift < 64; shift += 16) {
+        int sum = 0;
+        memset(count, 0, 65536 * sizeof(int));
+        for (i = 0; i < n; i++)
+            count[(src[i].key >> shift) & 0xffff]++;
+        if (count[(src[0].key >> shift) & 0xffff] == n)
+            continue;
+        for (i = 0; i < 65536; i++) {
+            int c = count[i];
+            count[i] = sum;
+            sum += c;
+        }
+        for (i = 0; i < n; i++)
+            dst[count[(src[i].key >> shift) & 0xffff]++] = src[i];
+        dst = src;
+        src = (src == runs) ? tmp : runs;
+    }
+
+    if (src != runs)
+        memcpy(runs, src, n * sizeof(*runs));
+    free(tmp);
+    free(count);
+    return 0;
 }
 
-/* write the next bracketed hostlist, i.e. prefix[n-m,k,...]
- * into buf, writing at most n chars including the terminating '\0'
- *
- * leaves start pointing to one past last range object in bracketed list,
- * and returns the number of bytes written into buf.
- *
- * Assumes hostlist is locked.
+/* Make runs of the ranges of hl and sort them. If uniq is set, ranges
+ * are cut into runs of equal printed suffix length and sorted by host
+ * equality, otherwise there is one run per range sorted by (prefix rank,
+ * width, lo). Returns the sorted runs and their number in *nruns, or
+ * NULL if hl cannot be sorted this way.
  */
-static int
-_get_bracketed_list(hostlist_t hl, int *start, const size_t n, char *buf)
+static struct hostrun *_hostlist_runs(hostlist_t hl, int uniq, int *nruns)
 {
-    hostrange_t *hr = hl->hr;
-    int i = *start;
-    int m, len = 0;
-    int bracket_needed = _is_bracket_needed(hl, i);
-
-    len = snprintf(buf, n, "%s", hr[i]->prefix);
+    struct hostrun *runs = NULL;
+    int *rank;
+    int i, nprefix, n = 0, size = 0;
 
-    if ((len < 0) || (len > n))
-        return n; /* truncated, buffer filled */
+    if (!(rank = malloc(hl->nranges * sizeof(int))))
+        return NULL;
+    nprefix = _hostrun_rank(hl, rank);
+    if (nprefix < 0 || nprefix >= (1 << HOSTRUN_RANK_BITS) - 1)
+        goto fail;
 
-    if (bracket_needed && len < n)
-        buf[len++] = '[';
+    for (i = 0; i < hl->nranges; i++) {
+        hostrange_t hr = hl->hr[i];
+        int width = hr->singlehost ? 0 : hr->width;
+        unsigned long lo = hr->lo;
+
+        if (!hr->singlehost
+            && (hr->hi >= (1UL << HOSTRUN_LO_BITS)
+                || hr->width >= (1 << HOSTRUN_LEN_BITS)))
+            goto fail;
+
+        do {
+            int digits = hr->singlehost ? 0 : _num_digits(lo);
+            int len = digits < width ? width : digits;
+            int pad = digits < len;
+            unsigned long hi = hr->hi;
+            unsigned long max = _pow10(pad ? len - 1 : len) - 1;
+
+            if (uniq && !hr->singlehost && hi > max)
+                hi = max;
+
+            if (n == size) {
+                struct hostrun *r;
+                size = size ? 2 * size : hl->nranges + 16;
+                if (!(r = realloc(runs, size * sizeof(*r))))
+                    goto fail;
+                runs = r;
+            }
+            if (uniq)
+                runs[n].key = HOSTRUN_KEY(rank[i], len, lo)
+                            | ((uint64_t) pad << HOSTRUN_PAD_BIT);
+            else
+                runs[n].key = HOSTRUN_KEY(rank[i], width, lo);
+            runs[n].lo = lo;
+            runs[n].hi = hi;
+            runs[n].idx = i;
+            runs[n].width = width;
+            n++;
+            lo = hi + 1;
+        } while (!hr->singlehost && lo <= hr->hi);
+    }
 
-    do {
-        m = (n - len) <= n ? n - len : 0;
-        len += hostrange_numstr(hr[i], m, buf + len);
-        if (len >= n)
-            break;
-        if (bracket_needed) /* Only need commas inside brackets */
-            buf[len++] = ',';
-    } while (++i < hl->nranges && hostrange_within_range(hr[i], hr[i-1]));
+    if (_hostrun_radix_sort(runs, n) < 0)
+        goto fail;
 
-    if (bracket_needed && len < n && len > 0) {
+    free(rank);
+    *nruns = n;
+    return runs;
 
-        /* Add trailing bracket (change trailing "," from above to "]" */
-        buf[len - 1] = ']';
+  fail:
+    free(rank);
+    free(runs);
+    return NULL;
+}
 
-        /* NUL terminate for safety, but do not add terminator to len */
-        buf[len]   = '\0';
+/* Replace the runs made for uniq, in place, by the union of each class,
+ * keyed by (prefix rank, smallest width, lo) and sorted again.
+ * Returns the new number of runs, or -1 on failure.
+ */
+static int _hostrun_union(struct hostrun *runs, int n)
+{
+    int i = 0, m = 0;
+
+    while (i < n) {
+        struct hostrun r = runs[i];
+        uint64_t class = HOSTRUN_CLASS(runs[i].key);
+
+        while (++i < n && HOSTRUN_CLASS(runs[i].key) == class
+               && runs[i].lo <= r.hi + 1) {
+            if (runs[i].hi > r.hi)
+                r.hi = runs[i].hi;
+            if (runs[i].width < r.width)
+                r.width = runs[i].width;
+        }
+        r.key = HOSTRUN_KEY(r.key >> (64 - HOSTRUN_RANK_BITS), r.width, r.lo);
+        runs[m++] = r;
+    }
 
-    } else if (len >= n) {
-        if (n > 0)
-            buf[n-1] = '\0';
+    if (_hostrun_radix_sort(runs, m) < 0)
+        return -1;
+    return m;
+}
+
+/* Append hosts [lo, hi] printed with len digits to the new range array,
+ * extending the last range if possible. runs[] are the runs of the
+ * current class, whose old ranges may be recycled since they share
+ * the same prefix.
+ */
+static int _hostrun_append(struct hostrun_out *out, struct hostrun *runs,
+                           int nruns, int *cursor, unsigned long lo,
+                           unsigned long hi, int len)
+{
+    hostrange_t hr = out->orig[runs[0].idx];
+    hostrange_t tail = out->n ? out->hr[out->n - 1] : NULL;
+    int width = len;
+
+    if (tail && !hr->singlehost && !tail->singlehost
+        && tail->hi + 1 == lo
+        && strcmp(tail->prefix, hr->prefix) == 0
+        && _width_equiv(tail->lo, &tail->width, lo, &width)) {
+        tail->hi = hi;
+        out->nhosts += hi - lo + 1;
+        return 0;
+    }
+
+    if (out->n == out->size) {
+        hostrange_t *new;
+        out->size = out->size ? 2 * out->size : HOSTLIST_CHUNK;
+        if (!(new = realloc(out->hr, out->size * sizeof(*new))))
+            return -1;
+        out->hr = new;
+    }
+
+    while (*cursor < nruns && out->used[runs[*cursor].idx])
+        (*cursor)++;
+    if (*cursor < nruns) {
+        hr = out->orig[runs[*cursor].idx];
+        out->used[runs[*cursor].idx] = 1;
+    } else if (!(hr = hr->singlehost ? hostrange_create_single(hr->prefix)
+                                     : hostrange_create(hr->prefix, 0, 0, 0)))
+        return -1;
+
+    if (!hr->singlehost) {
+        hr->lo = lo;
+        hr->hi = hi;
+        hr->width = len;
+    }
+    out->hr[out->n++] = hr;
+    out->nhosts += hostrange_count(hr);
+    return 0;
+}
+
+/* Merge the runs of one class, sorted by lo. If uniq is set each host
+ * is emitted once, otherwise as many times as it appears, in order.
+ */
+static int _hostrun_merge(struct hostrun_out *out, struct hostrun *runs,
+                          int n, int uniq, unsigned long *heap)
+{
+    int len = (int) ((runs[0].key >> HOSTRUN_LO_BITS)
+                     & ((1 << HOSTRUN_LEN_BITS) - 1));
+    int i = 0, cursor = 0, nheap = 0;
+    unsigned long x, end;
+
+    if (out->orig[runs[0].idx]->singlehost) {
+        for (i = 0; i < (uniq ? 1 : n); i++) {
+            if (_hostrun_append(out, runs, n, &cursor, 0, 0, 0) < 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    if (uniq) {
+        while (i < n) {
+            x = runs[i].lo;
+            end = runs[i].hi;
+            while (++i < n && runs[i].lo <= end + 1) {
+                if (runs[i].hi > end)
+                    end = runs[i].hi;
+            }
+            if (_hostrun_append(out, runs, n, &cursor, x, end, len) < 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    /*
+     *  Sweep across the runs keeping a min-heap of the ends of those
+     *   covering x, so that every stretch covered by m runs can be
+     *   emitted host by host m times.
+     */
+    x = runs[0].lo;
+    while (i < n || nheap > 0) {
+        int j, c;
+
+        if (nheap == 0 && runs[i].lo > x)
+            x = runs[i].lo;
+        for (; i < n && runs[i].lo <= x; i++) {
+            for (j = nheap++; j > 0 && heap[(j - 1) / 2] > runs[i].hi;
+                 j = (j - 1) / 2)
+                heap[j] = heap[(j - 1) / 2];
+            heap[j] = runs[i].hi;
+        }
+
+        end = heap[0];
+        if (i < n && runs[i].lo <= end)
+            end = runs[i].lo - 1;
+
+        if (nheap == 1) {
+            if (_hostrun_append(out, runs, n, &cursor, x, end, len) < 0)
+                return -1;
+        } else {
+            unsigned long h;
+            for (h = x; h <= end; h++) {
+                for (c = 0; c < nheap; c++) {
+                    if (_hostrun_append(out, runs, n, &cursor, h, h, len) < 0)
+                        return -1;
+                }
+            }
+        }
+        x = end + 1;
+
+        while (nheap > 0 && heap[0] < x) {
+            unsigned long last = heap[--nheap];
+            for (j = 0; 2 * j + 1 < nheap; ) {
+                c = 2 * j + 1;
+                if (c + 1 < nheap && heap[c + 1] < heap[c])
+                    c++;
+                if (last <= heap[c])
+                    break;
+                heap[j] = heap[c];
+                j = c;
+            }
+            heap[j] = last;
+        }
+    }
+    return 0;
+}
+
+/* Sort hl, removing duplicates if uniq is set.
+ * Assumes hl is locked by the caller. Returns 0 on success, or -1 if
+ * hl was left unchanged and must be sorted with qsort() instead.
+ */
+static int _hostlist_radix_sort(hostlist_t hl, int uniq)
+{
+    struct hostrun_out out;
+    struct hostrun *runs;
+    unsigned long *heap = NULL;
+    int i, j, nruns;
+
+    if (!(runs = _hostlist_runs(hl, uniq, &nruns)))
+        return -1;
+    if (uniq && (nruns = _hostrun_union(runs, nruns)) < 0) {
+        free(runs);
+        return -1;
+    }
+
+    memset(&out, 0, sizeof(out));
+    out.orig = hl->hr;
+    if (!(out.used = calloc(hl->nranges, 1))
+        || (!uniq && !(heap = malloc(nruns * sizeof(*heap)))))
+        goto fail;
+
+    for (i = 0; i < nruns; i = j) {
+        for (j = i + 1; j < nruns; j++) {
+            if (HOSTRUN_CLASS(runs[j].key) != HOSTRUN_CLASS(runs[i].key))
+                break;
+        }
+        if (_hostrun_merge(&out, &runs[i], j - i, uniq, heap) < 0)
+            goto fail;
+    }
+
+    for (i = 0; i < hl->nranges; i++) {
+        if (!out.used[i])
+            hostrange_destroy(hl->hr[i]);
+    }
+    free(hl->hr);
+    hl->hr = out.hr;
+    hl->size = out.size;
+    hl->nranges = out.n;
+    hl->nhosts = out.nhosts;
+
+    free(out.used);
+    free(heap);
+    free(runs);
+    return 0;
+
+  fail:
+    /*
+     *  Recycled ranges may have been modified, so this is only safe
+     *   before any range has been appended. Allocation failures after
+     *   that point are fatal.
+     */
+    if (out.n > 0) {
+        errno = ENOMEM;
+        lsd_fatal_error(__FILE__, __LINE__, "hostlist sort");
+        abort();
+    }
+    free(out.hr);
+    free(out.used);
+    free(heap);
+    free(runs);
+    return -1;
+}
+
+void hostlist_uniq(hostlist_t hl)
+{
+    int i = 1;
+    hostlist_iterator_t hli;
+    LOCK_HOSTLIST(hl);
+    if (hl->nranges <= 1) {
+        UNLOCK_HOSTLIST(hl);
+        return;
+    }
+
+    if (_hostlist_radix_sort(hl, 1) < 0) {
+        qsort(hl->hr, hl->nranges, sizeof(hostrange_t), &_cmp);
+
+        while (i < hl->nranges) {
+            if (_attempt_range_join(hl, i) < 0) /* No range join occurred */
+                i++;
+        }
+    }
+
+    /* reset all iterators */
+    for (hli = hl->ilist; hli; hli = hli->next)
+        hostlist_iterator_reset(hli);
+
+    UNLOCK_HOSTLIST(hl);
+}
+
+
+/* ----[ hostlist set operations ]---- */
+
+/*
+ *  Set operations compare hostlists range by range instead of host by
+ *   host. Each hostrange is first split into "segments": runs of hosts
+ *   with the same prefix (less any trailing digits) and the same number
+ *   of digits following it. Within a segment a host is identified by the
+ *   value of those digits alone, so "n0[1-9]", "n[01-09]" and "n01" all
+ *   land in the same segment and can be compared as numeric intervals.
+ */
+struct hostseg {
+    char *prefix;           /* prefix without trailing digits           */
+    int digits;             /* number of digits following the prefix,
+                             *  or -1 if there are too many to convert  */
+    unsigned long lo, hi;   /* interval of values of those digits       */
+};
+
+struct hostseg_array {
+    struct hostseg *seg;
+    int n;
+    int size;
+};
+
+/* return the number of decimal digits that always fit in an unsigned long
+ */
+static int _ulong_digits(void)
+{
+    unsigned long v = ULONG_MAX;
+    int n = 0;
+    while (v /= 10)
+        n++;
+    return n;
+}
+
+static unsigned long _pow10(int n)
+{
+    unsigned long v = 1;
+    while (n-- > 0)
+        v *= 10;
+    return v;
+}
+
+/* return the number of digits in num when printed without padding
+ */
+static int _num_digits(unsigned long num)
+{
+    int n = 1;
+    while (num /= 10)
+        n++;
+    return n;
+}
+
+static int _trailing_digits(const char *s, int len)
+{
+    int n = 0;
+    while (n < len && isdigit((int) s[len - n - 1]))
+        n++;
+    return n;
+}
+
+static void _hostseg_array_destroy(struct hostseg_array *a)
+{
+    int i;
+    if (a == NULL)
+        return;
+    for (i = 0; i < a->n; i++)
+        free(a->seg[i].prefix);
+    free(a->seg);
+    free(a);
+}
+
+/* Append a segment with a copy of the first `len' chars of prefix to a.
+ * Returns 0 on success, -1 with errno set to ENOMEM on failure.
+ */
+static int _hostseg_append(struct hostseg_array *a, const char *prefix,
+                           int len, int digits, unsigned long lo,
+                           unsigned long hi)
+{
+    struct hostseg *s;
+
+    if (a->n == a->size) {
+        int size = a->size ? a->size * 2 : HOSTLIST_CHUNK;
+        struct hostseg *new = realloc(a->seg, size * sizeof(*new));
+        if (new == NULL)
+            seterrno_ret(ENOMEM, -1);
+        a->seg = new;
+        a->size = size;
+    }
+
+    s = &a->seg[a->n];
+    if ((s->prefix = malloc(len + 1)) == NULL)
+        seterrno_ret(ENOMEM, -1);
+    memcpy(s->prefix, prefix, len);
+    s->prefix[len] = '\0';
+    s->digits = digits;
+    s->lo = lo;
+    s->hi = hi;
+    a->n++;
+
+    return 0;
+}
+
+/* Split hostrange hr into segments and append them to a in order.
+ * Returns 0 on success, -1 on failure.
+ */
+static int _hostseg_append_range(struct hostseg_array *a, hostrange_t hr)
+{
+    int maxdigits = _ulong_digits();
+    int len = strlen(hr->prefix);
+    int k = _trailing_digits(hr->prefix, len);
+    unsigned long d = 0;
+    unsigned long lo = hr->lo;
+
+    if (hostrange_empty(hr))
+        return 0;
+
+    if (k > maxdigits)
+        return _hostseg_append(a, hr->prefix, len, -1, 0, 0);
+
+    if (k > 0)
+        d = strtoul(hr->prefix + len - k, NULL, 10);
+
+    if (hr->singlehost)
+        return _hostseg_append(a, hr->prefix, len - k, k, d, d);
+
+    /*
+     *  Hosts whose numbers print with different widths (e.g. 9 and 10
+     *   in n[9-10]) fall into different segments, so split the range
+     *   at each power of ten above the range's zero padded width.
+     */
+    for (;;) {
+        int width = _num_digits(lo) > hr->width ? _num_digits(lo) : hr->width;
+        unsigned long hi = hr->hi;
+
+        if (width <= maxdigits && hi > _pow10(width) - 1)
+            hi = _pow10(width) - 1;
+
+        if (k + width <= maxdigits) {
+            unsigned long base = d * _pow10(width);
+            if (_hostseg_append(a, hr->prefix, len - k, k + width,
+                                base + lo, base + hi) < 0)
+                return -1;
+        } else {
+            /* Too many digits to represent: one segment per hostname */
+            unsigned long n;
+            char *host = malloc(len + width + 16);
+            if (host == NULL)
+                seterrno_ret(ENOMEM, -1);
+            for (n = lo; n <= hi; n++) {
+                int hlen = sprintf(host, "%s%0*lu", hr->prefix, hr->width, n);
+                if (_hostseg_append(a, host, hlen, -1, 0, 0) < 0) {
+                    free(host);
+                    return -1;
+                }
+                if (n == hi)
+                    break;
+            }
+            free(host);
+        }
+
+        if (hi == hr->hi)
+            break;
+        lo = hi + 1;
+    }
+
+    return 0;
+}
+
+/* Return the segments of hostlist hl, in list order.
+ */
+static struct hostseg_array *_hostseg_array_create(hostlist_t hl)
+{
+    int i;
+    struct hostseg_array *a = calloc(1, sizeof(*a));
+
+    if (a == NULL)
+        out_of_memory("hostlist set operation");
+
+    LOCK_HOSTLIST(hl);
+    for (i = 0; i < hl->nranges; i++) {
+        if (_hostseg_append_range(a, hl->hr[i]) < 0) {
+            UNLOCK_HOSTLIST(hl);
+            _hostseg_array_destroy(a);
+            out_of_memory("hostlist set operation");
+        }
+    }
+    UNLOCK_HOSTLIST(hl);
+
+    return a;
+}
+
+/* compare segments by prefix, then digits, then interval
+ */
+static int _hostseg_cmp(const void *x, const void *y)
+{
+    const struct hostseg *s1 = x;
+    const struct hostseg *s2 = y;
+    int rc;
+
+    if ((rc = strcmp(s1->prefix, s2->prefix)) != 0)
+        return rc;
+    if (s1->digits != s2->digits)
+        return s1->digits - s2->digits;
+    if (s1->lo != s2->lo)
+        return s1->lo < s2->lo ? -1 : 1;
+    return 0;
+}
+
+/* Sort the segments in a and merge overlapping or adjacent intervals,
+ * leaving a sorted array of disjoint segments.
+ */
+static void _hostseg_array_normalize(struct hostseg_array *a)
+{
+    int i, n = 0;
+
+    if (a->n == 0)
+        return;
+
+    qsort(a->seg, a->n, sizeof(struct hostseg), &_hostseg_cmp);
+
+    for (i = 1; i < a->n; i++) {
+        struct hostseg *last = &a->seg[n];
+        struct hostseg *s = &a->seg[i];
+
+        if (strcmp(last->prefix, s->prefix) == 0
+            && last->digits == s->digits
+            && s->lo <= last->hi + 1) {
+            if (s->hi > last->hi)
+                last->hi = s->hi;
+            free(s->prefix);
+        } else
+            a->seg[++n] = *s;
+    }
+    a->n = n + 1;
+}
+
+/* Return the index of the first segment in the normalized array a that
+ * could overlap segment s, i.e. the first segment not entirely before s.
+ */
+static int _hostseg_search(struct hostseg_array *a, struct hostseg *s)
+{
+    int lo = 0;
+    int hi = a->n;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        struct hostseg *m = &a->seg[mid];
+        int rc = strcmp(m->prefix, s->prefix);
+
+        if (rc == 0)
+            rc = m->digits - s->digits;
+        if (rc == 0)
+            rc = (m->hi < s->lo) ? -1 : 1;
+
+        if (rc < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Push hosts lo through hi of segment s onto hostlist hl
+ */
+static int _hostseg_push(hostlist_t hl, struct hostseg *s,
+                         unsigned long lo, unsigned long hi)
+{
+    hostrange_t hr;
+    int rc;
+
+    if (s->digits <= 0)
+        hr = hostrange_create_single(s->prefix);
+    else if (hi > MAX_HOST_SUFFIX) {
+        /*
+         *  hostname_create() won't split a suffix this large, so
+         *   push hosts individually to stay consistent with it.
+         */
+        unsigned long n;
+        char *host = malloc(strlen(s->prefix) + s->digits + 16);
+        if (host == NULL)
+            seterrno_ret(ENOMEM, -1);
+        for (n = lo; n <= hi; n++) {
+            sprintf(host, "%s%0*lu", s->prefix, s->digits, n);
+            hostlist_push_host(hl, host);
+            if (n == hi)
+                break;
+        }
+        free(host);
+        return 0;
+    }
+    else
+        hr = hostrange_create(s->prefix, lo, hi, s->digits);
+
+    if (hr == NULL)
+        return -1;
+
+    rc = hostlist_push_range(hl, hr);
+    hostrange_destroy(hr);
+    return rc;
+}
+
+/* Push the parts of segment s that are (inside = 1) or are not
+ * (inside = 0) in the normalized segment array a onto hostlist hl.
+ */
+static int _hostseg_split(hostlist_t hl, struct hostseg_array *a,
+                          struct hostseg *s, int inside)
+{
+    unsigned long lo = s->lo;
+    int i;
+
+    for (i = _hostseg_search(a, s); i < a->n; i++) {
+        struct hostseg *t = &a->seg[i];
+
+        if (strcmp(t->prefix, s->prefix) != 0
+            || t->digits != s->digits
+            || t->lo > s->hi)
+            break;
+
+        if (inside) {
+            if (_hostseg_push(hl, s, t->lo > lo ? t->lo : lo,
+                              t->hi < s->hi ? t->hi : s->hi) < 0)
+                return -1;
+        } else if (t->lo > lo) {
+            if (_hostseg_push(hl, s, lo, t->lo - 1) < 0)
+                return -1;
+        }
+
+        if (t->hi >= s->hi)
+            return 0;
+        lo = t->hi + 1;
+    }
+
+    if (!inside && _hostseg_push(hl, s, lo, s->hi) < 0)
+        return -1;
+
+    return 0;
+}
+
+/* Return a new hostlist containing the hosts of h1 that are (inside = 1)
+ * or are not (inside = 0) also in h2, in the order they appear in h1.
+ */
+static hostlist_t _hostlist_filter(hostlist_t h1, hostlist_t h2, int inside)
+{
+    struct hostseg_array *a1, *a2;
+    hostlist_t new;
+    int i;
+
+    if (!(a1 = _hostseg_array_create(h1)))
+        return NULL;
+    if (!(a2 = _hostseg_array_create(h2))) {
+        _hostseg_array_destroy(a1);
+        return NULL;
+    }
+    _hostseg_array_normalize(a2);
+
+    if ((new = hostlist_new())) {
+        for (i = 0; i < a1->n; i++) {
+            if (_hostseg_split(new, a2, &a1->seg[i], inside) < 0) {
+                hostlist_destroy(new);
+                new = NULL;
+                break;
+            }
+        }
+    }
+
+    _hostseg_array_destroy(a1);
+    _hostseg_array_destroy(a2);
+
+    if (new == NULL)
+        out_of_memory("hostlist set operation");
+    return new;
+}
+
+hostlist_t hostlist_intersect(hostlist_t h1, hostlist_t h2)
+{
+    return _hostlist_filter(h1, h2, 1);
+}
+
+hostlist_t hostlist_difference(hostlist_t h1, hostlist_t h2)
+{
+    return _hostlist_filter(h1, h2, 0);
+}
+
+hostlist_t hostlist_union(hostlist_t h1, hostlist_t h2)
+{
+    hostlist_t new, rest;
+
+    if (!(rest = _hostlist_filter(h2, h1, 0)))
+        return NULL;
+    if ((new = hostlist_copy(h1)))
+        hostlist_push_list(new, rest);
+    hostlist_destroy(rest);
+    return new;
+}
+
+hostlist_t hostlist_symmetric_difference(hostlist_t h1, hostlist_t h2)
+{
+    hostlist_t new, rest;
+
+    if (!(rest = _hostlist_filter(h2, h1, 0)))
+        return NULL;
+    if ((new = _hostlist_filter(h1, h2, 0)))
+        hostlist_push_list(new, rest);
+    hostlist_destroy(rest);
+    return new;
+}
+
+int hostlist_subtract(hostlist_t h1, hostlist_t h2)
+{
+    hostlist_t new;
+    hostrange_t *hr;
+    hostlist_iterator_t hli;
+    int size, nranges, n;
+
+    if (!(new = _hostlist_filter(h1, h2, 0)))
+        return -1;
+
+    /*
+     *  Swap the new range array into h1 and let hostlist_destroy()
+     *   free the old one.
+     */
+    LOCK_HOSTLIST(h1);
+    n = h1->nhosts - new->nhosts;
+    hr = h1->hr;
+    size = h1->size;
+    nranges = h1->nranges;
+    h1->hr = new->hr;
+    h1->size = new->size;
+    h1->nranges = new->nranges;
+    h1->nhosts = new->nhosts;
+    new->hr = hr;
+    new->size = size;
+    new->nranges = nranges;
+
+    for (hli = h1->ilist; hli; hli = hli->next)
+        hostlist_iterator_reset(hli);
+    UNLOCK_HOSTLIST(h1);
+
+    hostlist_destroy(new);
+    return n;
+}
+
+
+ssize_t hostlist_deranged_string(hostlist_t hl, size_t n, char *buf)
+{
+    int i;
+    int len = 0;
+    int truncated = 0;
+
+    LOCK_HOSTLIST(hl);
+    for (i = 0; i < hl->nranges; i++) {
+        size_t m = (n - len) <= n ? n - len : 0;
+        int ret = hostrange_to_string(hl->hr[i], m, buf + len, ",");
+        if (ret < 0 || ret > m) {
+            len = n;
+            truncated = 1;
+            break;
+        }
+        len+=ret;
+        buf[len++] = ',';
+    }
+    UNLOCK_HOSTLIST(hl);
+
+    buf[len > 0 ? --len : 0] = '\0';
+    if (len == n)
+        truncated = 1;
+
+    return truncated ? -1 : len;
+}
+
+/* return true if a bracket is needed for the range at i in hostlist hl */
+static int _is_bracket_needed(hostlist_t hl, int i)
+{
+    hostrange_t h1 = hl->hr[i];
+    hostrange_t h2 = i < hl->nranges - 1 ? hl->hr[i + 1] : NULL;
+    return hostrange_count(h1) > 1 || hostrange_within_range(h1, h2);
+}
+
+/* write the next bracketed hostlist, i.e. prefix[n-m,k,...]
+ * into buf, writing at most n chars including the terminating '\0'
+ *
+ * leaves start pointing to one past last range object in bracketed list,
+ * and returns the number of bytes written into buf.
+ *
+ * Assumes hostlist is locked.
+ */
+static int
+_get_bracketed_list(hostlist_t hl, int *start, const size_t n, char *buf)
+{
+    hostrange_t *hr = hl->hr;
+    int i = *start;
+    int m, len = 0;
+    int bracket_needed = _is_bracket_needed(hl, i);
+
+    len = snprintf(buf, n, "%s", hr[i]->prefix);
+
+    if ((len < 0) || (len > n))
+        return n; /* truncated, buffer filled */
+
+    if (bracket_needed && len < n)
+        buf[len++] = '[';
+
+    do {
+        m = (n - len) <= n ? n - len : 0;
+        len += hostrange_numstr(hr[i], m, buf + len);
+        if (len >= n)
+            break;
+        if (bracket_needed) /* Only need commas inside brackets */
+            buf[len++] = ',';
+    } while (++i < hl->nranges && hostrange_within_range(hr[i], hr[i-1]));
+
+    if (bracket_needed && len < n && len > 0) {
+
+        /* Add trailing bracket (change trailing "," from above to "]" */
+        buf[len - 1] = ']';
+
+        /* NUL terminate for safety, but do not add terminator to len */
+        buf[len]   = '\0';
+
+    } else if (len >= n) {
+        if (n > 0)
+            buf[n-1] = '\0';
 
     } else {
         /* If len is > 0, NUL terminate (but do not add to len) */
@@ -2278,7 +3448,8 @@ static void _iterator_advance(hostlist_iterator_t i)
         return;
     if (++(i->depth) > (i->hr->hi - i->hr->lo)) {
         i->depth = 0;
-        i->hr = i->hl->hr[++i->idx];
+        if (++i->idx < i->hl->nranges)
+            i->hr = i->hl->hr[i->idx];
     }
 }
 
@@ -2299,125 +3470,670 @@ static void _iterator_advance_range(hostlist_iterator_t i)
     if (++i->depth > 0) {
         while (++j < nr && hostrange_within_range(i->hr, hr[j])) {;}
         i->idx = j;
-        i->hr = i->hl->hr[i->idx];
+        if (j < nr)
+            i->hr = hr[j];
         i->depth = 0;
     }
 }
 
-char *hostlist_next(hostlist_iterator_t i)
+/* Write the host at the current position of iterator i into buf,
+ * as snprintf(3) would. Assumes i->hl is locked by the caller.
+ */
+static int _iterator_host_string(hostlist_iterator_t i, char *buf, size_t n)
+{
+    if (i->hr->singlehost)
+        return snprintf(buf, n, "%s", i->hr->prefix);
+    return snprintf(buf, n, "%s%0*lu", i->hr->prefix, i->hr->width,
+                    i->hr->lo + i->depth);
+}
+
+char *hostlist_next(hostlist_iterator_t i)
+{
+    char *buf = NULL;
+    char host[256];
+    int len;
+    assert(i != NULL);
+    assert(i->magic == HOSTLIST_MAGIC);
+    LOCK_HOSTLIST(i->hl);
+    _iterator_advance(i);
+
+    if (i->idx > i->hl->nranges - 1) {
+        UNLOCK_HOSTLIST(i->hl);
+        return NULL;
+    }
+
+    len = _iterator_host_string(i, host, sizeof(host));
+    if (!(buf = malloc(len + 1)))
+        out_of_memory("hostlist_next");
+
+    if (len < (int) sizeof(host))
+        memcpy(buf, host, len + 1);
+    else
+        _iterator_host_string(i, buf, len + 1);
+
+    UNLOCK_HOSTLIST(i->hl);
+    return (buf);
+}
+
+int hostlist_next_r(hostlist_iterator_t i, char *buf, size_t n)
+{
+    int len = 0;
+    assert(i != NULL);
+    assert(i->magic == HOSTLIST_MAGIC);
+    LOCK_HOSTLIST(i->hl);
+    _iterator_advance(i);
+
+    if (i->idx <= i->hl->nranges - 1)
+        len = _iterator_host_string(i, buf, n);
+
+    UNLOCK_HOSTLIST(i->hl);
+    return (len);
+}
+
+char *hostlist_next_range(hostlist_iterator_t i)
+{
+    char buf[MAXHOSTRANGELEN + 1];
+    int j;
+
+    assert(i != NULL);
+    assert(i->magic == HOSTLIST_MAGIC);
+    LOCK_HOSTLIST(i->hl);
+
+    _iterator_advance_range(i);
+
+    if (i->idx > i->hl->nranges - 1) {
+        UNLOCK_HOSTLIST(i->hl);
+        return NULL;
+    }
+
+    j = i->idx;
+    _get_bracketed_list(i->hl, &j, MAXHOSTRANGELEN, buf);
+
+    UNLOCK_HOSTLIST(i->hl);
+
+    return strdup(buf);
+}
+
+int hostlist_remove(hostlist_iterator_t i)
+{
+    hostrange_t new;
+    assert(i != NULL);
+    assert(i->magic == HOSTLIST_MAGIC);
+    LOCK_HOSTLIST(i->hl);
+    new = hostrange_delete_host(i->hr, i->hr->lo + i->depth);
+    if (new) {
+        hostlist_insert_range(i->hl, new, i->idx + 1);
+        hostrange_destroy(new);
+        i->hr = i->hl->hr[++i->idx];
+        i->depth = -1;
+    } else if (hostrange_empty(i->hr)) {
+        hostlist_delete_range(i->hl, i->idx);
+    } else
+        i->depth--;
+
+    i->hl->nhosts--;
+    UNLOCK_HOSTLIST(i->hl);
+
+    return 1;
+}
+
+/* ----[ hostset index ]---- */
+
+/*
+ *  A hostset keeps its hosts in a sorted hostlist, which defines its
+ *   string form and iteration order, and indexes them for constant time
+ *   lookup. The index is a hash table of host families, each a prefix
+ *   and digit count as used by the set operations above, that maps a
+ *   family to a compressed bitmap of the values of its trailing digits.
+ *
+ *  Bitmaps are split into chunks of 65536 values. A chunk stores a
+ *   sorted array of values until it holds HOSTBITMAP_ARRAY_MAX of them
+ *   and a plain bitmap after that, so that both sparse and dense
+ *   families stay small.
+ */
+#define HOSTBITMAP_CHUNK_BITS   16
+#define HOSTBITMAP_CHUNK_MASK   ((1UL << HOSTBITMAP_CHUNK_BITS) - 1)
+#define HOSTBITMAP_WORDS        ((1 << HOSTBITMAP_CHUNK_BITS) / 64)
+#define HOSTBITMAP_ARRAY_MAX    4096
+
+struct hostbitmap_chunk {
+    unsigned long key;      /* high bits of values in this chunk    */
+    int count;              /* number of values in chunk            */
+    int size;               /* allocated length of vals             */
+    uint16_t *vals;         /* sorted low bits, or NULL if bitmap   */
+    uint64_t *bits;         /* bitmap, or NULL if array             */
+};
+
+struct hostfamily {
+    char *prefix;           /* NULL if hash slot is empty           */
+    int digits;
+    struct hostbitmap_chunk *chunk;     /* sorted by key            */
+    int nchunks;
+    int size;
+};
+
+struct hostset_index {
+    struct hostfamily *tab; /* open addressed hash table            */
+    int size;               /* table size, a power of two           */
+    int n;                  /* number of families in table          */
+    int count;              /* number of hosts in index             */
+};
+
+static int _popcount64(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int) ((x * 0x0101010101010101ULL) >> 56);
+}
+
+/* return a mask of bits lo through hi (inclusive) of a 64 bit word
+ */
+static uint64_t _word_mask(int lo, int hi)
+{
+    uint64_t m = (hi == 63) ? ~0ULL : ((1ULL << (hi + 1)) - 1);
+    return m & ~((1ULL << lo) - 1);
+}
+
+/* return index of first value >= v in array chunk c
+ */
+static int _chunk_search(struct hostbitmap_chunk *c, unsigned int v)
+{
+    int lo = 0, hi = c->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (c->vals[mid] < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int _chunk_to_bitmap(struct hostbitmap_chunk *c)
+{
+    int i;
+    if (!(c->bits = calloc(HOSTBITMAP_WORDS, sizeof(uint64_t))))
+        return -1;
+    for (i = 0; i < c->count; i++)
+        c->bits[c->vals[i] / 64] |= 1ULL << (c->vals[i] % 64);
+    free(c->vals);
+    c->vals = NULL;
+    c->size = 0;
+    return 0;
+}
+
+/* Add values lo through hi to chunk c.
+ * Returns the number of values not already present, or -1 on failure.
+ */
+static int _chunk_set_range(struct hostbitmap_chunk *c,
+                            unsigned int lo, unsigned int hi)
+{
+    int n = hi - lo + 1;
+    int added = 0;
+    int w;
+
+    if (c->bits == NULL && c->count + n > HOSTBITMAP_ARRAY_MAX
+        && _chunk_to_bitmap(c) < 0)
+        return -1;
+
+    if (c->bits) {
+        for (w = lo / 64; w <= hi / 64; w++) {
+            uint64_t m = _word_mask(w == lo / 64 ? lo % 64 : 0,
+                                    w == hi / 64 ? hi % 64 : 63);
+            added += _popcount64(m & ~c->bits[w]);
+            c->bits[w] |= m;
+        }
+    } else {
+        int i = _chunk_search(c, lo);
+        int j = _chunk_search(c, hi + 1);
+        int present = j - i;
+        unsigned int v;
+
+        if ((added = n - present) == 0)
+            return 0;
+
+        if (c->count + added > c->size) {
+            int size = c->count + added + 16;
+            uint16_t *new = realloc(c->vals, size * sizeof(uint16_t));
+            if (new == NULL)
+                return -1;
+            c->vals = new;
+            c->size = size;
+        }
+        /*  Values lo..hi replace the present ones in vals[i..j) */
+        memmove(&c->vals[i + n], &c->vals[j],
+                (c->count - j) * sizeof(uint16_t));
+        for (v = lo; v <= hi; v++)
+            c->vals[i++] = v;
+    }
+    c->count += added;
+    return added;
+}
+
+/* Remove values lo through hi from chunk c.
+ * Returns the number of values removed.
+ */
+static int _chunk_clear_range(struct hostbitmap_chunk *c,
+                              unsigned int lo, unsigned int hi)
+{
+    int removed = 0;
+    int w;
+
+    if (c->bits) {
+        for (w = lo / 64; w <= hi / 64; w++) {
+            uint64_t m = _word_mask(w == lo / 64 ? lo % 64 : 0,
+                                    w == hi / 64 ? hi % 64 : 63);
+            removed += _popcount64(m & c->bits[w]);
+            c->bits[w] &= ~m;
+        }
+    } else {
+        int i = _chunk_search(c, lo);
+        int j = _chunk_search(c, hi + 1);
+        removed = j - i;
+        memmove(&c->vals[i], &c->vals[j], (c->count - j) * sizeof(uint16_t));
+    }
+    c->count -= removed;
+    return removed;
+}
+
+/* Return 1 if all values lo through hi are in chunk c
+ */
+static int _chunk_test_range(struct hostbitmap_chunk *c,
+                             unsigned int lo, unsigned int hi)
+{
+    int w;
+
+    if (c->bits) {
+        for (w = lo / 64; w <= hi / 64; w++) {
+            uint64_t m = _word_mask(w == lo / 64 ? lo % 64 : 0,
+                                    w == hi / 64 ? hi % 64 : 63);
+            if ((c->bits[w] & m) != m)
+                return 0;
+        }
+        return 1;
+    }
+    /*  Values are sorted and unique, so lo..hi are all present
+     *   iff there are exactly hi - lo + 1 values in that interval */
+    return (_chunk_search(c, hi + 1) - _chunk_search(c, lo)
+            == (int) (hi - lo + 1));
+}
+
+/* Return the chunk of family f with the given key, creating it if
+ * `create' is set. Returns NULL if not found or allocation fails.
+ */
+static struct hostbitmap_chunk *
+_family_chunk(struct hostfamily *f, unsigned long key, int create)
+{
+    int lo = 0, hi = f->nchunks;
+    struct hostbitmap_chunk *c;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (f->chunk[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < f->nchunks && f->chunk[lo].key == key)
+        return &f->chunk[lo];
+    if (!create)
+        return NULL;
+
+    if (f->nchunks == f->size) {
+        int size = f->size ? f->size * 2 : 4;
+        c = realloc(f->chunk, size * sizeof(*c));
+        if (c == NULL)
+            return NULL;
+        f->chunk = c;
+        f->size = size;
+    }
+    memmove(&f->chunk[lo + 1], &f->chunk[lo],
+            (f->nchunks - lo) * sizeof(*c));
+    f->nchunks++;
+
+    c = &f->chunk[lo];
+    memset(c, 0, sizeof(*c));
+    c->key = key;
+    return c;
+}
+
+/* Apply operation op (0 = clear, 1 = set, 2 = test) to values lo
+ * through hi of family f. Returns the number of values changed for
+ * set and clear, -1 if allocation fails, and 1 or 0 for test.
+ */
+static int _family_range_op(struct hostfamily *f, unsigned long lo,
+                            unsigned long hi, int op)
+{
+    unsigned long key;
+    int n = 0;
+
+    for (key = lo >> HOSTBITMAP_CHUNK_BITS;
+         key <= hi >> HOSTBITMAP_CHUNK_BITS; key++) {
+        struct hostbitmap_chunk *c = _family_chunk(f, key, op == 1);
+        unsigned int l = (key == lo >> HOSTBITMAP_CHUNK_BITS) ?
+                         lo & HOSTBITMAP_CHUNK_MASK : 0;
+        unsigned int h = (key == hi >> HOSTBITMAP_CHUNK_BITS) ?
+                         hi & HOSTBITMAP_CHUNK_MASK : HOSTBITMAP_CHUNK_MASK;
+        int rc;
+
+        if (c == NULL) {
+            if (op == 1)
+                return -1;
+            if (op == 2)
+                return 0;
+        } else if (op == 1) {
+            if ((rc = _chunk_set_range(c, l, h)) < 0)
+                return -1;
+            n += rc;
+        } else if (op == 0)
+            n += _chunk_clear_range(c, l, h);
+        else if (!_chunk_test_range(c, l, h))
+            return 0;
+
+        if (key == ~0UL >> HOSTBITMAP_CHUNK_BITS)
+            break;
+    }
+    return (op == 2) ? 1 : n;
+}
+
+static void _family_free(struct hostfamily *f)
+{
+    int i;
+    for (i = 0; i < f->nchunks; i++) {
+        free(f->chunk[i].vals);
+        free(f->chunk[i].bits);
+    }
+    free(f->chunk);
+    free(f->prefix);
+}
+
+static unsigned long _family_hash(const char *prefix, int len, int digits)
+{
+    unsigned long h = 2166136261UL;
+    int i;
+    for (i = 0; i < len; i++)
+        h = (h ^ (unsigned char) prefix[i]) * 16777619UL;
+    return (h ^ (unsigned long) (digits + 1)) * 16777619UL;
+}
+
+static struct hostset_index *_hostset_index_new(void)
+{
+    struct hostset_index *idx = calloc(1, sizeof(*idx));
+    if (idx == NULL)
+        return NULL;
+    idx->size = 64;
+    if (!(idx->tab = calloc(idx->size, sizeof(struct hostfamily)))) {
+        free(idx);
+        return NULL;
+    }
+    return idx;
+}
+
+static void _hostset_index_destroy(struct hostset_index *idx)
+{
+    int i;
+    if (idx == NULL)
+        return;
+    for (i = 0; i < idx->size; i++) {
+        if (idx->tab[i].prefix)
+            _family_free(&idx->tab[i]);
+    }
+    free(idx->tab);
+    free(idx);
+}
+
+static int _hostset_index_grow(struct hostset_index *idx)
+{
+    struct hostfamily *old = idx->tab;
+    int oldsize = idx->size;
+    int i;
+
+    if (!(idx->tab = calloc(oldsize * 2, sizeof(struct hostfamily)))) {
+        idx->tab = old;
+        return -1;
+    }
+    idx->size = oldsize * 2;
+
+    for (i = 0; i < oldsize; i++) {
+        struct hostfamily *f = &old[i];
+        unsigned long h;
+        if (f->prefix == NULL)
+            continue;
+        h = _family_hash(f->prefix, strlen(f->prefix), f->digits);
+        while (idx->tab[h & (idx->size - 1)].prefix)
+            h++;
+        idx->tab[h & (idx->size - 1)] = *f;
+    }
+    free(old);
+    return 0;
+}
+
+/* Return the family for the first `len' chars of prefix and digits,
+ * adding it to the index if `create' is set.
+ */
+static struct hostfamily *
+_hostset_index_family(struct hostset_index *idx, const char *prefix,
+                      int len, int digits, int create)
+{
+    unsigned long h = _family_hash(prefix, len, digits);
+    struct hostfamily *f;
+
+    for (;; h++) {
+        f = &idx->tab[h & (idx->size - 1)];
+        if (f->prefix == NULL)
+            break;
+        if (f->digits == digits && strncmp(f->prefix, prefix, len) == 0
+            && f->prefix[len] == '\0')
+            return f;
+    }
+    if (!create)
+        return NULL;
+
+    if ((idx->n + 1) * 4 > idx->size * 3) {
+        if (_hostset_index_grow(idx) < 0)
+            return NULL;
+        return _hostset_index_family(idx, prefix, len, digits, create);
+    }
+
+    if (!(f->prefix = malloc(len + 1)))
+        return NULL;
+    memcpy(f->prefix, prefix, len);
+    f->prefix[len] = '\0';
+    f->digits = digits;
+    idx->n++;
+    return f;
+}
+
+/* Apply op (see _family_range_op()) to every host in hostlist hl.
+ * Returns the number of hosts changed, or for test, 1 if all hosts
+ * in hl are in the index. Returns -1 if allocation fails.
+ */
+static int _hostset_index_list_op(struct hostset_index *idx, hostlist_t hl,
+                                  int op)
 {
-    char *buf = NULL;
-    char suffix[16];
-    int len = 0;
-    assert(i != NULL);
-    assert(i->magic == HOSTLIST_MAGIC);
-    LOCK_HOSTLIST(i->hl);
-    _iterator_advance(i);
-
-    if (i->idx > i->hl->nranges - 1) {
-        UNLOCK_HOSTLIST(i->hl);
-        return NULL;
-    }
+    struct hostseg_array *a;
+    int i, rc, n = 0;
 
-    suffix[0] = '\0';
+    if (!(a = _hostseg_array_create(hl)))
+        return -1;
 
-    if (!i->hr->singlehost)
-        snprintf (suffix, 15, "%0*lu", i->hr->width, i->hr->lo + i->depth);
+    for (i = 0; i < a->n; i++) {
+        struct hostseg *s = &a->seg[i];
+        struct hostfamily *f = _hostset_index_family(idx, s->prefix,
+                                                     strlen(s->prefix),
+                                                     s->digits, op == 1);
+        if (f == NULL) {
+            if (op == 1) {
+                n = -1;
+                break;
+            }
+            if (op == 2) {
+                n = 0;
+                break;
+            }
+            continue;
+        }
+        if ((rc = _family_range_op(f, s->lo, s->hi, op)) < 0) {
+            n = -1;
+            break;
+        }
+        if (op == 2 && rc == 0) {
+            n = 0;
+            break;
+        }
+        n = (op == 2) ? 1 : n + rc;
+    }
+    if (op == 2 && a->n == 0)
+        n = 1;
 
-    len = strlen (i->hr->prefix) + strlen (suffix) + 1;
-    if (!(buf = malloc (len)))
-        out_of_memory("hostlist_next");
-    
-    buf[0] = '\0';
-    strcat (buf, i->hr->prefix);
-    strcat (buf, suffix);
+    if (op == 1 && n > 0)
+        idx->count += n;
+    else if (op == 0)
+        idx->count -= n;
 
-    UNLOCK_HOSTLIST(i->hl);
-    return (buf);
+    _hostseg_array_destroy(a);
+    return n;
 }
 
-char *hostlist_next_range(hostlist_iterator_t i)
+/* Add the hosts in hostlist hl to the index, and set fresh[i] for each
+ * range i of hl holding at least one host that was not already there.
+ * Returns the number of hosts added, or -1 on failure.
+ */
+static int _hostset_index_insert(struct hostset_index *idx, hostlist_t hl,
+                                 char *fresh)
 {
-    char buf[MAXHOSTRANGELEN + 1];
-    int j;
-
-    assert(i != NULL);
-    assert(i->magic == HOSTLIST_MAGIC);
-    LOCK_HOSTLIST(i->hl);
+    struct hostseg_array *a;
+    int i, j, n = 0;
 
-    _iterator_advance_range(i);
+    if (!(a = calloc(1, sizeof(*a))))
+        return -1;
 
-    if (i->idx > i->hl->nranges - 1) {
-        UNLOCK_HOSTLIST(i->hl);
-        return NULL;
+    for (i = 0; i < hl->nranges && n >= 0; i++) {
+        j = a->n;
+        if (_hostseg_append_range(a, hl->hr[i]) < 0) {
+            n = -1;
+            break;
+        }
+        for (; j < a->n; j++) {
+            struct hostseg *s = &a->seg[j];
+            struct hostfamily *f = _hostset_index_family(idx, s->prefix,
+                                                         strlen(s->prefix),
+                                                         s->digits, 1);
+            int rc;
+
+            if (f == NULL || (rc = _family_range_op(f, s->lo, s->hi, 1)) < 0) {
+                n = -1;
+                break;
+            }
+            if (rc > 0)
+                fresh[i] = 1;
+            n += rc;
+            idx->count += rc;
+        }
     }
 
-    j = i->idx;
-    _get_bracketed_list(i->hl, &j, MAXHOSTRANGELEN, buf);
-
-    UNLOCK_HOSTLIST(i->hl);
+    _hostseg_array_destroy(a);
+    return n;
+}
 
-    return strdup(buf);
+/* Apply op (0 = clear or 2 = test) to a single hostname. Returns 1 if
+ * the host was removed or found, 0 otherwise.
+ */
+static int _hostset_index_host_op(struct hostset_index *idx,
+                                  const char *host, int op)
+{
+    int len = strlen(host);
+    int k = _trailing_digits(host, len);
+    unsigned long v = 0;
+    struct hostfamily *f;
+    int rc;
+
+    if (k > _ulong_digits())
+        f = _hostset_index_family(idx, host, len, -1, 0);
+    else {
+        if (k > 0)
+            v = strtoul(host + len - k, NULL, 10);
+        f = _hostset_index_family(idx, host, len - k, k, 0);
+    }
+    if (f == NULL)
+        return 0;
+    rc = _family_range_op(f, v, v, op);
+    if (op == 0)
+        idx->count -= rc;
+    return rc;
 }
 
-int hostlist_remove(hostlist_iterator_t i)
+/* Rebuild the index of set if it no longer matches the hostlist, which
+ * happens if hosts were removed through a hostset iterator.
+ * Returns 0 on success, -1 if allocation fails.
+ */
+static int _hostset_index_check(hostset_t set)
 {
-    hostrange_t new;
-    assert(i != NULL);
-    assert(i->magic == HOSTLIST_MAGIC);
-    LOCK_HOSTLIST(i->hl);
-    new = hostrange_delete_host(i->hr, i->hr->lo + i->depth);
-    if (new) {
-        hostlist_insert_range(i->hl, new, i->idx + 1);
-        hostrange_destroy(new);
-        i->hr = i->hl->hr[++i->idx];
-        i->depth = -1;
-    } else if (hostrange_empty(i->hr)) {
-        hostlist_delete_range(i->hl, i->idx);
-    } else
-        i->depth--;
+    struct hostset_index *idx;
 
-    i->hl->nhosts--;
-    UNLOCK_HOSTLIST(i->hl);
+    if (set->idx && set->idx->count == hostlist_count(set->hl))
+        return 0;
 
-    return 1;
+    if (!(idx = _hostset_index_new()))
+        return -1;
+    if (_hostset_index_list_op(idx, set->hl, 1) < 0) {
+        _hostset_index_destroy(idx);
+        return -1;
+    }
+    _hostset_index_destroy(set->idx);
+    set->idx = idx;
+    return 0;
 }
 
 /* ----[ hostset functions ]---- */
 
-hostset_t hostset_create(const char *hostlist)
+/* Create a hostset around the sorted, unique hostlist hl.
+ * hl is destroyed if the hostset cannot be created.
+ */
+static hostset_t _hostset_new(hostlist_t hl)
 {
     hostset_t new;
 
+    if (hl == NULL)
+        return NULL;
+
     if (!(new = (hostset_t) malloc(sizeof(*new))))
         goto error1;
 
-    if (!(new->hl = hostlist_create(hostlist)))
+    new->hl = hl;
+    new->idx = NULL;
+    if (_hostset_index_check(new) < 0)
         goto error2;
 
-    hostlist_uniq(new->hl);
     return new;
 
   error2:
     free(new);
   error1:
+    hostlist_destroy(hl);
     return NULL;
 }
 
-hostset_t hostset_copy(const hostset_t set)
+hostset_t hostset_create(const char *hostlist)
 {
-    hostset_t new;
-    if (!(new = (hostset_t) malloc(sizeof(*new))))
-        goto error1;
+    hostlist_t hl = hostlist_create(hostlist);
+    if (hl)
+        hostlist_uniq(hl);
+    return _hostset_new(hl);
+}
 
-    if (!(new->hl = hostlist_copy(set->hl)))
-        goto error2;
+hostset_t hostset_create_hostlist(hostlist_t hl)
+{
+    hostlist_t new = hostlist_copy(hl);
+    if (new)
+        hostlist_uniq(new);
+    return _hostset_new(new);
+}
 
-    return new;
-  error2:
-    free(new);
-  error1:
-    return NULL;
+hostset_t hostset_copy(const hostset_t set)
+{
+    return _hostset_new(hostlist_copy(set->hl));
 }
 
 void hostset_destroy(hostset_t set)
@@ -2425,6 +4141,7 @@ void hostset_destroy(hostset_t set)
     if (set == NULL)
         return;
     hostlist_destroy(set->hl);
+    _hostset_index_destroy(set->idx);
     free(set);
 }
 
@@ -2456,14 +4173,15 @@ static int hostset_insert_range(hostset_t set, hostrange_t hr)
                 ndups = 0;
 
             hostlist_insert_range(hl, hr, i);
+            hl->nhosts += nhosts - ndups;
 
-            /* now attempt to join hr[i] and hr[i-1] */
+            /* now attempt to join hr[i] and hr[i-1]
+             * (_attempt_range_join() adjusts hl->nhosts itself) */
             if (i > 0) {
                 int m;
                 if ((m = _attempt_range_join(hl, i)) > 0)
                     ndups += m;
             }
-            hl->nhosts += nhosts - ndups;
             inserted = 1;
             break;
         }
@@ -2487,93 +4205,140 @@ static int hostset_insert_range(hostset_t set, hostrange_t hr)
 int hostset_insert(hostset_t set, const char *hosts)
 {
     int i, n = 0;
-    hostlist_t hl = hostlist_create(hosts);
-    if (!hl)
-        return 0;
+    hostlist_t hl;
+    char *fresh;
 
+    if (!(hl = hostlist_create(hosts)))
+        return 0;
     hostlist_uniq(hl);
-    LOCK_HOSTLIST(set->hl);
-    for (i = 0; i < hl->nranges; i++) 
-        n += hostset_insert_range(set, hl->hr[i]);
-    UNLOCK_HOSTLIST(set->hl);
-    hostlist_destroy(hl);
-    return n;
-}
 
+    /*
+     *  The index picks out the ranges of hl with hosts not already in
+     *   the set. Only those are merged into the sorted hostlist, as
+     *   given, so the set prints just as if every range were merged.
+     */
+    if (_hostset_index_check(set) < 0
+        || !(fresh = calloc(hl->nranges + 1, 1))) {
+        hostlist_destroy(hl);
+        return 0;
+    }
 
-/* linear search through N ranges for hostname "host"
- * */
-static int hostset_find_host(hostset_t set, const char *host)
-{
-    int i;
-    int retval = 0;
-    hostname_t hn;
-    LOCK_HOSTLIST(set->hl);
-    hn = hostname_create(host);
-    for (i = 0; i < set->hl->nranges; i++) {
-        if (hostrange_hn_within(set->hl->hr[i], hn) >= 0) {
-            retval = 1;
-            goto done;
+    if ((n = _hostset_index_insert(set->idx, hl, fresh)) > 0) {
+        LOCK_HOSTLIST(set->hl);
+        for (i = 0; i < hl->nranges; i++) {
+            if (fresh[i])
+                hostset_insert_range(set, hl->hr[i]);
         }
+        UNLOCK_HOSTLIST(set->hl);
     }
-  done:
-    UNLOCK_HOSTLIST(set->hl);
-    hostname_destroy(hn);
-    return retval;
+
+    free(fresh);
+    hostlist_destroy(hl);
+    return n < 0 ? 0 : n;
+}
+
+int hostset_find_host(hostset_t set, const char *host)
+{
+    if (_hostset_index_check(set) < 0)
+        return 0;
+    return _hostset_index_host_op(set->idx, host, 2);
 }
 
 int hostset_within(hostset_t set, const char *hosts)
 {
-    int nhosts, nfound;
+    int rc;
     hostlist_t hl;
-    char *hostname;
 
     assert(set->hl->magic == HOSTLIST_MAGIC);
 
     if (!(hl = hostlist_create(hosts)))
         return (0);
 
-    nhosts = hostlist_count(hl);
-    nfound = 0;
-
-    while ((hostname = hostlist_pop(hl)) != NULL) {
-        nfound += hostset_find_host(set, hostname);
-        free(hostname);
-    }
+    rc = (_hostset_index_check(set) == 0
+          && _hostset_index_list_op(set->idx, hl, 2) == 1);
 
     hostlist_destroy(hl);
 
-    return (nhosts == nfound);
+    return (rc);
 }
 
 int hostset_delete(hostset_t set, const char *hosts)
 {
-    return hostlist_delete(set->hl, hosts);
+    int n = 0;
+    char *hostname;
+    hostlist_t hl;
+
+    if (!(hl = hostlist_create(hosts)))
+        seterrno_ret(EINVAL, 0);
+
+    while ((hostname = hostlist_pop(hl)) != NULL) {
+        n += hostset_delete_host(set, hostname);
+        free(hostname);
+    }
+    hostlist_destroy(hl);
+
+    return n;
 }
 
 int hostset_delete_host(hostset_t set, const char *hostname)
 {
-    return hostlist_delete_host(set->hl, hostname);
+    /*
+     *  Only search the hostlist for hosts the index says are there
+     */
+    if (_hostset_index_check(set) < 0
+        || !_hostset_index_host_op(set->idx, hostname, 2))
+        return 0;
+
+    if (!hostlist_delete_host(set->hl, hostname))
+        return 0;
+
+    _hostset_index_host_op(set->idx, hostname, 0);
+    return 1;
 }
 
 char *hostset_shift(hostset_t set)
 {
-    return hostlist_shift(set->hl);
+    char *host = hostlist_shift(set->hl);
+    if (host && set->idx)
+        _hostset_index_host_op(set->idx, host, 0);
+    return host;
 }
 
 char *hostset_pop(hostset_t set)
 {
-    return hostlist_pop(set->hl);
+    char *host = hostlist_pop(set->hl);
+    if (host && set->idx)
+        _hostset_index_host_op(set->idx, host, 0);
+    return host;
+}
+
+/* Remove the hosts in a string returned by hostlist_{shift,pop}_range()
+ * from the index of set.
+ */
+static void _hostset_index_remove_range(hostset_t set, const char *hosts)
+{
+    hostlist_t hl;
+
+    if (hosts == NULL || set->idx == NULL)
+        return;
+    if ((hl = hostlist_create(hosts))) {
+        _hostset_index_list_op(set->idx, hl, 0);
+        hostlist_destroy(hl);
+    }
 }
 
 char *hostset_shift_range(hostset_t set)
 {
-    return hostlist_shift_range(set->hl);
+    char *hosts = hostlist_shift_range(set->hl);
+    _hostset_index_remove_range(set, hosts);
+    return hosts;
 }
 
 char *hostset_pop_range(hostset_t set)
 {
-    return hostlist_pop_range(set->hl);
+    char *hosts = hostlist_pop_range(set->hl);
+    _hostset_index_remove_range(set, hosts);
+    return hosts;
 }
 
 int hostset_count(hostset_t set)
@@ -2591,6 +4356,305 @@ ssize_t hostset_deranged_string(hostset_t set, size_t n, char *buf)
     return hostlist_deranged_string(set->hl, n, buf);
 }
 
+/* ----[ frozen hostlist functions ]---- */
+
+/*
+ *  A frozen hostlist is a read-only copy of a hostlist held in flat
+ *   arrays, one entry per range. It has no mutex or iterators, so any
+ *   number of threads may query it at once.
+ *
+ *   Each distinct prefix is stored once in names[]. For lookups the
+ *   prefixes are kept in an open hash table of "families", and the
+ *   ranges of each family are listed in byfam[] ordered by lo, with
+ *   the running maximum of hi in maxhi[], so the ranges containing a
+ *   value are found by binary search.
+ */
+struct frozen_family {
+    int name;               /* offset of prefix in names[], -1 if empty */
+    int singlehost;
+    int start;              /* ranges of this family are byfam[start..] */
+    int n;
+};
+
+struct hostlist_frozen {
+    int nranges;
+    int nhosts;
+
+    char *names;            /* distinct prefixes, NUL terminated        */
+    int *prefix;            /* offset of each range's prefix in names[] */
+    unsigned long *lo;
+    unsigned long *hi;
+    int *width;             /* -1 for a singlehost range                */
+    int *first;             /* position of the first host of each range */
+
+    struct frozen_family *fam;
+    int famsize;            /* number of slots in fam[], a power of 2   */
+    int *byfam;
+    unsigned long *maxhi;
+};
+
+struct frozen_sortent {
+    int fam;
+    unsigned long lo;
+    int idx;
+};
+
+static int _frozen_sortent_cmp(const void *x, const void *y)
+{
+    const struct frozen_sortent *a = x;
+    const struct frozen_sortent *b = y;
+
+    if (a->fam != b->fam)
+        return (a->fam < b->fam ? -1 : 1);
+    if (a->lo != b->lo)
+        return (a->lo < b->lo ? -1 : 1);
+    return (a->idx - b->idx);
+}
+
+/* Return the slot of the family for the first len chars of prefix in f,
+ * or the empty slot where it belongs. During hostlist_freeze() the
+ * names of new families are taken from src[] rather than names[].
+ */
+static int _frozen_family_slot(hostlist_frozen_t f, const char **src,
+                               const char *prefix, int len, int singlehost)
+{
+    unsigned long h = _family_hash(prefix, len, singlehost);
+    int mask = f->famsize - 1;
+
+    for (;; h++) {
+        struct frozen_family *fam = &f->fam[h & mask];
+        const char *name;
+
+        if (fam->name < 0)
+            break;
+        name = src ? src[h & mask] : f->names + fam->name;
+        if (fam->singlehost == singlehost
+            && strncmp(name, prefix, len) == 0 && name[len] == '\0')
+            break;
+    }
+    return (h & mask);
+}
+
+hostlist_frozen_t hostlist_freeze(hostlist_t hl)
+{
+    hostlist_frozen_t f;
+    struct frozen_sortent *ent = NULL;
+    const char **src = NULL;
+    size_t nameslen = 0;
+    int i, n;
+
+    assert(hl != NULL);
+    assert(hl->magic == HOSTLIST_MAGIC);
+
+    if (!(f = calloc(1, sizeof(*f))))
+        out_of_memory("hostlist_freeze");
+
+    LOCK_HOSTLIST(hl);
+
+    n = f->nranges = hl->nranges;
+    f->nhosts = hl->nhosts;
+    for (f->famsize = 16; f->famsize < 2 * n; f->famsize <<= 1) {;}
+
+    f->prefix = malloc(n * sizeof(int));
+    f->lo = malloc(n * sizeof(unsigned long));
+    f->hi = malloc(n * sizeof(unsigned long));
+    f->width = malloc(n * sizeof(int));
+    f->first = malloc(n * sizeof(int));
+    f->byfam = malloc(n * sizeof(int));
+    f->maxhi = malloc(n * sizeof(unsigned long));
+    f->fam = malloc(f->famsize * sizeof(struct frozen_family));
+    src = malloc(f->famsize * sizeof(char *));
+    ent = malloc(n * sizeof(*ent));
+    if ((n > 0 && (!f->prefix || !f->lo || !f->hi || !f->width
+                   || !f->first || !f->byfam || !f->maxhi || !ent))
+        || !f->fam || !src)
+        goto fail;
+
+    for (i = 0; i < f->famsize; i++) {
+        f->fam[i].name = -1;
+        f->fam[i].n = 0;
+    }
+
+    /*
+     *  First pass: copy the ranges and find their families. Family
+     *   names are pointers into hl until names[] can be sized.
+     */
+    for (i = 0; i < n; i++) {
+        hostrange_t hr = hl->hr[i];
+        int len = strlen(hr->prefix);
+        int slot = _frozen_family_slot(f, src, hr->prefix, len,
+                                       hr->singlehost);
+        struct frozen_family *fam = &f->fam[slot];
+
+        if (fam->name < 0) {
+            fam->name = 0;
+            fam->singlehost = hr->singlehost;
+            src[slot] = hr->prefix;
+            nameslen += len + 1;
+        }
+        fam->n++;
+
+        f->lo[i] = hr->lo;
+        f->hi[i] = hr->hi;
+        f->width[i] = hr->singlehost ? -1 : hr->width;
+        f->first[i] = i ? f->first[i - 1] + hostrange_count(hl->hr[i - 1]) : 0;
+        f->prefix[i] = slot;        /* replaced by name offset below */
+
+        ent[i].fam = slot;
+        ent[i].lo = hr->lo;
+        ent[i].idx = i;
+    }
+
+    if (!(f->names = malloc(nameslen + 1)))
+        goto fail;
+
+    /*
+     *  Second pass over the families: copy names and place each
+     *   family's ranges in byfam[]
+     */
+    for (i = 0, nameslen = 0, n = 0; i < f->famsize; i++) {
+        struct frozen_family *fam = &f->fam[i];
+        if (fam->name < 0)
+            continue;
+        fam->name = nameslen;
+        strcpy(f->names + nameslen, src[i]);
+        nameslen += strlen(src[i]) + 1;
+        fam->start = n;
+        n += fam->n;
+    }
+    UNLOCK_HOSTLIST(hl);
+
+    for (i = 0; i < f->nranges; i++)
+        f->prefix[i] = f->fam[f->prefix[i]].name;
+
+    qsort(ent, f->nranges, sizeof(*ent), &_frozen_sortent_cmp);
+    for (i = 0; i < f->nranges; i++) {
+        f->byfam[i] = ent[i].idx;
+        f->maxhi[i] = f->hi[ent[i].idx];
+        if (i > 0 && ent[i - 1].fam == ent[i].fam
+            && f->maxhi[i - 1] > f->maxhi[i])
+            f->maxhi[i] = f->maxhi[i - 1];
+    }
+
+    free(src);
+    free(ent);
+    return f;
+
+  fail:
+    UNLOCK_HOSTLIST(hl);
+    free(src);
+    free(ent);
+    hostlist_frozen_destroy(f);
+    out_of_memory("hostlist_freeze");
+}
+
+void hostlist_frozen_destroy(hostlist_frozen_t f)
+{
+    if (f == NULL)
+        return;
+    free(f->names);
+    free(f->prefix);
+    free(f->lo);
+    free(f->hi);
+    free(f->width);
+    free(f->first);
+    free(f->fam);
+    free(f->byfam);
+    free(f->maxhi);
+    free(f);
+}
+
+int hostlist_frozen_count(hostlist_frozen_t f)
+{
+    return (f->nhosts);
+}
+
+int hostlist_frozen_nth(hostlist_frozen_t f, int n, char *buf, size_t len)
+{
+    int lo = 0, hi = f->nranges - 1;
+
+    if (n < 0 || n >= f->nhosts) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    /* find the last range starting at or before host n */
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (f->first[mid] <= n)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    if (f->width[lo] < 0)
+        return snprintf(buf, len, "%s", f->names + f->prefix[lo]);
+    return snprintf(buf, len, "%s%0*lu", f->names + f->prefix[lo],
+                    f->width[lo], f->lo[lo] + (n - f->first[lo]));
+}
+
+/* Return the position of the first host in family fam with suffix
+ * value v printed with ndigits digits, or -1.
+ */
+static int _frozen_family_find(hostlist_frozen_t f, struct frozen_family *fam,
+                               unsigned long v, int ndigits)
+{
+    int lo = fam->start, hi = fam->start + fam->n - 1;
+    int pos = -1;
+
+    /* last range of the family with lo <= v */
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (f->lo[f->byfam[mid]] <= v)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    for (; lo >= fam->start && f->maxhi[lo] >= v; lo--) {
+        int r = f->byfam[lo];
+        int w = f->width[r];
+        int p;
+
+        if (f->lo[r] > v || f->hi[r] < v)
+            continue;
+        if (_num_digits(v) == ndigits ? w > ndigits : w != ndigits)
+            continue;
+        p = f->first[r] + (int) (v - f->lo[r]);
+        if (pos < 0 || p < pos)
+            pos = p;
+    }
+    return (pos);
+}
+
+int hostlist_frozen_find(hostlist_frozen_t f, const char *host)
+{
+    int len = strlen(host);
+    int k = _trailing_digits(host, len);
+    int j, slot, p, pos = -1;
+
+    slot = _frozen_family_slot(f, NULL, host, len, 1);
+    if (f->fam[slot].name >= 0)
+        pos = f->first[f->byfam[f->fam[slot].start]];
+
+    /*
+     *  The suffix may start at any of the trailing digits, since
+     *   prefixes may themselves end in digits, e.g. "n0[1-9]".
+     */
+    for (j = len - k; j < len; j++) {
+        if (len - j > _ulong_digits())
+            continue;
+        slot = _frozen_family_slot(f, NULL, host, j, 0);
+        if (f->fam[slot].name < 0)
+            continue;
+        p = _frozen_family_find(f, &f->fam[slot],
+                                strtoul(host + j, NULL, 10), len - j);
+        if (p >= 0 && (pos < 0 || p < pos))
+            pos = p;
+    }
+    return (pos);
+}
+
 #if TEST_MAIN 
 
 int hostlist_nranges(hostlist_t hl)
@@ -73,6 +73,12 @@ typedef struct hostset * hostset_t;
  */
 typedef struct hostlist_iterator * hostlist_iterator_t;
 
+/* A frozen hostlist is an immutable snapshot of a hostlist, created
+ * with hostlist_freeze(). It takes no locks, so many threads may
+ * query it at once.
+ */
+typedef struct hostlist_frozen * hostlist_frozen_t;
+
 /* ----[ hostlist_t functions: ]---- */
 
 /* ----[ hostlist creation and destruction ]---- */
@@ -86,6 +92,8 @@ typedef struct hostlist_iterator * hostlist_iterator_t;
  * bracketed hostlists separated by either `,' or whitespace. A bracketed 
  * hostlist is denoted by a common prefix followed by a list of numeric 
  * ranges contained within brackets: e.g. "tux[0-5,12,20-25]" 
+ * A hostname may contain several bracketed lists, and represents every
+ * combination of their values: e.g. "rack[1-2]-tux[0-5]" 
  *
  * Note: if this module is compiled with WANT_RECKLESS_HOSTRANGE_EXPANSION
  * defined, a much more loose interpretation of host ranges is used. 
@@ -153,6 +161,17 @@ int hostlist_push_host(hostlist_t hl, const char *host);
  */
 int hostlist_push_list(hostlist_t hl1, hostlist_t hl2);
 
+/* hostlist_split():
+ *
+ * Divide the hosts in hl, in order, between at most n new hostlists of
+ * nearly equal size, stored in parts[0], parts[1], ... so that pushing
+ * each part in turn onto an empty list would yield the hosts of hl.
+ * Ranges are split where needed. hl is not modified.
+ *
+ * Returns the number of hostlists created, or -1 on failure.
+ */
+int hostlist_split(hostlist_t hl, int n, hostlist_t parts[]);
+
 
 /* hostlist_pop():
  *
@@ -267,6 +286,61 @@ void hostlist_sort(hostlist_t hl);
 void hostlist_uniq(hostlist_t hl);
 
 
+/* ----[ hostlist set operations ]---- */
+
+/*  The following operations compare hostlists range by range, without
+ *  expanding either list to individual hostnames, so they are suitable
+ *  for very large lists. Hostnames are compared as strings, so that
+ *  "n0[1-9]" and "n[01-09]" name the same hosts. The ranges of a
+ *  result may be written differently than those of the arguments.
+ */
+
+/* hostlist_intersect():
+ *
+ * Return a new hostlist containing the hosts in h1 that are also in h2,
+ * in the order they appear in h1.
+ *
+ * Returns NULL if memory allocation fails.
+ */
+hostlist_t hostlist_intersect(hostlist_t h1, hostlist_t h2);
+
+/* hostlist_difference():
+ *
+ * Return a new hostlist containing the hosts in h1 that are not in h2,
+ * in the order they appear in h1.
+ *
+ * Returns NULL if memory allocation fails.
+ */
+hostlist_t hostlist_difference(hostlist_t h1, hostlist_t h2);
+
+/* hostlist_union():
+ *
+ * Return a new hostlist containing the hosts in h1 followed by the hosts
+ * in h2 that are not in h1.
+ *
+ * Returns NULL if memory allocation fails.
+ */
+hostlist_t hostlist_union(hostlist_t h1, hostlist_t h2);
+
+/* hostlist_symmetric_difference():
+ *
+ * Return a new hostlist containing the hosts in h1 that are not in h2,
+ * followed by the hosts in h2 that are not in h1.
+ *
+ * Returns NULL if memory allocation fails.
+ */
+hostlist_t hostlist_symmetric_difference(hostlist_t h1, hostlist_t h2);
+
+/* hostlist_subtract():
+ *
+ * Delete every host in h2 from hostlist h1, including duplicates.
+ * Iterators on h1 are reset.
+ *
+ * Returns the number of hosts deleted, or -1 if memory allocation fails.
+ */
+int hostlist_subtract(hostlist_t h1, hostlist_t h2);
+
+
 /* ----[ hostlist print functions ]---- */
 
 /* hostlist_ranged_string():
@@ -343,6 +417,17 @@ void hostlist_iterator_reset(hostlist_iterator_t i);
  */ 
 char * hostlist_next(hostlist_iterator_t i);
 
+/* hostlist_next_r():
+ *
+ * Advance iterator i and write the next hostname into buf of size n,
+ * without allocating memory. Returns the length of the hostname as
+ * snprintf(3) would, so the name was truncated if the return value
+ * is n or more, or 0 at the end of the list. The iterator advances
+ * even if the name was truncated, so a NULL buf with n == 0 may be
+ * used to measure every name in a list.
+ */
+int hostlist_next_r(hostlist_iterator_t i, char *buf, size_t n);
+
 
 /* hostlist_next_range():
  *
@@ -372,6 +457,12 @@ int hostlist_remove(hostlist_iterator_t i);
  */
 hostset_t hostset_create(const char *hostlist);
 
+/* hostset_create_hostlist():
+ *
+ * Create a new hostset object containing the hosts in hostlist hl.
+ */
+hostset_t hostset_create_hostlist(hostlist_t hl);
+
 /* hostset_copy():
  *
  * Copy a hostset object. Returned set must be freed with hostset_destroy().
@@ -396,12 +487,24 @@ int hostset_insert(hostset_t set, const char *hosts);
  */
 int hostset_delete(hostset_t set, const char *hosts);
 
+/* hostset_delete_host():
+ * Delete a single host from hostset "set."
+ * Returns 1 if the host was deleted, 0 if it was not in the set.
+ */
+int hostset_delete_host(hostset_t set, const char *hostname);
+
 /* hostset_within():
  * Return 1 if all hosts specified by "hosts" are within the hostset "set"
  * Retrun 0 if every host in "hosts" is not in the hostset "set"
  */
 int hostset_within(hostset_t set, const char *hosts);
 
+/* hostset_find_host():
+ * Return 1 if the single hostname "host" is in the hostset "set", else 0.
+ * Unlike hostlist_find(), this takes constant time.
+ */
+int hostset_find_host(hostset_t set, const char *host);
+
 /* hostset_shift():
  * hostset equivalent to hostlist_shift()
  */
@@ -417,5 +520,44 @@ char * hostset_shift_range(hostset_t set);
  */
 int hostset_count(hostset_t set);
 
+/* ----[ frozen hostlist operations ]---- */
+
+/* hostlist_freeze():
+ *
+ * Create a read-only snapshot of the hosts in hl, in the same order.
+ * Later changes to hl do not affect the snapshot. Returns NULL if
+ * memory could not be allocated.
+ *
+ * The returned object must be freed with hostlist_frozen_destroy().
+ */
+hostlist_frozen_t hostlist_freeze(hostlist_t hl);
+
+/* hostlist_frozen_destroy():
+ */
+void hostlist_frozen_destroy(hostlist_frozen_t f);
+
+/* hostlist_frozen_count():
+ * Return the number of hosts in frozen hostlist f.
+ */
+int hostlist_frozen_count(hostlist_frozen_t f);
+
+/* hostlist_frozen_nth():
+ *
+ * Write the nth host (counting from 0) of f into buf, writing at most
+ * len chars including the terminating NUL. Returns the length of the
+ * hostname as snprintf() does, so a NULL buf with len 0 may be used to
+ * size a buffer. Returns -1 with errno set to EINVAL if there is no
+ * nth host.
+ */
+int hostlist_frozen_nth(hostlist_frozen_t f, int n, char *buf, size_t len);
+
+/* hostlist_frozen_find():
+ *
+ * Return the position of the first occurrence of hostname host in f,
+ * or -1 if it is not found. Takes O(log n) time for a list without
+ * overlapping ranges.
+ */
+int hostlist_frozen_find(hostlist_frozen_t f, const char *host);
+
 
 #endif /* !_HOSTLIST_H */
@@ -0,0 +1,148 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#if !HAVE_ATOMIC_BUILTINS
+#  include <pthread.h>
+#endif
+
+#include "xatomic.h"
+
+#if HAVE_ATOMIC_BUILTINS
+
+long xatomic_add (long *p, long n)
+{
+    return (__atomic_add_fetch (p, n, __ATOMIC_RELAXED));
+}
+
+long xatomic_load (long *p)
+{
+    return (__atomic_load_n (p, __ATOMIC_ACQUIRE));
+}
+
+void xatomic_store (long *p, long v)
+{
+    __atomic_store_n (p, v, __ATOMIC_RELEASE);
+}
+
+int xatomic_load_int (int *p)
+{
+    return (__atomic_load_n (p, __ATOMIC_ACQUIRE));
+}
+
+int xatomic_xchg_int (int *p, int v)
+{
+    return (__atomic_exchange_n (p, v, __ATOMIC_ACQ_REL));
+}
+
+int xatomic_cas_int (int *p, int old, int new)
+{
+    return (__atomic_compare_exchange_n (p, &old, new, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+int xatomic_add_int (int *p, int n)
+{
+    return (__atomic_add_fetch (p, n, __ATOMIC_SEQ_CST));
+}
+
+#else /* !HAVE_ATOMIC_BUILTINS */
+
+static pthread_mutex_t xatomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+long xatomic_add (long *p, long n)
+{
+    long v;
+    pthread_mutex_lock (&xatomic_mutex);
+    v = (*p += n);
+    pthread_mutex_unlock (&xatomic_mutex);
+    return (v);
+}
+
+long xatomic_load (long *p)
+{
+    long v;
+    pthread_mutex_lock (&xatomic_mutex);
+    v = *p;
+    pthread_mutex_unlock (&xatomic_mutex);
+    return (v);
+}
+
+void xatomic_store (long *p, long v)
+{
+    pthread_mutex_lock (&xatomic_mutex);
+    *p = v;
+    pthread_mutex_unlock (&xatomic_mutex);
+}
+
+int xatomic_load_int (int *p)
+{
+    int v;
+    pthread_mutex_lock (&xatomic_mutex);
+    v = *p;
+    pthread_mutex_unlock (&xatomic_mutex);
+    return (v);
+}
+
+int xatomic_xchg_int (int *p, int v)
+{
+    int old;
+    pthread_mutex_lock (&xatomic_mutex);
+    old = *p;
+    *p = v;
+    pthread_mutex_unlock (&xatomic_mutex);
+    return (old);
+}
+
+int xatomic_cas_int (int *p, int old, int new)
+{
+    int rc = 0;
+    pthread_mutex_lock (&xatomic_mutex);
+    if (*p == old) {
+        *p = new;
+        rc = 1;
+    }
+    pthread_mutex_unlock (&xatomic_mutex);
+    return (rc);
+}
+
+int xatomic_add_int (int *p, int n)
+{
+    int v;
+    pthread_mutex_lock (&xatomic_mutex);
+    v = (*p += n);
+    pthread_mutex_unlock (&xatomic_mutex);
+    return (v);
+}
+
+#endif /* HAVE_ATOMIC_BUILTINS */
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,64 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _XATOMIC_H
+#define _XATOMIC_H
+
+/*
+ *  Atomic operations on shared counters and small integer fields.
+ *   These use the compiler __atomic builtins when configure found them,
+ *   and fall back to a single global mutex otherwise.
+ */
+
+/*
+ *  Add `n' to `*p' and return the new value.
+ */
+long xatomic_add (long *p, long n);
+
+/*
+ *  Read and write `*p' with acquire/release ordering.
+ */
+long xatomic_load (long *p);
+void xatomic_store (long *p, long v);
+
+/*
+ *  Integer variants, for fields such as thread state.
+ *   xatomic_xchg_int() stores `v' and returns the previous value.
+ *   xatomic_cas_int() stores `new' only if `*p' equals `old' and
+ *   returns nonzero if the store happened.
+ */
+int xatomic_load_int (int *p);
+int xatomic_xchg_int (int *p, int v);
+int xatomic_cas_int (int *p, int old, int new);
+
+/*
+ *  Add `n' to `*p' and return the new value. Unlike xatomic_add(), this
+ *   is a full barrier, so it may be paired with a later load of another
+ *   field to hand off between threads.
+ */
+int xatomic_add_int (int *p, int n);
+
+#endif /* !_XATOMIC_H */
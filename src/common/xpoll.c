@@ -36,6 +36,10 @@
 #endif /* HAVE_SYS_POLL_H */
 #endif /* HAVE_POLL_H */
 
+#if HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #include <sys/types.h>
 #include <sys/select.h>
 #include <sys/time.h>
@@ -201,7 +205,275 @@ int xpoll(struct xpollfd *xfds, int nfds, int timeout) {
     return _select(xfds, nfds, timeout);
 #endif     
 }
-   
+
+/*
+ * With epoll, the fds are also kept in pfds, so that a set can fall back
+ * to poll() if epoll refuses an fd (EPERM, e.g. for regular files).
+ */
+struct xpollset {
+    int maxfds;
+    int nfds;
+#if HAVE_EPOLL
+    int epfd;                   /* -1 once the set uses poll() */
+    struct epoll_event *events;
+#endif
+#if HAVE_POLL
+    struct pollfd *pfds;
+#else
+    struct xpollfd *xfds;
+#endif
+};
+
+#if HAVE_EPOLL
+static unsigned int _epoll_events(short events) {
+    unsigned int ev = 0;
+
+    if (events & XPOLLREAD)
+        ev |= EPOLLIN;
+    if (events & XPOLLWRITE)
+        ev |= EPOLLOUT;
+    return ev;
+}
+
+/*
+ * Stop using epoll for this set. The fds are all in pfds already.
+ */
+static void _epoll_fallback(xpollset_t ps) {
+    close(ps->epfd);
+    ps->epfd = -1;
+    Free((void **)&ps->events);
+}
+#endif /* HAVE_EPOLL */
+
+#if HAVE_POLL
+static int _pollset_find(xpollset_t ps, int fd) {
+    int i;
+
+    for (i = 0; i < ps->nfds; i++) {
+        if (ps->pfds[i].fd == fd)
+            return i;
+    }
+    return -1;
+}
+
+static short _poll_events(short events) {
+    short ev = 0;
+
+    if (events & XPOLLREAD)
+        ev |= POLLIN;
+    if (events & XPOLLWRITE)
+        ev |= POLLOUT;
+    return ev;
+}
+#else
+static int _pollset_find(xpollset_t ps, int fd) {
+    int i;
+
+    for (i = 0; i < ps->nfds; i++) {
+        if (ps->xfds[i].fd == fd)
+            return i;
+    }
+    return -1;
+}
+#endif /* HAVE_POLL */
+
+xpollset_t xpollset_create(int maxfds) {
+    xpollset_t ps;
+
+    if (maxfds <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ps = Malloc(sizeof(*ps));
+    ps->maxfds = maxfds;
+    ps->nfds = 0;
+#if HAVE_EPOLL
+    if ((ps->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        Free((void **)&ps);
+        return NULL;
+    }
+    ps->events = Malloc(maxfds * sizeof(struct epoll_event));
+#endif
+#if HAVE_POLL
+    ps->pfds = Malloc(maxfds * sizeof(struct pollfd));
+#else
+    ps->xfds = Malloc(maxfds * sizeof(struct xpollfd));
+#endif
+    return ps;
+}
+
+void xpollset_destroy(xpollset_t ps) {
+    if (ps == NULL)
+        return;
+#if HAVE_EPOLL
+    if (ps->epfd >= 0)
+        _epoll_fallback(ps);
+#endif
+#if HAVE_POLL
+    Free((void **)&ps->pfds);
+#else
+    Free((void **)&ps->xfds);
+#endif
+    Free((void **)&ps);
+}
+
+int xpollset_add(xpollset_t ps, int fd, short events) {
+#if HAVE_EPOLL
+    struct epoll_event ev;
+#endif
+
+    if (ps == NULL || fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (ps->nfds == ps->maxfds) {
+        errno = ENOSPC;
+        return -1;
+    }
+#if HAVE_EPOLL
+    ev.events = _epoll_events(events);
+    ev.data.fd = fd;
+    if (ps->epfd >= 0 && epoll_ctl(ps->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        if (errno != EPERM)
+            return -1;
+        _epoll_fallback(ps);
+    }
+#endif
+#if HAVE_POLL
+    ps->pfds[ps->nfds].fd = fd;
+    ps->pfds[ps->nfds].events = _poll_events(events);
+    ps->pfds[ps->nfds].revents = 0;
+#else
+    ps->xfds[ps->nfds].fd = fd;
+    ps->xfds[ps->nfds].events = events;
+    ps->xfds[ps->nfds].revents = 0;
+#endif
+    ps->nfds++;
+    return 0;
+}
+
+int xpollset_modify(xpollset_t ps, int fd, short events) {
+    int i;
+
+    if ((i = _pollset_find(ps, fd)) < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+#if HAVE_EPOLL
+    if (ps->epfd >= 0) {
+        struct epoll_event ev;
+
+        ev.events = _epoll_events(events);
+        ev.data.fd = fd;
+        if (epoll_ctl(ps->epfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+            return -1;
+    }
+#endif
+#if HAVE_POLL
+    ps->pfds[i].events = _poll_events(events);
+#else
+    ps->xfds[i].events = events;
+#endif
+    return 0;
+}
+
+int xpollset_remove(xpollset_t ps, int fd) {
+    int i;
+
+    if ((i = _pollset_find(ps, fd)) < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+#if HAVE_EPOLL
+    if (ps->epfd >= 0) {
+        struct epoll_event ev;  /* for kernels that require non-NULL */
+
+        if (epoll_ctl(ps->epfd, EPOLL_CTL_DEL, fd, &ev) < 0)
+            return -1;
+    }
+#endif
+    ps->nfds--;
+#if HAVE_POLL
+    ps->pfds[i] = ps->pfds[ps->nfds];
+#else
+    ps->xfds[i] = ps->xfds[ps->nfds];
+#endif
+    return 0;
+}
+
+int xpollset_wait(xpollset_t ps, struct xpollfd *ready, int maxready,
+                  int timeout) {
+    int i, rv, n;
+
+    if (ps == NULL || ready == NULL || maxready <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#if HAVE_EPOLL
+    if (ps->epfd >= 0) {
+        if ((rv = epoll_wait(ps->epfd, ps->events,
+                             maxready < ps->maxfds ? maxready : ps->maxfds,
+                             timeout)) < 0)
+            return -1;
+
+        for (i = 0; i < rv; i++) {
+            unsigned int ev = ps->events[i].events;
+
+            ready[i].fd = ps->events[i].data.fd;
+            ready[i].events = 0;
+            ready[i].revents = 0;
+            if (ev & EPOLLIN)
+                ready[i].revents |= XPOLLREAD;
+            if (ev & EPOLLOUT)
+                ready[i].revents |= XPOLLWRITE;
+            if (ev & (EPOLLERR|EPOLLHUP))
+                ready[i].revents |= XPOLLERR;
+        }
+        return rv;
+    }
+#endif /* HAVE_EPOLL */
+
+#if HAVE_POLL
+    if ((rv = poll(ps->pfds, ps->nfds, timeout)) <= 0)
+        return rv;
+
+    for (i = 0, n = 0; i < ps->nfds && n < maxready; i++) {
+        short ev = ps->pfds[i].revents;
+
+        if (ev == 0)
+            continue;
+        ready[n].fd = ps->pfds[i].fd;
+        ready[n].events = 0;
+        ready[n].revents = 0;
+        if (ev & POLLIN)
+            ready[n].revents |= XPOLLREAD;
+        if (ev & POLLOUT)
+            ready[n].revents |= XPOLLWRITE;
+        if (ev & (POLLERR|POLLHUP))
+            ready[n].revents |= XPOLLERR;
+        if (ev & POLLNVAL)
+            ready[n].revents |= XPOLLINVAL;
+        n++;
+    }
+    return n;
+#else
+    /* select() takes seconds */
+    if (timeout > 0)
+        timeout = (timeout + 999) / 1000;
+    if ((rv = xpoll(ps->xfds, ps->nfds, timeout)) <= 0)
+        return rv;
+
+    for (i = 0, n = 0; i < ps->nfds && n < maxready; i++) {
+        if (ps->xfds[i].revents == 0)
+            continue;
+        ready[n++] = ps->xfds[i];
+    }
+    return n;
+#endif /* HAVE_POLL */
+}
+
 /*
  * vi: tabstop=4 shiftwidth=4 expandtab
  */
@@ -52,6 +52,7 @@ struct xpollfd {
  *    if timeout < 0  - poll infinitely
  *    if timeout == 0 - return immediately
  *    if timeout > 0  - poll this number of seconds
+ *   (note xpollset_wait() takes milliseconds)
  *
  * Output:
  * Number of file descriptors in which revents is modified.  On error,
@@ -65,4 +66,59 @@ struct xpollfd {
  */ 
 int xpoll(struct xpollfd *xfds, int nfds, int timeout);
 
+/*
+ * Persistent poll sets.
+ * - A set of file descriptors registered once and waited on many times,
+ *   so that waiting does no allocation. Backed by epoll where available,
+ *   and by poll() or select() otherwise. A set switches to poll() if
+ *   epoll cannot watch an fd added to it, such as a regular file.
+ */
+typedef struct xpollset *xpollset_t;
+
+/*
+ * xpollset_create()
+ * - Create a poll set able to hold up to maxfds file descriptors.
+ *   Returns NULL on error with errno set.
+ */
+xpollset_t xpollset_create(int maxfds);
+
+/*
+ * xpollset_destroy()
+ * - Free a poll set. File descriptors in the set are not closed.
+ */
+void xpollset_destroy(xpollset_t ps);
+
+/*
+ * xpollset_add(), xpollset_modify()
+ * - Add fd to the poll set, or change the events (XPOLLREAD and/or
+ *   XPOLLWRITE) it is watched for.
+ *   Returns 0 on success, or -1 with errno set.
+ */
+int xpollset_add(xpollset_t ps, int fd, short events);
+int xpollset_modify(xpollset_t ps, int fd, short events);
+
+/*
+ * xpollset_remove()
+ * - Remove fd from the poll set. This must be done before fd is closed.
+ *   Returns 0 on success, or -1 with errno set (ENOENT if fd is not in
+ *   the set; EBADF if it has already been closed).
+ */
+int xpollset_remove(xpollset_t ps, int fd);
+
+/*
+ * xpollset_wait()
+ * - Wait for events on the fds in the poll set.
+ *
+ * Input:
+ * ready - array of maxready structures to fill in
+ * timeout - timeout in milliseconds (unlike xpoll(), which takes
+ *    seconds), or < 0 to wait indefinitely
+ *
+ * Output:
+ * Number of entries of ready filled in with the fd and its revents,
+ * 0 on timeout, or -1 with errno set (EINTR if interrupted by a signal).
+ */
+int xpollset_wait(xpollset_t ps, struct xpollfd *ready, int maxready,
+                  int timeout);
+
 #endif /* _XPOLL_H */
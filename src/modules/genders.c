@@ -154,7 +154,6 @@ static hostlist_t _genders_to_altnames(genders_t g, hostlist_t hl);
 static hostlist_t _read_genders(List l);
 static hostlist_t _read_genders_attr(char *query);
 static void       _genders_opt_verify(opt_t *opt);
-static int        _delete_all (hostlist_t hl, hostlist_t dl);
 static int        register_genders_rcmd_types (opt_t *opt);
 
 
@@ -238,22 +237,6 @@ genders_wcoll(opt_t *opt)
     return _read_genders(attrlist);
 }
 
-static hostlist_t hostlist_intersect (hostlist_t h1, hostlist_t h2)
-{
-    char *host;
-    hostlist_t r = hostlist_create (NULL);
-    hostlist_iterator_t i = hostlist_iterator_create (h1);
-
-    while ((host = hostlist_next (i))) {
-        if (hostlist_find (h2, host) >= 0) {
-            hostlist_push_host (r, host);
-	}
-        free (host);
-    }
-    hostlist_iterator_destroy (i);
-    return (r);
-}
-
 static hostlist_t genders_query_with_altnames (char *query)
 {
     hostlist_t r = _read_genders_attr (query);
@@ -293,6 +276,7 @@ static hostlist_t genders_filter (hostlist_t hl, List query_list)
         hostlist_destroy (ghl);
 
         hostlist_push_list (result, r);
+        hostlist_destroy (r);
     }
     list_iterator_destroy (i);
     hostlist_uniq (result);
@@ -316,8 +300,8 @@ genders_postop(opt_t *opt)
 
     if (excllist && (hl = _read_genders (excllist))) {
         hostlist_t altlist = _genders_to_altnames (gh, hl);
-        _delete_all (opt->wcoll, hl);
-        _delete_all (opt->wcoll, altlist);
+        hostlist_subtract (opt->wcoll, hl);
+        hostlist_subtract (opt->wcoll, altlist);
 
         hostlist_destroy (altlist);
         hostlist_destroy (hl);
@@ -671,21 +655,6 @@ register_genders_rcmd_types (opt_t *opt)
     return 0;
 }
 
-static int 
-_delete_all (hostlist_t hl, hostlist_t dl)
-{
-    int                 rc   = 0;
-    char *              host = NULL;
-    hostlist_iterator_t i    = hostlist_iterator_create (dl);
-
-    while ((host = hostlist_next (i))) {
-        rc += hostlist_delete_host (hl, host);
-        free (host);
-    }
-    hostlist_iterator_destroy (i);
-    return (rc);
-}
-
 /*
  * vi: tabstop=4 shiftwidth=4 expandtab
  */
@@ -142,6 +142,12 @@ static int kexec_init(opt_t * opt)
     if (rcmd_opt_set (RCMD_OPT_RESOLVE_HOSTS, 0) < 0)
         errx ("%p: kexeccmd_init: rcmd_opt_set: %m\n");
 
+    /*
+     *  Remote exit status is the exit status of the local command process
+     */
+    if (rcmd_opt_set (RCMD_OPT_EXIT_STATUS, (void *) 1) < 0)
+        errx ("%p: kexeccmd_init: rcmd_opt_set: %m\n");
+
     return 0;
 }
 
@@ -216,6 +222,12 @@ kexec_destroy (pipecmd_t p)
 
     pipecmd_destroy (p);
 
+    /*
+     *  Death by signal is reported as the negated signal number
+     */
+    if (WIFSIGNALED (status))
+        return (-WTERMSIG (status));
+
     return (WEXITSTATUS (status));
 }
 
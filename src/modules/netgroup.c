@@ -176,21 +176,6 @@ static hostlist_t read_netgroup (opt_t *opt)
     return _read_groups (groups);
 }
 
-static int
-_delete_all (hostlist_t hl, hostlist_t dl)
-{
-    int                 rc   = 0;
-    char *              host = NULL;
-    hostlist_iterator_t i    = hostlist_iterator_create (dl);
-
-    while ((host = hostlist_next (i))) {
-        rc += hostlist_delete_host (hl, host);
-        free (host);
-    }
-    hostlist_iterator_destroy (i);
-    return (rc);
-}
-
 static int netgroup_postop (opt_t *opt)
 {
     hostlist_t hl = NULL;
@@ -201,7 +186,8 @@ static int netgroup_postop (opt_t *opt)
     if ((hl = _read_groups (exgroups)) == NULL)
         return (0);
 
-    _delete_all (opt->wcoll, hl);
+    hostlist_subtract (opt->wcoll, hl);
+    hostlist_destroy (hl);
 
     return 0;
 }
@@ -396,6 +396,7 @@ static hostlist_t _slurm_wcoll_constraint (hostlist_t wl, List constraintlist)
 {
     int i;
     hostlist_t hl;
+    hostset_t ws;
     node_info_msg_t * msg;
     node_info_t * n;
     char *f;
@@ -406,12 +407,18 @@ static hostlist_t _slurm_wcoll_constraint (hostlist_t wl, List constraintlist)
         errx ("Unable to contact slurm controller: %s\n",
               slurm_strerror (errno));
 
+    /*
+     *  Index wcoll once so that each node record is checked in O(1)
+     */
+    if (!(ws = hostset_create_hostlist(wl)))
+        errx ("%p: Out of memory\n");
+
     li = list_iterator_create(constraintlist);
     hl = hostlist_create("");
     for (i = 0; i < msg->record_count; i++){
         n = &msg->node_array[i];
 
-        if (hostlist_find(wl, n->name) < 0)
+        if (!hostset_find_host(ws, n->name))
             continue;
 
         f = n->features_act ? n->features_act : n->features;
@@ -426,6 +433,7 @@ static hostlist_t _slurm_wcoll_constraint (hostlist_t wl, List constraintlist)
             }
         }
     }
+    hostset_destroy(ws);
 
     return (hl);
 }
@@ -216,6 +216,12 @@ static int sshcmd_init(opt_t * opt)
     if (rcmd_opt_set (RCMD_OPT_RESOLVE_HOSTS, 0) < 0)
         errx ("%p: sshcmd_init: rcmd_opt_set: %m\n");
 
+    /*
+     *  Remote exit status is the exit status of the local ssh process
+     */
+    if (rcmd_opt_set (RCMD_OPT_EXIT_STATUS, (void *) 1) < 0)
+        errx ("%p: sshcmd_init: rcmd_opt_set: %m\n");
+
     return 0;
 }
 
@@ -321,6 +327,12 @@ sshcmd_destroy (pipecmd_t p)
 
     pipecmd_destroy (p);
 
+    /*
+     *  Death by signal is reported as the negated signal number
+     */
+    if (WIFSIGNALED (status))
+        return (-WTERMSIG (status));
+
     return WEXITSTATUS (status);
 }
 
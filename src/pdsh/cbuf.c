@@ -98,6 +98,7 @@ struct cbuf {
 
 #ifdef WITH_PTHREADS
     pthread_mutex_t     mutex;          /* mutex to protect access to cbuf   */
+    int                 unlocked;       /* true if mutex is not used         */
 #endif /* WITH_PTHREADS */
 
     int                 alloc;          /* num bytes malloc'd/realloc'd      */
@@ -110,6 +111,7 @@ struct cbuf {
     int                 i_in;           /* index to where data is written in */
     int                 i_out;          /* index to where data is read out   */
     int                 i_rep;          /* index to where data is replayable */
+    int                 n_nonl;         /* num unread bytes w/o a newline    */
     unsigned char      *data;           /* ptr to circular buffer of data    */
 };
 
@@ -169,7 +171,7 @@ static int cbuf_is_valid (cbuf_t cb);
 
 #  define cbuf_mutex_lock(cb)                                                 \
      do {                                                                     \
-         int e = pthread_mutex_lock(&cb->mutex);                              \
+         int e = cb->unlocked ? 0 : pthread_mutex_lock(&cb->mutex);           \
          if (e) {                                                             \
              errno = e;                                                       \
              lsd_fatal_error(__FILE__, __LINE__, "cbuf mutex lock");          \
@@ -179,7 +181,7 @@ static int cbuf_is_valid (cbuf_t cb);
 
 #  define cbuf_mutex_unlock(cb)                                               \
      do {                                                                     \
-         int e = pthread_mutex_unlock(&cb->mutex);                            \
+         int e = cb->unlocked ? 0 : pthread_mutex_unlock(&cb->mutex);         \
          if (e) {                                                             \
              errno = e;                                                       \
              lsd_fatal_error(__FILE__, __LINE__, "cbuf mutex unlock");        \
@@ -246,6 +248,9 @@ cbuf_create (int minsize, int maxsize)
         return(lsd_nomem_error(__FILE__, __LINE__, "cbuf data"));
     }
     cbuf_mutex_init(cb);
+#ifdef WITH_PTHREADS
+    cb->unlocked = 0;
+#endif /* WITH_PTHREADS */
     cb->minsize = minsize;
     cb->maxsize = (maxsize > minsize) ? maxsize : minsize;
     cb->size = minsize;
@@ -253,6 +258,7 @@ cbuf_create (int minsize, int maxsize)
     cb->overwrite = CBUF_WRAP_MANY;
     cb->got_wrap = 0;
     cb->i_in = cb->i_out = cb->i_rep = 0;
+    cb->n_nonl = 0;
 
 #ifndef NDEBUG
     /*  C is for cookie, that's good enough for me, yeah!
@@ -278,6 +284,20 @@ cbuf_create (int minsize, int maxsize)
 }
 
 
+cbuf_t
+cbuf_create_unlocked (int minsize, int maxsize)
+{
+    cbuf_t cb = cbuf_create(minsize, maxsize);
+
+#ifdef WITH_PTHREADS
+    if (cb != NULL) {
+        cb->unlocked = 1;
+    }
+#endif /* WITH_PTHREADS */
+    return(cb);
+}
+
+
 void
 cbuf_destroy (cbuf_t cb)
 {
@@ -315,6 +335,7 @@ cbuf_flush (cbuf_t cb)
     cb->used = 0;
     cb->got_wrap = 0;
     cb->i_in = cb->i_out = cb->i_rep = 0;
+    cb->n_nonl = 0;
     assert(cbuf_is_valid(cb));
     cbuf_mutex_unlock(cb);
     return;
@@ -603,6 +624,7 @@ cbuf_rewind (cbuf_t src, int len)
     if (len > 0) {
         src->used += len;
         src->i_out = (src->i_out - len + (src->size + 1)) % (src->size + 1);
+        src->n_nonl = 0;
     }
     assert(cbuf_is_valid(src));
     cbuf_mutex_unlock(src);
@@ -700,6 +722,41 @@ cbuf_peek_line (cbuf_t src, char *dstbuf, int len, int lines)
 }
 
 
+int
+cbuf_peek_line_iov (cbuf_t src, struct iovec *iov, int *iovcnt, int lines)
+{
+    int n, m;
+
+    assert(src != NULL);
+
+    if ((iov == NULL) || (iovcnt == NULL) || (lines < -1)) {
+        errno = EINVAL;
+        return(-1);
+    }
+    *iovcnt = 0;
+    if (lines == 0) {
+        return(0);
+    }
+    cbuf_mutex_lock(src);
+    assert(cbuf_is_valid(src));
+    n = cbuf_find_unread_line(src, src->used, &lines);
+    if (n > 0) {
+        m = MIN(n, (src->size + 1) - src->i_out);
+        iov[0].iov_base = src->data + src->i_out;
+        iov[0].iov_len = m;
+        *iovcnt = 1;
+        if (m < n) {
+            iov[1].iov_base = src->data;
+            iov[1].iov_len = n - m;
+            *iovcnt = 2;
+        }
+    }
+    assert(cbuf_is_valid(src));
+    cbuf_mutex_unlock(src);
+    return(n);
+}
+
+
 int
 cbuf_read_line (cbuf_t src, char *dstbuf, int len, int lines)
 {
@@ -805,6 +862,7 @@ cbuf_rewind_line (cbuf_t src, int len, int lines)
     if (n > 0) {
         src->used += n;
         src->i_out = (src->i_out - n + (src->size + 1)) % (src->size + 1);
+        src->n_nonl = 0;
     }
     assert(cbuf_is_valid(src));
     cbuf_mutex_unlock(src);
@@ -1008,6 +1066,67 @@ cbuf_write_from_fd (cbuf_t dst, int srcfd, int len, int *ndropped)
 }
 
 
+int
+cbuf_readv_from_fd (cbuf_t dst, int srcfd, int len)
+{
+    struct iovec iov[2];
+    int iovcnt;
+    int nfree, nrepl;
+    int n, m;
+
+    assert(dst != NULL);
+
+    if ((srcfd < 0) || (len < -1)) {
+        errno = EINVAL;
+        return(-1);
+    }
+    cbuf_mutex_lock(dst);
+    assert(cbuf_is_valid(dst));
+    nfree = dst->size - dst->used;
+    if (len == -1) {
+        len = (nfree > 0) ? nfree : MIN(dst->size, CBUF_CHUNK);
+    }
+    if ((len > nfree) && (dst->size < dst->maxsize)) {
+        nfree += cbuf_grow(dst, len - nfree);
+    }
+    len = MIN(len, nfree);
+    if (len <= 0) {
+        errno = (len == 0) ? ENOSPC : EINVAL;
+        n = -1;
+    }
+    else {
+        /*  Free space starts at i_in and wraps around at most once.
+         */
+        m = MIN(len, (dst->size + 1) - dst->i_in);
+        iov[0].iov_base = dst->data + dst->i_in;
+        iov[0].iov_len = m;
+        iovcnt = 1;
+        if (m < len) {
+            iov[1].iov_base = dst->data;
+            iov[1].iov_len = len - m;
+            iovcnt = 2;
+        }
+        do {
+            n = readv(srcfd, iov, iovcnt);
+        } while ((n < 0) && (errno == EINTR));
+
+        if (n > 0) {
+            nrepl = (dst->i_out - dst->i_rep + (dst->size + 1))
+                    % (dst->size + 1);
+            dst->used += n;
+            dst->i_in = (dst->i_in + n) % (dst->size + 1);
+            if (n > nfree - nrepl) {
+                dst->got_wrap = 1;
+                dst->i_rep = (dst->i_in + 1) % (dst->size + 1);
+            }
+        }
+    }
+    assert(cbuf_is_valid(dst));
+    cbuf_mutex_unlock(dst);
+    return(n);
+}
+
+
 int
 cbuf_copy (cbuf_t src, cbuf_t dst, int len, int *ndropped)
 {
@@ -1217,6 +1336,8 @@ cbuf_find_unread_line (cbuf_t cb, int chars, int *nlines)
  */
     int i, n, m, l;
     int lines;
+    int avail, seg, k;
+    unsigned char *p;
 
     assert(cb != NULL);
     assert(nlines != NULL);
@@ -1233,26 +1354,45 @@ cbuf_find_unread_line (cbuf_t cb, int chars, int *nlines)
     if (cb->used == 0) {
         return(0);                      /* no unread data available */
     }
+    /*  Skip the unread data already known not to contain a newline,
+     *    so repeatedly looking for a line that is still incomplete only
+     *    examines newly written data.
+     */
+    n = cb->n_nonl;
+    avail = cb->used - n;
     if (lines > 0) {
         chars = -1;                     /* chars parm not used if lines > 0 */
     }
-    i = cb->i_out;
-    while (i != cb->i_in) {
-        ++n;
-        if (chars > 0) {
-            --chars;
+    else if (chars <= n) {
+        return(0);
+    }
+    else {
+        avail = MIN(avail, chars - n);
+    }
+    /*  Unread data is contiguous in at most two segments of the ring,
+     *    so search each with memchr() rather than byte-by-byte.
+     */
+    i = (cb->i_out + n) % (cb->size + 1);
+    while (avail > 0) {
+        seg = MIN(avail, (cb->size + 1) - i);
+        p = memchr(cb->data + i, '\n', seg);
+        k = (p != NULL) ? (p - (cb->data + i)) + 1 : seg;
+        n += k;
+        avail -= k;
+        i = (i + k) % (cb->size + 1);
+        if (p == NULL) {
+            continue;
         }
-        if (cb->data[i] == '\n') {
-            if (lines > 0) {
-                --lines;
-            }
-            m = n;
-            ++l;
+        if (l++ == 0) {
+            cb->n_nonl = n - 1;
         }
-        if ((chars == 0) || (lines == 0)) {
+        m = n;
+        if ((lines > 0) && (--lines == 0)) {
             break;
         }
-        i = (i + 1) % (cb->size + 1);
+    }
+    if (l == 0) {
+        cb->n_nonl = n;
     }
     if (lines > 0) {
         return(0);                      /* all or none, and not enough found */
@@ -1418,6 +1558,7 @@ cbuf_copier (cbuf_t src, cbuf_t dst, int len, int *ndropped)
         }
         if (ncopy > nfree) {
             dst->i_out = dst->i_rep;
+            dst->n_nonl = 0;
         }
     }
     return(len);
@@ -1437,6 +1578,7 @@ cbuf_dropper (cbuf_t cb, int len)
 
     cb->used -= len;
     cb->i_out = (cb->i_out + len) % (cb->size + 1);
+    cb->n_nonl = MAX(0, cb->n_nonl - len);
 
     /*  Attempt to shrink cbuf if possible.
      */
@@ -1641,6 +1783,7 @@ cbuf_writer (cbuf_t dst, int len, cbuf_iof getf, void *src, int *ndropped)
         }
         if (n > nfree) {
             dst->i_out = dst->i_rep;
+            dst->n_nonl = 0;
         }
     }
     if (ndropped) {
@@ -1757,6 +1900,9 @@ cbuf_mutex_is_locked (cbuf_t cb)
     int rc;
 
     assert(cb != NULL);
+    if (cb->unlocked) {
+        return(1);
+    }
     rc = pthread_mutex_trylock(&cb->mutex);
     return(rc == EBUSY ? 1 : 0);
 }
@@ -1802,6 +1948,8 @@ cbuf_is_valid (cbuf_t cb)
     assert(cb->i_in <= cb->size);
     assert(cb->i_out >= 0);
     assert(cb->i_out <= cb->size);
+    assert(cb->n_nonl >= 0);
+    assert(cb->n_nonl <= cb->used);
     assert(cb->i_rep >= 0);
     assert(cb->i_rep <= cb->size);
 
@@ -26,6 +26,8 @@
 #ifndef LSD_CBUF_H
 #define LSD_CBUF_H
 
+#include <sys/uio.h>                    /* struct iovec                      */
+
 
 /***********
  *  Notes  *
@@ -92,6 +94,14 @@ cbuf_t cbuf_create (int minsize, int maxsize);
  *  Abandoning a cbuf without calling cbuf_destroy() will cause a memory leak.
  */
 
+cbuf_t cbuf_create_unlocked (int minsize, int maxsize);
+/*
+ *  Creates and returns a new circular buffer like cbuf_create(), except
+ *    that access to it is not serialized with a mutex.
+ *  Use it only for a cbuf accessed by a single thread, such as one owned
+ *    by that thread, to avoid locking overhead on every call.
+ */
+
 void cbuf_destroy (cbuf_t cb);
 /*
  *  Destroys the circular buffer [cb].
@@ -218,6 +228,21 @@ int cbuf_peek_line (cbuf_t src, char *dstbuf, int len, int lines);
  *    Returns -1 on error (with errno set).
  */
 
+int cbuf_peek_line_iov (cbuf_t src, struct iovec *iov, int *iovcnt,
+                        int lines);
+/*
+ *  Sets [iov] to describe the specified [lines] of data in the [src] cbuf
+ *    without copying it.  If [lines] is -1, describes all complete lines
+ *    available.  The data is contiguous in at most two pieces, so [iov]
+ *    must have room for two entries; [iovcnt] is set to the number used.
+ *  The iovecs point into cbuf memory and are only valid until [src] is next
+ *    modified, so this should only be used on a cbuf with a single owner.
+ *    Once the data has been used, consume it with cbuf_drop().
+ *  Returns the number of bytes described on success.
+ *    Returns 0 if the number of lines is not available (ie, all or none).
+ *    Returns -1 on error (with errno set).
+ */
+
 int cbuf_read_line (cbuf_t src, char *dstbuf, int len, int lines);
 /*
  *  Reads the specified [lines] of data from the [src] cbuf into [dstbuf].
@@ -297,6 +322,18 @@ int cbuf_write_from_fd (cbuf_t dst, int srcfd, int len, int *ndropped);
  *    Sets [ndropped] (if not NULL) to the number of bytes overwritten.
  */
 
+int cbuf_readv_from_fd (cbuf_t dst, int srcfd, int len);
+/*
+ *  Writes up to [len] bytes of data from the file referenced by the
+ *    [srcfd] file descriptor into the free space of the [dst] cbuf with a
+ *    single readv() call, so data wrapping around the end of the buffer
+ *    needs only one system call.  Unread data is never overwritten.
+ *    If [len] is -1, it will be set to the free space available, or to
+ *    an appropriate chunk size if the buffer has to grow.
+ *  Returns the number of bytes written, 0 on EOF, or -1 on error (with errno).
+ *    If no space is available, returns -1 with errno set to ENOSPC.
+ */
+
 int cbuf_copy (cbuf_t src, cbuf_t dst, int len, int *ndropped);
 /*
  *  Copies up to [len] bytes of data from the [src] cbuf into the [dst] cbuf
@@ -70,9 +70,11 @@
 #if	HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#include <sched.h>              /* sched_yield */
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <stddef.h>             /* offsetof */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -81,6 +83,7 @@
 #endif
 #include <errno.h>
 #include <assert.h>
+#include <ctype.h>
 #include <netdb.h>              /* gethostbyname */
 #include <sys/resource.h>       /* get/setrlimit */
 
@@ -109,6 +112,8 @@
 #include "src/common/xstring.h"
 #include "src/common/err.h"
 #include "src/common/xpoll.h"
+#include "src/common/xatomic.h"
+#include "src/common/hist.h"
 #include "src/common/fd.h"
 #include "dsh.h"
 #include "opt.h"
@@ -116,27 +121,75 @@
 #include "pcp_server.h"
 #include "wcoll.h"
 #include "rcmd.h"
+#include "outdir.h"
+#include "jsonout.h"
+#include "outorder.h"
+#include "progress.h"
+#include "trace.h"
 
 static int debug = 0;
 
 /*
  * Mutex and condition variable for implementing `fanout'.  When a thread
- * terminates, it decrements threadcount and signals threadcount_cond.
- * The main, once it has spawned the fanout number of threads, suspends itself
- * until a thread termintates.
+ * terminates, it decrements threadcount, returns its slot to free_slots
+ * and signals threadcount_cond.  The main, once it has spawned the fanout
+ * number of threads, suspends itself until a thread termintates.
  */
 static pthread_mutex_t threadcount_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t threadcount_cond = PTHREAD_COND_INITIALIZER;
 static int threadcount = 0;
 
 /*
- * This array is initialized in dsh().  It contains an entry for every
- * potentially active thread, though only the fanout number will be active
- * at once.  It is out here in global land so the signal handler for ^C can
- * report which hosts are blocked.
+ * This array is initialized in dsh().  It contains one slot for each
+ * thread that may be active at once (the fanout), and hosts are assigned
+ * to slots as they are started, so per-host state exists only from the
+ * time a host is started until its slot is reused.  A free slot has
+ * host == NULL.  It is out here in global land so the signal handler
+ * for ^C can report which hosts are blocked.
+ *
+ * Thread state is changed with atomic operations only (see
+ * _change_state()).  Slots are assigned and freed by dsh() with
+ * threadcount_mutex held, so that lock also keeps a slot's host fixed
+ * while it is read from another thread.
  */
 static thd_t *t;
-static pthread_mutex_t thd_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int nslots = 0;
+
+/*
+ * Number of _fwd_signal() calls using the rcmd connection of each slot.
+ * A thread does not destroy its connection while this is nonzero.
+ */
+static int *nsignal;
+
+/*
+ * Stack of free slots in t[], the number of hosts in wcoll and the index
+ * of the next host to start.  When cancel_pending is set by ^Z, hosts
+ * not yet started are canceled.  Protected by threadcount_mutex.
+ */
+static int *free_slots;
+static int nfree = 0;
+static int nhosts = 0;
+static int next_host = 0;
+static int cancel_pending = 0;
+
+/*
+ * Totals over hosts whose slots have been retired, for -S and -d.
+ */
+static struct {
+    int failed;
+    int canceled;
+    int rc;                     /* largest remote return code */
+    double polls;
+    double reads;
+    double bytes;
+} summary;
+
+/*
+ * Per-host timings file (PDSH_TIMING_FILE), written as hosts are retired,
+ * and the time the first thread was created.
+ */
+static FILE *timing_fp = NULL;
+static unsigned long long timing_t0 = 0;
 
 /*
  * Timeout values, initialized in dsh(), used in _wdog().
@@ -148,14 +201,68 @@ static int connect_timeout, command_timeout;
  */
 static int sigint_terminates = 0;
 
+/*
+ * Write per-host output to files in a directory (-o)
+ */
+static int use_outdir = 0;
+
+/*
+ * Time dsh() was entered, for the resource usage report under -d
+ */
+static unsigned long long dsh_start = 0;
+
+/*
+ * Write output as JSON records (-O json)
+ */
+static int output_json = 0;
+static int output_ordered = 0;
+
+/*
+ * Output buffering limits. Each host stream buffers at most
+ *  host_buffer_size bytes of incomplete lines. Bytes held in all host
+ *  buffers are counted in buffered_bytes, and while that total is over
+ *  output_memory_limit (if nonzero), hosts not holding any buffered
+ *  data stop reading from their connections.
+ */
+static int host_buffer_size = DFLT_HOST_BUFFER_SIZE;
+static long output_memory_limit = 0;
+static long buffered_bytes = 0;
+static pthread_mutex_t buffered_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t buffered_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ *  Remote output streams:
+ */
+#define DSH_STDOUT  0
+#define DSH_STDERR  1
+
+/*
+ *  Maximum number of iovecs passed to one writev(2) of output lines.
+ */
+#define DSH_IOV_MAX 64
+
+/*
+ *  Maximum bytes read from one rcmd fd per poll wakeup.
+ */
+#define DSH_READ_QUANTUM (256*1024)
+
+/*
+ *  Initial size of host output buffers, and so the usual read size.
+ */
+#define DSH_BUFFER_MINSIZE (16*1024)
+
 /*
  *  Buffered output prototypes:
  */
 typedef void (* out_f) (const char *, ...);
-static int _do_output (int fd, cbuf_t cb, out_f outf, bool read_rc, thd_t *t);
-static int _handle_rcmd_stderr (thd_t *t);
-static int _handle_rcmd_stdout (thd_t *t);
-static void _flush_output (cbuf_t cb, out_f outf, thd_t *t);
+static int _do_output (int fd, int stream, thd_t *t);
+static int _handle_rcmd_stderr (thd_t *t, xpollset_t ps);
+static int _handle_rcmd_stdout (thd_t *t, xpollset_t ps);
+static void _flush_output (thd_t *t, int stream);
+static void _thd_buffers_create (thd_t *th);
+static void _thd_buffers_destroy (thd_t *th);
+static void _trace_host (thd_t *th);
+static void _thd_release (thd_t *th);
 
 /*
  * Emulate signal() but with BSD semantics (i.e. don't restore signal to
@@ -194,11 +301,13 @@ static void _list_slowthreads(void)
     int i;
     time_t ttl;
 
-    dsh_mutex_lock(&thd_mutex);
+    dsh_mutex_lock(&threadcount_mutex);
 
-    for (i = 0; t[i].host != NULL; i++) {
+    for (i = 0; i < nslots; i++) {
+        if (t[i].host == NULL)
+            continue;
 
-        switch (t[i].state) {
+        switch (xatomic_load_int (&t[i].state)) {
         case DSH_READING:
             err("%p: %S: command in progress", t[i].host);
             ttl = t[i].connect + command_timeout - time(NULL);
@@ -234,7 +343,10 @@ static void _list_slowthreads(void)
         }
     }
 
-    dsh_mutex_unlock(&thd_mutex);
+    if (debug)
+        err("%p: %d hosts not yet started\n", nhosts - next_host);
+
+    dsh_mutex_unlock(&threadcount_mutex);
 }
 
 /*
@@ -255,19 +367,29 @@ static void _mask_signals(int how)
 
 /*
  * If the underlying rsh mechanism supports it, forward signals to remote 
- * process.
+ * process.  This takes no lock, since it may be called with
+ * threadcount_mutex held.
  */
 static void _fwd_signal(int signum)
 {
     int i;
 
-    dsh_mutex_lock(&thd_mutex);
-    for (i = 0; t[i].host != NULL; i++) {
-        if (t[i].state == DSH_READING)
+    for (i = 0; i < nslots; i++) {
+        xatomic_add_int(&nsignal[i], 1);
+        if (xatomic_load_int(&t[i].state) == DSH_READING)
             rcmd_signal(t[i].rcmd, signum);
+        xatomic_add_int(&nsignal[i], -1);
     }
-    dsh_mutex_unlock(&thd_mutex);
+}
 
+/*
+ * Wait for any _fwd_signal() using the connection of thread `th'.
+ * Called once `th' has left DSH_READING.
+ */
+static void _wait_for_signalers(thd_t *th)
+{
+    while (xatomic_add_int(&nsignal[th - t], 0) > 0)
+        sched_yield();
 }
 
 static int _thd_connect_timeout (thd_t *th)
@@ -303,8 +425,8 @@ static void *_wdog(void *args)
         if (t == NULL) /* We're done */
             return NULL;
 
-        for (i = 0; t[i].host != NULL; i++) {
-            switch (t[i].state) {
+        for (i = 0; i < nslots; i++) {
+            switch (xatomic_load_int (&t[i].state)) {
             case DSH_RCMD:
                 if (_thd_connect_timeout (&t[i]))
                         pthread_kill(t[i].thread, SIGALRM);
@@ -320,6 +442,9 @@ static void *_wdog(void *args)
                 break;
             }
         }
+        if (use_outdir)
+            outdir_flush_expired ();
+
         sleep (WDOG_POLL);
     }
     return NULL;
@@ -342,26 +467,70 @@ static void _gethost(char *name, char *addr)
 }
 
 /*
- *  Update thread state to connecting, unless the thread
+ *  Move thread `th' from state `old' to `state' with a single
+ *   compare-and-swap, so that a transition made by the thread and a
+ *   cancel from the signals thread cannot both succeed, and the
+ *   progress counters see every transition exactly once. Returns
+ *   nonzero if `th' was in state `old'.
+ */
+static int _change_state (thd_t *th, state_t old, state_t state)
+{
+    if (!xatomic_cas_int (&th->state, old, state))
+        return (0);
+    progress_state (old, state);
+    return (1);
+}
+
+/*
+ *  Cancel thread `th' if it has not yet connected. Returns nonzero
+ *   if it was canceled.
+ */
+static int _cancel_state (thd_t *th)
+{
+    int old;
+
+    while ((old = xatomic_load_int (&th->state)) == DSH_NEW
+           || old == DSH_RCMD) {
+        if (_change_state (th, old, DSH_CANCELED))
+            return (1);
+    }
+    return (0);
+}
+
+/*
+ *  Move thread `th' to its final state `result', unless it has been
+ *   canceled, and return the state it was in before.
+ */
+static state_t _finish_state (thd_t *th, state_t result)
+{
+    int old;
+
+    while ((old = xatomic_load_int (&th->state)) != DSH_CANCELED) {
+        if (_change_state (th, old, result))
+            break;
+    }
+    return (old);
+}
+
+/*
+ *  Update thread state to connected, unless the thread
  *   has been canceled, in which case close fds if they are open
  *   and return DSH_CANCELED.
  */
 static state_t _update_connect_state (thd_t *a)
 {
-    dsh_mutex_lock(&thd_mutex);
     a->connect = time(NULL);
-    if (a->state != DSH_CANCELED)
-        a->state = DSH_READING;
-    dsh_mutex_unlock(&thd_mutex);
-
-    if (a->state == DSH_CANCELED) {
-        if (a->rcmd->fd >= 0)
-            close (a->rcmd->fd);
-        if (a->rcmd->efd >= 0)
-            close (a->rcmd->efd);
+    if (_change_state (a, DSH_RCMD, DSH_READING)) {
+        progress_connect_time (a->ts[TIMING_CONNECTED] - a->ts[TIMING_START]);
+        return (DSH_READING);
     }
 
-    return (a->state);
+    if (a->rcmd->fd >= 0)
+        close (a->rcmd->fd);
+    if (a->rcmd->efd >= 0)
+        close (a->rcmd->efd);
+
+    return (DSH_CANCELED);
 }
 
 static int _pcp_server (thd_t *th)
@@ -430,9 +599,9 @@ static int _parallel_copy (thd_t *th)
          *  connection when the copy (or error output) is
          *  complete.
          */
-        while (_handle_rcmd_stderr (th) > 0)
+        while (_handle_rcmd_stderr (th, NULL) > 0)
             ;
-        _flush_output (th->errbuf, (out_f) err, th);
+        _flush_output (th, DSH_STDERR);
 
     }
 
@@ -454,14 +623,16 @@ static void *_rcp_thread(void *args)
     int rc;
     char *rcpycmd = NULL;
 
+    timing_mark (a->ts, TIMING_START);
+    trace_thread (a->nodeid + 1, a->host);
 #if	HAVE_MTSAFE_GETHOSTBYNAME
     if (a->rcmd->opts->resolve_hosts)
         _gethost(a->host, a->addr);
 #endif
+    timing_mark (a->ts, TIMING_RESOLVED);
     a->start = time(NULL);
-    dsh_mutex_lock(&thd_mutex);
-    a->state = DSH_RCMD;
-    dsh_mutex_unlock(&thd_mutex);
+
+    _thd_buffers_create (a);
 
     /* For reverse copy, the host needs to be appended to the end of the command */
     if (a->pcp_Popt) {
@@ -470,59 +641,244 @@ static void *_rcp_thread(void *args)
         xstrcat(&rcpycmd, a->host);
     }
 
-    rcmd_connect (a->rcmd, a->host, a->addr, a->luser, a->ruser, 
-                  (rcpycmd) ? rcpycmd : a->cmd, a->nodeid, a->dsh_sopt);
+    /* connect, unless canceled before we got here */
+    if (_change_state (a, DSH_NEW, DSH_RCMD))
+        rcmd_connect (a->rcmd, a->host, a->addr, a->luser, a->ruser, 
+                      (rcpycmd) ? rcpycmd : a->cmd, a->nodeid, a->dsh_sopt);
 
     if (rcpycmd)
         Free((void **) &rcpycmd);
 
     if (a->rcmd->fd == -1)
         result = DSH_FAILED;
-    else if (_update_connect_state(a) != DSH_CANCELED) 
-        _parallel_copy(a);
+    else {
+        timing_mark (a->ts, TIMING_CONNECTED);
+        if (_update_connect_state(a) != DSH_CANCELED) {
+            _parallel_copy(a);
+            timing_mark (a->ts, TIMING_LAST_BYTE);
+        }
+    }
 
     /* update status */
-    dsh_mutex_lock(&thd_mutex);
-    a->state = result;
+    if (_finish_state (a, result) == DSH_READING)
+        progress_command_time (a->ts[TIMING_LAST_BYTE]
+                               - a->ts[TIMING_CONNECTED]);
     a->finish = time(NULL);
-    dsh_mutex_unlock(&thd_mutex);
 
-    rc = rcmd_destroy (a->rcmd);
+    _thd_buffers_destroy (a);
+
+    _wait_for_signalers (a);
+    rc = rcmd_destroy (a->rcmd, NULL);
+    timing_mark (a->ts, TIMING_REAPED);
     if ((a->rc == 0) && (rc > 0))
         a->rc = rc;
 
+    _trace_host (a);
+
     /* Signal dsh() so another thread can replace us */
-    dsh_mutex_lock(&threadcount_mutex);
-    threadcount--;
-    pthread_cond_signal(&threadcount_cond);
-    dsh_mutex_unlock(&threadcount_mutex);
+    _thd_release (a);
 
     return NULL;
 }
 
-/* 
- * Extract a remote command return code embedded in output, returning
- * the code as an integer and truncating the line.
+static cbuf_t _stream_cbuf (thd_t *th, int stream)
+{
+    return (stream == DSH_STDOUT ? th->outbuf : th->errbuf);
+}
+
+/*
+ *  Write NUL terminated [buf] of length [len] read from [stream] of
+ *   host [th] to the local stdout/stderr, or to the host's output file
+ *   if using -o. The host label is added only at the start of a line,
+ *   so a line written in several pieces is labeled once.
+ */
+static void _write_output (thd_t *th, int stream, const char *buf, int len)
+{
+    outdir_file_t f = (stream == DSH_STDOUT) ? th->outfile : th->errfile;
+    out_f outf = (stream == DSH_STDOUT) ? (out_f) out : (out_f) err;
+    bool label = !th->partial[stream];
+
+    th->partial[stream] = (len > 0 && buf[len - 1] != '\n');
+
+    if (output_json) {
+        jsonout_line (th->host, stream == DSH_STDOUT ? "stdout" : "stderr",
+                      buf, len);
+        return;
+    }
+
+    if (f != NULL) {
+        if (outdir_file_write (f, buf, len) < 0)
+            err ("%p: %S: write to output file: %m\n", th->host);
+        return;
+    }
+
+    if (output_ordered) {
+        char hostlabel[LINEBUFSIZE];
+        if (label && th->labels) {
+            err_host_label (hostlabel, sizeof (hostlabel) - 2, th->host);
+            strcat (hostlabel, ": ");
+        }
+        outorder_write (th->nodeid, stream, (label && th->labels) ? hostlabel : NULL,
+                        buf, len);
+        return;
+    }
+
+    /*
+     *  We are careful to use a single call to write the line
+     *   to the output stream to avoid interleaved lines of
+     *   output.
+     */
+    if (label && th->labels)
+        outf ("%S: %s", th->host, buf);
+    else
+        outf ("%s", buf);
+}
+
+/*
+ *  If the [len] byte line [buf] ends with a return code trailer
+ *   (RC_MAGIC followed by the code and a newline, as appended to the
+ *   command in dsh()), return the offset of the trailer in [buf].
+ *   Otherwise return -1. Only the end of the line is examined.
+ */
+static int _rc_trailer_offset (const char *buf, int len)
+{
+    int n = strlen (RC_MAGIC);
+    int i = len - 1;
+
+    if (i < 0 || buf[i] != '\n')
+        return (-1);
+
+    /* $? is at most 3 digits */
+    while (i > 0 && (len - 1 - i) < 3 && isdigit ((int) buf[i - 1]))
+        i--;
+
+    if ((i == len - 1) || (i < n) || memcmp (buf + i - n, RC_MAGIC, n))
+        return (-1);
+
+    return (i - n);
+}
+
+/*
+ *  Output a held line which looked like a return code trailer.
+ *   Called when more data follows it, meaning it was really part
+ *   of the command output.
  */
-static int _extract_rc(char *buf)
+static void _release_rc_line (thd_t *th)
 {
-    int ret = 0;
-    char *p = strstr(buf, RC_MAGIC);
-
-    if (p) {
-        if (buf[strlen(buf) - 1] == '\n' && p != buf)
-            *p++ = '\n';
-        *p = '\0';
-        p += strlen(RC_MAGIC);
-        ret = atoi(p);
+    if (th->rc_line == NULL)
+        return;
+    _write_output (th, DSH_STDOUT, th->rc_line, th->rc_len);
+    Free ((void **) &th->rc_line);
+}
+
+/*
+ *  Called at EOF on stdout: a held line is the return code trailer.
+ *   Extract the remote command return code, and output any command
+ *   output preceding the trailer (i.e. with no terminating newline).
+ */
+static void _extract_rc (thd_t *th)
+{
+    int off;
+
+    if (th->rc_line == NULL)
+        return;
+
+    off = _rc_trailer_offset (th->rc_line, th->rc_len);
+    assert (off >= 0);
+
+    th->rc = atoi (th->rc_line + off + strlen (RC_MAGIC));
+    if (off > 0) {
+        th->rc_line[off] = '\0';
+        _write_output (th, DSH_STDOUT, th->rc_line, off);
+    }
+    Free ((void **) &th->rc_line);
+}
+
+/*
+ *  Write the complete lines described by the [nspan] entries of [span]
+ *   to the local stdout or stderr with a single writev(2) per batch of
+ *   lines, adding the host label to each line. The lines are written
+ *   straight from cbuf memory instead of being copied out first.
+ */
+static void _write_lines_iov (thd_t *th, int stream,
+                              struct iovec *span, int nspan)
+{
+    FILE *fp = (stream == DSH_STDOUT) ? stdout : stderr;
+    struct iovec iov[DSH_IOV_MAX];
+    char label[LINEBUFSIZE];
+    int labellen = 0;
+    int cnt = 0;
+    int i;
+
+    if (th->labels) {
+        err_host_label (label, sizeof (label) - 2, th->host);
+        strcat (label, ": ");
+        labellen = strlen (label);
     }
-    return ret;
+
+    /*
+     *  Hold the stdio lock so our lines are not interleaved with output
+     *   from other threads, and flush anything already buffered in the
+     *   stream so output stays in order.
+     */
+    flockfile (fp);
+    fflush (fp);
+
+    for (i = 0; i < nspan; i++) {
+        char *p = span[i].iov_base;
+        char *end = p + span[i].iov_len;
+
+        while (p < end) {
+            char *nl = memchr (p, '\n', end - p);
+            char *next = nl ? nl + 1 : end;
+
+            /*  Need room for a label and up to two line pieces */
+            if (cnt > DSH_IOV_MAX - 2) {
+                fd_writev_n (fileno (fp), iov, cnt);
+                cnt = 0;
+            }
+            if (labellen && !th->partial[stream]) {
+                iov[cnt].iov_base = label;
+                iov[cnt++].iov_len = labellen;
+            }
+            iov[cnt].iov_base = p;
+            iov[cnt++].iov_len = next - p;
+
+            /*  A line may continue in the next span */
+            th->partial[stream] = (nl == NULL);
+            p = next;
+        }
+    }
+    if (cnt > 0)
+        fd_writev_n (fileno (fp), iov, cnt);
+
+    funlockfile (fp);
 }
 
-static void _flush_lines (cbuf_t cb, out_f outf, bool read_rc, thd_t *th)
+static void _flush_lines (thd_t *th, int stream)
 {
+    cbuf_t cb = _stream_cbuf (th, stream);
+    bool read_rc = (stream == DSH_STDOUT) && th->read_rc;
     char c;
     int n;
+    int nlines = 0;
+
+    /*
+     *  Plain text output with no return code trailer to look for can
+     *   be written directly out of the cbuf.
+     */
+    if (!read_rc && !use_outdir && !output_json && !output_ordered) {
+        struct iovec span[2];
+        int nspan;
+
+        while ((n = cbuf_peek_line_iov (cb, span, &nspan, -1)) > 0) {
+            _write_lines_iov (th, stream, span, nspan);
+            cbuf_drop (cb, n);
+        }
+        if (n < 0)
+            err ("%p: %S: Failed to peek lines: %m\n", th->host);
+        return;
+    }
 
     /*
      *  Use cbuf_peek_line with a single character buffer in order to
@@ -546,69 +902,294 @@ static void _flush_lines (cbuf_t cb, out_f outf, bool read_rc, thd_t *th)
                 err ("%p: %S: Failed to read line from buffer: %m\n", th->host);
                 break;
             }
-            if (read_rc)
-                th->rc = _extract_rc (buf);
-            if (strlen (buf) > 0) {
+            buf[n] = '\0';
+            if (read_rc) {
+                _release_rc_line (th);
                 /*
-                 *  We are careful to use a single call to write the line
-                 *   to the output stream to avoid interleaved lines of
-                 *   output.
+                 *  The return code trailer is the last line of output,
+                 *   so hold back any line that looks like one until
+                 *   we know whether more data follows.
                  */
-                if (th->labels)
-                    outf ("%S: %s", th->host, buf);
-                else
-                    outf ("%s", buf);
-                fflush (NULL);
+                if (_rc_trailer_offset (buf, n) >= 0) {
+                    th->rc_line = buf;
+                    th->rc_len = n;
+                    continue;
+                }
+            }
+            if ((n = strlen (buf)) > 0) {
+                _write_output (th, stream, buf, n);
+                if (!use_outdir && !output_json)
+                    fflush (NULL);
+                nlines++;
             }
         }
         Free ((void **)&buf);
     }
 
+    /*
+     *  JSON records all go to stdout, so there is no ordering with
+     *   stderr to preserve. Flush once per batch of lines instead.
+     */
+    if (output_json && nlines)
+        jsonout_flush ();
+
 }
 
-static int _do_output (int fd, cbuf_t cb, out_f outf, bool read_rc, thd_t *t)
+/*
+ *  Write out data remaining in the [stream] buffer of host [th],
+ *   whether or not it ends in a newline, leaving the last [keep] bytes.
+ *   Unless [eof] is set, a UTF-8 character cut off at the end of a JSON
+ *   record is left in the buffer to start the next one.
+ */
+static void _flush_partial (thd_t *th, int stream, int keep, int eof)
 {
+    cbuf_t cb = _stream_cbuf (th, stream);
+    int n;
+    char buf[8192];
+
+    while ((n = cbuf_used (cb) - keep) > 0) {
+        if ((n = cbuf_peek (cb, buf, MIN (n, (int) sizeof (buf) - 1))) <= 0)
+            break;
+        if (output_json && !eof)
+            n -= jsonout_utf8_partial (buf, n);
+        if (n <= 0 || cbuf_drop (cb, n) < 0)
+            break;
+        if (stream == DSH_STDOUT)
+            _release_rc_line (th);
+        buf[n] = '\0';
+        _write_output (th, stream, buf, n);
+    }
+}
+
+/*
+ *  Read available data from [fd] into the [stream] buffer of host [t]
+ *   and write out complete lines. Keep reading until the fd is drained
+ *   or DSH_READ_QUANTUM bytes have been read, so a busy host costs
+ *   fewer poll wakeups without starving its other stream.
+ *  Returns 0 on EOF, -1 on error, or > 0 if the fd is still open.
+ */
+static int _do_output (int fd, int stream, thd_t *t)
+{
+    cbuf_t cb = _stream_cbuf (t, stream);
+    int total = 0;
+    int space;
     int rc;
-    int dropped = 0;
 
-    if ((rc = cbuf_write_from_fd (cb, fd, -1, &dropped)) < 0) {
-        if (errno == EAGAIN)
-            return (1);
-        err ("%p: %S: read: %m\n", t->host);
-        return (-1);
+    while (total < DSH_READ_QUANTUM) {
+        /*
+         *  Output is never overwritten. A full buffer fails with ENOSPC
+         *   and the data is left in the socket until there is room.
+         */
+        space = cbuf_free (cb);
+        t->nreads++;
+        if ((rc = cbuf_readv_from_fd (cb, fd, -1)) < 0) {
+            if (errno == EAGAIN)
+                return (1);
+            if (errno != ENOSPC) {
+                err ("%p: %S: read: %m\n", t->host);
+                return (-1);
+            }
+            rc = 0;
+        }
+        else if (rc == 0)
+            return (0);
+
+        t->nbytes += rc;
+        progress_add_bytes (PROGRESS_OUTPUT, rc);
+        if (rc > 0 && !t->ts[TIMING_FIRST_BYTE])
+            timing_mark (t->ts, TIMING_FIRST_BYTE);
+        total += rc;
+
+        _flush_lines (t, stream);
+
+        /*
+         *  A full buffer with no newline holds a line longer than the
+         *   host buffer size. Write out what we have so reading can go
+         *   on, holding back enough to recognize a return code trailer.
+         */
+        if (cbuf_used (cb) >= host_buffer_size) {
+            int keep = 0;
+            if (stream == DSH_STDOUT && t->read_rc)
+                keep = strlen (RC_MAGIC) + 4;
+            _flush_partial (t, stream, keep, 0);
+        }
+        else if (rc < space)
+            break;              /* short read, the fd is drained */
     }
 
-    _flush_lines (cb, outf, read_rc, t);
+    return (1);
+}
+
+static void _flush_output (thd_t *th, int stream)
+{
+    _flush_lines (th, stream);
 
-    return (rc);
+    /* In case no newline at end of buffer, grab the rest of data */
+    _flush_partial (th, stream, 0, 1);
+
+    if (stream == DSH_STDOUT && th->read_rc)
+        _extract_rc (th);
+
+    return;
 }
 
-static void _flush_output (cbuf_t cb, out_f outf, thd_t *th)
+static const char * _state_str (state_t state)
 {
-    int n;
-    bool labeled = false;
-    char buf[8192];
+    switch (state) {
+    case DSH_NEW:      return ("new");
+    case DSH_RCMD:     return ("connecting");
+    case DSH_READING:  return ("running");
+    case DSH_DONE:     return ("done");
+    case DSH_FAILED:   return ("failed");
+    case DSH_CANCELED: return ("canceled");
+    }
+    return ("unknown");
+}
 
-    _flush_lines (cb, outf, false, t);
+/*
+ *  Record the phases of host `th' as trace spans, nested in a span for
+ *   the whole host named after its final state.
+ */
+static void _trace_host (thd_t *th)
+{
+    unsigned long long *ts = th->ts;
+    unsigned long long end = ts[TIMING_REAPED];
 
-    /* In case no newline at end of buffer, grab the rest of data */
-    while ((n = cbuf_read (cb, buf, sizeof (buf) - 1)) > 0) {
-        buf[n] = '\0';
-        if (th->labels && !labeled) {
-            outf ("%S: ", th->host);
-            labeled = true;
-        }
-        outf ("%s", buf);
+    if (!trace_enabled ())
+        return;
+
+    trace_span ("host", _state_str (th->state), ts[TIMING_CREATE], end,
+                "rc", th->rc);
+    trace_span ("host", "spawn", ts[TIMING_CREATE], ts[TIMING_START],
+                NULL, 0);
+    trace_span ("host", "connect", ts[TIMING_START],
+                ts[TIMING_CONNECTED] ? ts[TIMING_CONNECTED] : end, NULL, 0);
+    if (ts[TIMING_CONNECTED] && ts[TIMING_LAST_BYTE]) {
+        trace_span ("host", "command", ts[TIMING_CONNECTED],
+                    ts[TIMING_LAST_BYTE], NULL, 0);
+        trace_span ("host", "reap", ts[TIMING_LAST_BYTE], end, NULL, 0);
     }
+}
 
-    return;
+/*
+ *  Write the final JSON record for host [th].
+ */
+static void _json_exit (thd_t *th)
+{
+    unsigned long long *ts = th->ts;
+    double connect_time = 0.0;
+    double command_time = 0.0;
+
+    if (ts[TIMING_START]) {
+        unsigned long long end = ts[TIMING_CONNECTED];
+
+        if (!end)
+            end = ts[TIMING_REAPED] ? ts[TIMING_REAPED] : timing_now ();
+        connect_time = (end - ts[TIMING_START]) / 1e9;
+    }
+    if (ts[TIMING_CONNECTED] && ts[TIMING_LAST_BYTE])
+        command_time = (ts[TIMING_LAST_BYTE] - ts[TIMING_CONNECTED]) / 1e9;
+
+    jsonout_exit (th->host, _state_str (th->state), th->rc,
+                  connect_time, command_time);
+    jsonout_flush ();
 }
 
+/*
+ *  Update the global count of buffered output with the amount now
+ *   held in the buffers of host [th].
+ */
+static void _update_buffered (thd_t *th)
+{
+    int n = 0;
+
+    if (output_memory_limit == 0)
+        return;
+
+    if (th->outbuf)
+        n += cbuf_used (th->outbuf);
+    if (th->errbuf)
+        n += cbuf_used (th->errbuf);
+
+    if (n == th->buffered)
+        return;
+
+    dsh_mutex_lock (&buffered_mutex);
+    buffered_bytes += n - th->buffered;
+    if (n < th->buffered)
+        pthread_cond_broadcast (&buffered_cond);
+    dsh_mutex_unlock (&buffered_mutex);
+
+    th->buffered = n;
+}
+
+/*
+ *  Wait until the output memory budget allows host [th] to read more.
+ *   A host already holding buffered data is never held up, since that
+ *   data is only released by reading the rest of its line. Returns
+ *   early if the command timeout expires.
+ */
+static void _wait_for_output_budget (thd_t *th)
+{
+    struct timespec ts;
+
+    if (output_memory_limit == 0 || th->buffered > 0)
+        return;
+
+    dsh_mutex_lock (&buffered_mutex);
+    while ((buffered_bytes >= output_memory_limit)
+           && !_thd_command_timeout (th)) {
+        ts.tv_sec = time (NULL) + 1;
+        ts.tv_nsec = 0;
+        pthread_cond_timedwait (&buffered_cond, &buffered_mutex, &ts);
+    }
+    dsh_mutex_unlock (&buffered_mutex);
+}
+
+/*
+ *  Output buffers are only allocated once a host's thread starts,
+ *   and freed when it completes, so memory use is proportional to
+ *   fanout rather than the number of hosts. Since only the host's
+ *   thread touches them, they are created without locking.
+ *
+ *  With CBUF_NO_DROP a write into a full buffer fails with ENOSPC
+ *   instead of overwriting unread data, so output is never dropped
+ *   and there is no dropped count to report.
+ */
+static void _thd_buffers_create (thd_t *th)
+{
+    int minsize = MIN (DSH_BUFFER_MINSIZE, host_buffer_size);
+
+    if (pdsh_personality () == DSH) {
+        th->outbuf = cbuf_create_unlocked (minsize, host_buffer_size);
+        cbuf_opt_set (th->outbuf, CBUF_OPT_OVERWRITE, CBUF_NO_DROP);
+    }
+    th->errbuf = cbuf_create_unlocked (minsize, host_buffer_size);
+    cbuf_opt_set (th->errbuf, CBUF_OPT_OVERWRITE, CBUF_NO_DROP);
+}
+
+static void _thd_buffers_destroy (thd_t *th)
+{
+    _update_buffered (th);
+    if (th->outbuf)
+        cbuf_destroy (th->outbuf);
+    if (th->errbuf)
+        cbuf_destroy (th->errbuf);
+    th->outbuf = th->errbuf = NULL;
+}
+
+/*
+ *  Terminate all processes if the command on host [th] was killed by a
+ *   signal. Without a module-reported signal, only a return code trailer
+ *   can tell: the remote shell reports death by signal as 128 + signo.
+ */
 static int _die_if_signalled (thd_t *th)
 {
-    int sig;
+    int sig = th->signal;
 
-    if ((sig = (th->rc - 128)) <= 0)
+    if (!sig && th->read_rc)
+        sig = th->rc - 128;
+    if (sig <= 0)
         return (0);
 
     err ("%p: process on host %S killed by signal %d\n", th->host, sig);
@@ -619,26 +1200,34 @@ static int _die_if_signalled (thd_t *th)
     return (0);
 }
 
-static int _handle_rcmd_stdout (thd_t *th)
+/*
+ *  Close an rcmd fd at EOF or error. The fd is removed from poll set
+ *   [ps] (if any) first, since epoll cannot find an fd once it is closed.
+ */
+static void _close_rcmd_fd (int *fdp, xpollset_t ps)
 {
-    int rc = _do_output (th->rcmd->fd, th->outbuf, (out_f) out, true, th);
+    if (ps)
+        xpollset_remove (ps, *fdp);
+    close (*fdp);
+    *fdp = -1;
+}
 
-    if (rc <= 0) {
-        close (th->rcmd->fd);
-        th->rcmd->fd = -1;
-    }
+static int _handle_rcmd_stdout (thd_t *th, xpollset_t ps)
+{
+    int rc = _do_output (th->rcmd->fd, DSH_STDOUT, th);
+
+    if (rc <= 0)
+        _close_rcmd_fd (&th->rcmd->fd, ps);
 
     return (rc);
 }
 
-static int _handle_rcmd_stderr (thd_t *th)
+static int _handle_rcmd_stderr (thd_t *th, xpollset_t ps)
 {
-    int rc = _do_output (th->rcmd->efd, th->errbuf, (out_f) err, false, th);
+    int rc = _do_output (th->rcmd->efd, DSH_STDERR, th);
 
-    if (rc <= 0) {
-        close (th->rcmd->efd);
-        th->rcmd->efd = -1;
-    }
+    if (rc <= 0)
+        _close_rcmd_fd (&th->rcmd->efd, ps);
 
     return (rc);
 }
@@ -652,55 +1241,73 @@ static void *_rsh_thread(void *args)
     thd_t *a = (thd_t *) args;
     int rv;
     int result = DSH_DONE;      /* the desired outcome */
-    struct xpollfd xpfds[2];
-    int nfds = 1;
+    struct xpollfd ready[2];
+    xpollset_t ps = NULL;
+    int nopen = 0;
+    int tracing = trace_enabled ();
+    int i;
 
     a->start = time(NULL);
+    timing_mark (a->ts, TIMING_START);
+    trace_thread (a->nodeid + 1, a->host);
 
 #if	HAVE_MTSAFE_GETHOSTBYNAME
     if (a->rcmd->opts->resolve_hosts)
         _gethost(a->host, a->addr);
 #endif
+    timing_mark (a->ts, TIMING_RESOLVED);
     _xsignal (SIGPIPE, SIG_IGN);
 
-    /* establish the connection */
-    dsh_mutex_lock(&thd_mutex);
-    a->state = DSH_RCMD;
-    dsh_mutex_unlock(&thd_mutex);
+    _thd_buffers_create (a);
+
+    if (use_outdir) {
+        a->outfile = outdir_file_create (a->host, NULL);
+        if (a->dsh_sopt)
+            a->errfile = outdir_file_create (a->host, "err");
+    }
 
-    rcmd_connect (a->rcmd, a->host, a->addr, a->luser, a->ruser,
-                  a->cmd, a->nodeid, a->dsh_sopt);
+    /* establish the connection, unless canceled before we got here */
+    if (_change_state (a, DSH_NEW, DSH_RCMD))
+        rcmd_connect (a->rcmd, a->host, a->addr, a->luser, a->ruser,
+                      a->cmd, a->nodeid, a->dsh_sopt);
+
+    if (a->rcmd->fd != -1)
+        timing_mark (a->ts, TIMING_CONNECTED);
 
     if (a->rcmd->fd == -1) {
         result = DSH_FAILED;    /* connect failed */
     } else if (_update_connect_state(a) != DSH_CANCELED) {
 
-        fd_set_nonblocking (a->rcmd->fd);
+        /*
+         *  The poll set is built once, so the read loop below does
+         *   no allocation per wakeup.
+         */
+        if (!(ps = xpollset_create (2)))
+            errx ("%p: %S: xpollset_create: %m\n", a->host);
 
-        memset (xpfds, 0, sizeof (xpfds));
+        fd_set_nonblocking (a->rcmd->fd);
+        if (xpollset_add (ps, a->rcmd->fd, XPOLLREAD) < 0)
+            errx ("%p: %S: xpollset_add: %m\n", a->host);
+        nopen++;
 
-        /* prep for poll call */
-        xpfds[0].fd = a->rcmd->fd;
         if (a->dsh_sopt) {      /* separate stderr */
             fd_set_nonblocking (a->rcmd->efd);
-            xpfds[1].fd = a->rcmd->efd;
-            nfds++;
+            if (xpollset_add (ps, a->rcmd->efd, XPOLLREAD) < 0)
+                errx ("%p: %S: xpollset_add: %m\n", a->host);
+            nopen++;
         }
-        else
-            xpfds[1].fd = -1;
-
-        xpfds[0].events = xpfds[1].events = POLLIN; 
-#if	STDIN_BCAST             /* not yet supported */
-        xpfds[0].events |= POLLOUT;
-#endif
 
         /*
          * poll / read / report loop.
          */
-        while (xpfds[0].fd >= 0 || xpfds[1].fd >= 0) {
+        while (nopen > 0) {
+
+            /* stop reading while over the output memory budget */
+            _wait_for_output_budget (a);
 
             /* poll (possibility for SIGALRM) */
-            rv = xpoll(xpfds, nfds, -1);
+            rv = xpollset_wait (ps, ready, 2, -1);
+            a->npolls++;
             if (rv == -1) {
                 if (errno != EINTR) 
                     err("%p: %S: xpoll: %m\n", a->host);
@@ -714,21 +1321,39 @@ static void *_rsh_thread(void *args)
                 break;
             }
 
-            /* stdout ready or closed ? */
-            if (xpfds[0].revents & (XPOLLREAD|XPOLLERR)) {
-                if (_handle_rcmd_stdout (a) <= 0)
-                    xpfds[0].fd = -1;
-            }
-
-            /* stderr ready or closed ? */
-            if (a->dsh_sopt && xpfds[1].revents & (XPOLLREAD|XPOLLERR)) {
-                if (_handle_rcmd_stderr (a) <= 0)
-                    xpfds[1].fd = -1;
+            for (i = 0; i < rv; i++) {
+                int fd = ready[i].fd;
+                unsigned long long start = 0;
+                long nbytes = a->nbytes;
+                const char *name;
+                int rc;
+
+                if (!(ready[i].revents & (XPOLLREAD|XPOLLERR)))
+                    continue;
+
+                if (tracing)
+                    start = timing_now ();
+
+                /* stdout or stderr ready or closed */
+                if (fd == a->rcmd->fd) {
+                    name = "stdout";
+                    rc = _handle_rcmd_stdout (a, ps);
+                } else if (a->dsh_sopt && fd == a->rcmd->efd) {
+                    name = "stderr";
+                    rc = _handle_rcmd_stderr (a, ps);
+                } else
+                    continue;
+
+                if (tracing)
+                    trace_span ("output", name, start, timing_now (),
+                                "bytes", a->nbytes - nbytes);
+
+                /* the handler has removed and closed fd at EOF or error */
+                if (rc <= 0)
+                    nopen--;
             }
 
-            /* kill parallel job if kill_on_fail and one task was signaled */
-            if (a->kill_on_fail) 
-                _die_if_signalled (a);
+            _update_buffered (a);
 
 #if	STDIN_BCAST             /* not yet supported */
             /* stdin ready ? */
@@ -736,22 +1361,44 @@ static void *_rsh_thread(void *args)
             }
 #endif
         }
+        xpollset_destroy (ps);
+        timing_mark (a->ts, TIMING_LAST_BYTE);
     }
 
     /* update status */
-    dsh_mutex_lock(&thd_mutex);
-    a->state = result;
+    if (_finish_state (a, result) == DSH_READING)
+        progress_command_time (a->ts[TIMING_LAST_BYTE]
+                               - a->ts[TIMING_CONNECTED]);
     a->finish = time(NULL);
-    dsh_mutex_unlock(&thd_mutex);
 
     /* flush any pending output */
-    _flush_output (a->outbuf, (out_f) out, a);
-    _flush_output (a->errbuf, (out_f) err, a);
+    _flush_output (a, DSH_STDOUT);
+    _flush_output (a, DSH_STDERR);
+
+    outdir_file_destroy (a->outfile);
+    outdir_file_destroy (a->errfile);
+    a->outfile = a->errfile = NULL;
 
-    rv = rcmd_destroy (a->rcmd);
+    _thd_buffers_destroy (a);
+
+    _wait_for_signalers (a);
+    rv = rcmd_destroy (a->rcmd, &a->signal);
+    timing_mark (a->ts, TIMING_REAPED);
     if ((a->rc == 0) && (rv > 0))
         a->rc = rv;
 
+    _trace_host (a);
+
+    if (output_json)
+        _json_exit (a);
+
+    if (output_ordered)
+        outorder_done (a->nodeid);
+
+    /* kill parallel job if kill_on_fail and one task was signaled */
+    if (a->kill_on_fail)
+        _die_if_signalled (a);
+
     /* if a single qshell thread fails, terminate whole job */
     if (a->kill_on_fail && ((a->state == DSH_FAILED) || (a->rc > 0))) {
         _fwd_signal(SIGTERM);
@@ -759,56 +1406,196 @@ static void *_rsh_thread(void *args)
     }
 
     /* Signal dsh() so another thread can replace us */
-    dsh_mutex_lock(&threadcount_mutex);
-    threadcount--;
-    pthread_cond_signal(&threadcount_cond);
-    dsh_mutex_unlock(&threadcount_mutex);
+    _thd_release (a);
     return NULL;
 }
 
-#define TIME_T_YEAR	60*60*24*7*52
+/*
+ *  Report how many poll wakeups and read calls were needed per MB of
+ *   remote output.
+ */
+static void _dump_io_stats(void)
+{
+    double mb;
+    char str[128];
+
+    if (summary.bytes == 0)
+        return;
+
+    mb = summary.bytes / (1024 * 1024);
+    snprintf(str, sizeof(str), "%.0f bytes, %.0f polls, %.0f reads "
+             "(%.1f polls/MB, %.1f reads/MB)",
+             summary.bytes, summary.polls, summary.reads,
+             summary.polls / mb, summary.reads / mb);
+    err("Output I/O:    %s\n", str);
+}
 
 /*
- * If debugging, call this to dump thread connect/command times.
+ *  Phases reported by _dump_timing_stats(), each the interval between
+ *   two timing points, with the durations of retired hosts that reached
+ *   both ends of it.
  */
-static void _dump_debug_stats(int rshcount)
+static struct phase {
+    const char *name;
+    timing_point_t from;
+    timing_point_t to;
+    hist_t h;
+    unsigned long long tot;
+    unsigned long long min;
+    unsigned long long max;
+} phases[] = {
+    { "Spawn",      TIMING_CREATE,    TIMING_START      },
+    { "Resolve",    TIMING_START,     TIMING_RESOLVED   },
+    { "Connect",    TIMING_RESOLVED,  TIMING_CONNECTED  },
+    { "First byte", TIMING_CONNECTED, TIMING_FIRST_BYTE },
+    { "Command",    TIMING_CONNECTED, TIMING_LAST_BYTE  },
+    { "Reap",       TIMING_LAST_BYTE, TIMING_REAPED     },
+    { "Total",      TIMING_CREATE,    TIMING_REAPED     },
+    { NULL,         0,                0                 }
+};
+
+/*
+ *  Add the phase durations of host `th' to the -d timing stats.
+ */
+static void _phase_stats_add(thd_t *th)
 {
-    time_t conTot = 0, conMin = TIME_T_YEAR, conMax = 0;
-    time_t cmdTot = 0, cmdMin = TIME_T_YEAR, cmdMax = 0;
-    int failed = 0;
-    int canceled = 0;
-    int n;
+    struct phase *p;
+    unsigned long long d;
 
-    for (n = 0; n < rshcount; n++) {
-        if (t[n].state == DSH_FAILED) {
-            failed++;
+    for (p = phases; p->name != NULL; p++) {
+        if (!th->ts[p->from] || !th->ts[p->to])
             continue;
+        d = th->ts[p->to] - th->ts[p->from];
+        if (p->h == NULL) {
+            p->h = hist_create ();
+            p->min = ~0ULL;
         }
-        if (t[n].state == DSH_CANCELED) {
-            canceled++;
-            continue;
-        }
-        assert(t[n].start && t[n].connect && t[n].finish);
-
-        conTot += t[n].connect - t[n].start;
-        cmdTot += t[n].finish - t[n].connect;
-        conMin = MIN(conMin, t[n].connect - t[n].start);
-        conMax = MAX(conMax, t[n].connect - t[n].start);
-        cmdMin = MIN(cmdMin, t[n].finish - t[n].connect);
-        cmdMax = MAX(cmdMax, t[n].finish - t[n].connect);
+        hist_add (p->h, d);
+        p->tot += d;
+        p->min = MIN (p->min, d);
+        p->max = MAX (p->max, d);
     }
-    if (rshcount > failed) {
-        err("Connect time:  Avg: %d sec, Min: %d sec,  Max: %d sec\n",
-            conTot / (rshcount - failed), conMin, conMax);
-        err("Command time:  Avg: %d sec, Min: %d sec,  Max: %d sec\n",
-            cmdTot / (rshcount - failed), cmdMin, cmdMax);
-    } else {
-        err("Connect time:  no sucesses\n");
-        err("Command time:  no sucesses\n");
+}
+
+/*
+ *  Dump avg/min/max and p50/p90/p99/p999 of each phase over all hosts
+ *   that reached both ends of it.
+ */
+static void _dump_timing_stats(void)
+{
+    struct phase *p;
+    char avg[16], min[16], max[16];
+    char p50[16], p90[16], p99[16], p999[16];
+    char label[16];
+    char str[256];
+
+    for (p = phases; p->name != NULL; p++) {
+        long count = p->h ? hist_count (p->h) : 0;
+
+        snprintf (label, sizeof (label), "%s:", p->name);
+        if (count == 0)
+            snprintf (str, sizeof (str), "%-15sno successes", label);
+        else
+            snprintf (str, sizeof (str), "%-15sAvg: %s, Min: %s, Max: %s, "
+                      "p50: %s, p90: %s, p99: %s, p999: %s (%ld hosts)",
+                      label,
+                      timing_fmt (avg, sizeof (avg), p->tot / count),
+                      timing_fmt (min, sizeof (min), p->min),
+                      timing_fmt (max, sizeof (max), p->max),
+                      timing_fmt (p50, sizeof (p50),
+                                  hist_percentile (p->h, 50)),
+                      timing_fmt (p90, sizeof (p90),
+                                  hist_percentile (p->h, 90)),
+                      timing_fmt (p99, sizeof (p99),
+                                  hist_percentile (p->h, 99)),
+                      timing_fmt (p999, sizeof (p999),
+                                  hist_percentile (p->h, 99.9)),
+                      count);
+        err ("%s\n", str);
+
+        if (p->h)
+            hist_destroy (p->h);
+        p->h = NULL;
+    }
+}
+
+/*
+ *  Open the per-host timings file `path' and write its header. Hosts are
+ *   written to it one per line as they are retired, as tab separated
+ *   nanoseconds since the first thread was created.
+ */
+static int _timing_file_open(const char *path)
+{
+    int i;
+
+    if (!(timing_fp = fopen (path, "w")))
+        return (-1);
+
+    fprintf (timing_fp, "#host\tstate\trc");
+    for (i = 0; i < TIMING_NPOINTS; i++)
+        fprintf (timing_fp, "\t%s", timing_point_name (i));
+    fprintf (timing_fp, "\n");
+
+    return (0);
+}
+
+/*
+ *  Write the timing points of host `th' to the timings file. Points the
+ *   host did not reach are written as "-".
+ */
+static void _timing_file_write(thd_t *th)
+{
+    int i;
+
+    fprintf (timing_fp, "%s\t%s\t%d", th->host, _state_str (th->state),
+             th->rc);
+    for (i = 0; i < TIMING_NPOINTS; i++) {
+        if (th->ts[i])
+            fprintf (timing_fp, "\t%llu", th->ts[i] - timing_t0);
+        else
+            fprintf (timing_fp, "\t-");
     }
-    err("Failures:      %d\n", failed);
-    if (canceled)
-        err("Canceled:      %d\n", canceled);
+    fprintf (timing_fp, "\n");
+}
+
+/*
+ *  Report wall clock time since dsh() started along with the CPU time
+ *   and peak memory use of this process.
+ */
+static void _dump_rusage(void)
+{
+    struct rusage ru;
+    char elapsed[64], utime[64], stime[64];
+
+    if (getrusage (RUSAGE_SELF, &ru) < 0)
+        return;
+
+    timing_fmt (elapsed, sizeof (elapsed), timing_now () - dsh_start);
+    timing_fmt (utime, sizeof (utime),
+                ru.ru_utime.tv_sec * 1000000000ULL
+                + ru.ru_utime.tv_usec * 1000ULL);
+    timing_fmt (stime, sizeof (stime),
+                ru.ru_stime.tv_sec * 1000000000ULL
+                + ru.ru_stime.tv_usec * 1000ULL);
+
+    err("Elapsed:       %s\n", elapsed);
+    err("CPU time:      %s user, %s system\n", utime, stime);
+    err("Max RSS:       %d KB\n", (int) ru.ru_maxrss);
+}
+
+/*
+ * If debugging, call this to dump thread connect/command times.
+ */
+static void _dump_debug_stats(void)
+{
+    _dump_timing_stats();
+
+    err("Failures:      %d\n", summary.failed);
+    if (summary.canceled)
+        err("Canceled:      %d\n", summary.canceled);
+
+    _dump_io_stats();
+    _dump_rusage();
 }
 
 /*
@@ -860,16 +1647,86 @@ static void _increase_nofile_limit (opt_t *opt)
     return;
 }
 
-static int _thd_init (thd_t *th, opt_t *opt, List pcp_infiles, int i)
+/*
+ *  Return true if the hosts in `hosts' do not all have the same domain.
+ */
+static bool _domains_differ (hostlist_frozen_t hosts)
+{
+    int n = hostlist_frozen_count (hosts);
+    char *domain = NULL;
+    char *buf = NULL;
+    int size = 0;
+    bool differ = false;
+    int i;
+
+    for (i = 0; i < n && !differ; i++) {
+        char *d;
+        int len;
+
+        if ((len = hostlist_frozen_nth (hosts, i, buf, size)) >= size) {
+            if (buf)
+                Free ((void **) &buf);
+            size = len + 64;
+            buf = Malloc (size);
+            hostlist_frozen_nth (hosts, i, buf, size);
+        }
+
+        if (!(d = strchr (buf, '.')))
+            continue;
+        if (domain == NULL)
+            domain = Strdup (d);
+        else if (strcmp (d, domain) != 0)
+            differ = true;
+    }
+
+    if (domain)
+        Free ((void **) &domain);
+    if (buf)
+        Free ((void **) &buf);
+
+    return (differ);
+}
+
+/*
+ *  Set up slot `th' to run host `i' of `hosts'. The slot's hostname
+ *   buffer is kept from its previous host and only grown when needed.
+ *   Called with threadcount_mutex held.
+ */
+static int _thd_init (thd_t *th, opt_t *opt, List pcp_infiles,
+                      hostlist_frozen_t hosts, int i, char *statcmd)
 { 
+    char *host = th->hostbuf;
+    int size = th->hostbuf_size;
+    int len;
+
+    if ((len = hostlist_frozen_nth (hosts, i, host, size)) >= size) {
+        if (host)
+            Free ((void **) &host);
+        size = len + 64;
+        host = Malloc (size);
+        hostlist_frozen_nth (hosts, i, host, size);
+    }
+
+    /*
+     *  _fwd_signal() and _wdog() read the state of every slot without
+     *   a lock, so reset it atomically first and leave it out of the
+     *   memset. While the slot is DSH_NEW neither touches the rest.
+     */
+    xatomic_xchg_int (&th->state, DSH_NEW);
+    memset (th, 0, offsetof (thd_t, state));
+    memset (&th->state + 1, 0,
+            sizeof (*th) - offsetof (thd_t, state) - sizeof (th->state));
+    th->hostbuf = host;
+    th->hostbuf_size = size;
+
     th->luser = opt->luser;        /* general */
     th->ruser = opt->ruser;
-    th->state = DSH_NEW;
     th->labels = opt->labels;
     th->nodeid = i;
     th->cmd = opt->cmd;
     th->dsh_sopt = opt->separate_stderr;  /* dsh-specific */
     th->rc = 0;
+    th->signal = 0;
     th->pcp_infiles = pcp_infiles;        /* pcp-specific */
     th->pcp_outfile = opt->outfile_name;
     th->pcp_popt = opt->preserve;
@@ -880,14 +1737,31 @@ static int _thd_init (thd_t *th, opt_t *opt, List pcp_infiles, int i)
     th->pcp_progname = opt->progname;
     th->outfile_name = opt->outfile_name;
     th->kill_on_fail = opt->kill_on_fail;
-    th->outbuf = cbuf_create (64, 131072);
-    th->errbuf = cbuf_create (64, 131072);
-
-    if (!(th->rcmd = rcmd_create (th->host))) {
-        th->state = DSH_CANCELED;
+    th->outbuf = NULL;             /* allocated when thread starts */
+    th->errbuf = NULL;
+    th->buffered = 0;
+    th->partial[DSH_STDOUT] = th->partial[DSH_STDERR] = false;
+    th->npolls = th->nreads = 0;
+    th->nbytes = 0;
+    th->outfile = NULL;
+    th->errfile = NULL;
+
+    th->host = th->hostbuf;
+
+    if (cancel_pending || !(th->rcmd = rcmd_create (th->host))) {
+        _change_state (th, DSH_NEW, DSH_CANCELED);
         return (-1);
     }
 
+    /*
+     *  Unless the rcmd module collects the remote exit status itself,
+     *   run the command with a return code trailer appended.
+     */
+    if (statcmd && !th->rcmd->opts->exit_status) {
+        th->cmd = statcmd;
+        th->read_rc = true;
+    }
+
 #if	!HAVE_MTSAFE_GETHOSTBYNAME
     /* if MT-safe, do it in parallel in rsh/rcp threads */
     /* gethostbyname_r is not very portable so skip it */
@@ -899,6 +1773,48 @@ static int _thd_init (thd_t *th, opt_t *opt, List pcp_infiles, int i)
 
 }
 
+/*
+ *  Add the host last run in slot `th', if any, to the totals and the
+ *   timings file, and mark the slot free. Called with threadcount_mutex
+ *   held, once the host's thread (if any) has finished.
+ */
+static void _thd_retire (thd_t *th)
+{
+    if (th->host == NULL)
+        return;
+
+    if (th->state == DSH_FAILED)
+        summary.failed++;
+    else if (th->state == DSH_CANCELED)
+        summary.canceled++;
+    if (th->rc > summary.rc)
+        summary.rc = th->rc;
+
+    summary.polls += th->npolls;
+    summary.reads += th->nreads;
+    summary.bytes += th->nbytes;
+
+    if (debug)
+        _phase_stats_add (th);
+    if (timing_fp)
+        _timing_file_write (th);
+
+    th->host = NULL;
+}
+
+/*
+ *  Called by a host thread when it is finished with its slot, to let
+ *   dsh() start another host in it.
+ */
+static void _thd_release (thd_t *th)
+{
+    dsh_mutex_lock (&threadcount_mutex);
+    free_slots[nfree++] = th - t;
+    threadcount--;
+    pthread_cond_signal (&threadcount_cond);
+    dsh_mutex_unlock (&threadcount_mutex);
+}
+
 static int 
 _cancel_pending_threads (void)
 {
@@ -909,12 +1825,19 @@ _cancel_pending_threads (void)
         return (0);
 
     dsh_mutex_lock (&threadcount_mutex);
-    for (i = 0; t[i].host != NULL; i++) {
-        if ((t[i].state == DSH_NEW) || (t[i].state == DSH_RCMD)) {
-            t[i].state = DSH_CANCELED;
+    for (i = 0; i < nslots; i++) {
+        if (t[i].host == NULL)
+            continue;
+        if (_cancel_state (&t[i]))
             ++n;
-        }
     }
+
+    /*
+     *  Hosts not yet started are canceled by dsh() as it reaches them
+     */
+    cancel_pending = 1;
+    n += nhosts - next_host;
+
     err ("%p: Canceled %d pending threads.\n", n);
     dsh_mutex_unlock (&threadcount_mutex);
 
@@ -1001,14 +1924,16 @@ int dsh(opt_t * opt)
 {
     int i, rc = 0;
     int rv, rshcount;
+    int order_failed = 0;
     pthread_t thread_wdog;
     pthread_t thread_sig;
     pthread_attr_t attr_wdog;
     pthread_attr_t attr_sig;
     List pcp_infiles = NULL;
-    hostlist_iterator_t itr;
-    const char *domain = NULL;
-    bool domain_in_label = false;
+    hostlist_frozen_t hosts;
+    char *statcmd = NULL;
+
+    dsh_start = timing_now ();
 
     _mask_signals (SIG_BLOCK);
 
@@ -1022,13 +1947,35 @@ int dsh(opt_t * opt)
 
     _increase_nofile_limit (opt);
 
+    /* per-host output files */
+    if (pdsh_personality() == DSH && opt->outdir) {
+        if (outdir_init (opt->outdir, opt->outdir_max_open, opt->fanout) < 0)
+            errx ("%p: %s: %m\n", opt->outdir);
+        use_outdir = 1;
+    }
+
+    if (pdsh_personality() == DSH && opt->output_format == OUTPUT_JSON)
+        output_json = 1;
+
+    if (pdsh_personality() == DSH && opt->output_order != OUTORDER_NONE)
+        output_ordered = 1;
+
     /* install signal handlers */
     _xsignal(SIGALRM, _alarm_handler);
 
     if (opt->sigint_terminates)
         sigint_terminates = 1;
 
-    rshcount = hostlist_count(opt->wcoll);
+    /*
+     *  wcoll does not change from here on, so work from a frozen copy
+     *   which threads may read without taking the hostlist lock.
+     */
+    if (!(hosts = hostlist_freeze(opt->wcoll)))
+        errx("%p: hostlist_freeze failed\n");
+    rshcount = hostlist_frozen_count(hosts);
+
+    if (output_ordered)
+        outorder_init (rshcount, opt->output_order, opt->order_memory_limit);
 
     /* prepend DSHPATH setting to command */
     if (pdsh_personality() == DSH && opt->dshpath) {
@@ -1039,17 +1986,14 @@ int dsh(opt_t * opt)
         opt->cmd = cmd;
     }
 
-    /* Initialize getstat if needed */
-    if (opt->kill_on_fail || opt->ret_remote_rc) 
+    /* Initialize getstat if needed (-O json always reports rc) */
+    if (opt->kill_on_fail || opt->ret_remote_rc || output_json)
         opt->getstat = ";echo " RC_MAGIC "$?";
 
-    /* append echo $? to command */
+    /* command with echo $? appended, for rcmd modules that need it */
     if (pdsh_personality() == DSH && opt->getstat) {
-        char *cmd = Strdup(opt->cmd);
-
-        xstrcat(&cmd, opt->getstat);
-        Free((void **) &opt->cmd);
-        opt->cmd = cmd;
+        statcmd = Strdup(opt->cmd);
+        xstrcat(&statcmd, opt->getstat);
     }
 
     /* build PCP command */
@@ -1103,42 +2047,47 @@ int dsh(opt_t * opt)
     if (opt->debug)
         debug = 1;
 
-    /* build thread array--terminated with t[i].host == NULL */
-    t = (thd_t *) Malloc(sizeof(thd_t) * (rshcount + 1));
-
-    if (!(itr = hostlist_iterator_create(opt->wcoll)))
-        errx("%p: hostlist_iterator_create failed\n");
-    i = 0;
-    while ((t[i].host = hostlist_next(itr))) {
-        char *d;
-        
-        assert(i < rshcount);
-
-        _thd_init (&t[i], opt, pcp_infiles, i);
+    if (opt->trace_file) {
+        trace_init (opt->trace_file);
+        trace_thread (0, "dispatch");
+    }
 
-        /*
-         * Require domain names in labels if hosts have 
-         *  different domains
-         */
-        if (!domain_in_label && (d = strchr (t[i].host, '.'))) {
-            if (domain == NULL)
-                domain = d;
-            else if (strcmp (d, domain) != 0)
-                domain_in_label = true;
-        }
+    /* live status line, started before any thread changes state */
+    if (opt->progress_fd >= 0
+        && progress_init (opt->progress_fd, opt->progress_interval,
+                          rshcount) < 0)
+        errx ("%p: PDSH_PROGRESS=%d: %m\n", opt->progress_fd);
 
-        i++;
-    }
-    assert(i == rshcount);
-    hostlist_iterator_destroy(itr);
+    /*
+     *  Hosts are started through a window of `fanout' slots, each set
+     *   up only when a host is started in it, so no per-host state is
+     *   built for hosts that are still pending.
+     */
+    nhosts = rshcount;
+    nslots = MAX (1, MIN (opt->fanout, rshcount));
+    t = (thd_t *) Malloc(sizeof(thd_t) * nslots);
+    free_slots = (int *) Malloc(sizeof(int) * nslots);
+    nsignal = (int *) Malloc(sizeof(int) * nslots);
+    for (i = 0; i < nslots; i++)
+        free_slots[nfree++] = nslots - 1 - i;
 
-    if (domain_in_label)
+    /*
+     * Require domain names in labels if hosts have 
+     *  different domains
+     */
+    if (_domains_differ (hosts))
         err_no_strip_domain ();
 
+    if (opt->timing_file && _timing_file_open(opt->timing_file) < 0)
+        err("%p: %s: %m\n", opt->timing_file);
+
     /* set timeout values for _wdog() */
     connect_timeout = opt->connect_timeout;
     command_timeout = opt->command_timeout;
 
+    host_buffer_size = opt->host_buffer_size;
+    output_memory_limit = opt->output_memory_limit;
+
     /* start the watchdog thread */
     _dsh_attr_init (&attr_wdog, DSH_THREAD_STACKSIZE);
     rv = pthread_create(&thread_wdog, &attr_wdog, _wdog, (void *) t);
@@ -1149,40 +2098,54 @@ int dsh(opt_t * opt)
 
     /* start all the other threads (at most 'fanout' active at once) */
     for (i = 0; i < rshcount; i++) {
+        thd_t *th;
 
-        /* wait until "room" for another thread */
         dsh_mutex_lock(&threadcount_mutex);
 
-        if (opt->fanout == threadcount)
-            pthread_cond_wait(&threadcount_cond, &threadcount_mutex);
+        /* wait until a slot is free for another thread */
+        if (nfree == 0) {
+            unsigned long long wait = timing_now ();
+            while (nfree == 0)
+                pthread_cond_wait(&threadcount_cond, &threadcount_mutex);
+            trace_span ("dispatch", "fanout wait", wait, timing_now (),
+                        NULL, 0);
+        }
+
+        th = &t[free_slots[--nfree]];
+        _thd_retire (th);
+        next_host = i + 1;
 
         /*
-         *  Advance past any canceled threads
-         */
-        while ((t[i].state == DSH_CANCELED) && (i < rshcount))
-            ++i;
-        /*
-         *  Abort if no more threads
+         *  Hosts that are canceled before starting are retired at once
          */
-        if (i >= rshcount) {
+        if (_thd_init (th, opt, pcp_infiles, hosts, i, statcmd) < 0) {
+            if (output_json)
+                _json_exit (th);
+            if (output_ordered)
+                outorder_done (i);
+            free_slots[nfree++] = th - t;
             dsh_mutex_unlock(&threadcount_mutex);
-            break;
+            continue;
         }
 
         /* create thread */
-        _dsh_attr_init (&t[i].attr, DSH_THREAD_STACKSIZE);
+        timing_mark (th->ts, TIMING_CREATE);
+        if (!timing_t0)
+            timing_t0 = th->ts[TIMING_CREATE];
+        _dsh_attr_init (&th->attr, DSH_THREAD_STACKSIZE);
 #ifdef 	PTHREAD_SCOPE_SYSTEM
         /* we want 1:1 threads if there is a choice */
-        pthread_attr_setscope(&t[i].attr, PTHREAD_SCOPE_SYSTEM);
+        pthread_attr_setscope(&th->attr, PTHREAD_SCOPE_SYSTEM);
 #endif
-        rv = pthread_create(&t[i].thread, &t[i].attr,
+        rv = pthread_create(&th->thread, &th->attr,
                             pdsh_personality() == DSH
-                            ? _rsh_thread : _rcp_thread, (void *) &t[i]);
+                            ? _rsh_thread : _rcp_thread, (void *) th);
         if (rv != 0) {
             if (opt->kill_on_fail)
                 _fwd_signal(SIGTERM);
-            errx("%p: pthread_create %S: %S\n", t[i].host, strerror(rv));
+            errx("%p: pthread_create %S: %S\n", th->host, strerror(rv));
         }
+        pthread_attr_destroy (&th->attr);
         threadcount++;
 
         dsh_mutex_unlock(&threadcount_mutex);
@@ -1192,10 +2155,24 @@ int dsh(opt_t * opt)
     dsh_mutex_lock(&threadcount_mutex);
     while (threadcount > 0)
         pthread_cond_wait(&threadcount_cond, &threadcount_mutex);
+    for (i = 0; i < nslots; i++)
+        _thd_retire (&t[i]);
     dsh_mutex_unlock(&threadcount_mutex);
 
+    if (output_ordered && outorder_fini () < 0)
+        order_failed = 1;
+
+    progress_fini ();
+
+    if (timing_fp && fclose (timing_fp) < 0)
+        err("%p: %s: %m\n", opt->timing_file);
+    timing_fp = NULL;
+
+    if (opt->trace_file && trace_fini () < 0)
+        err("%p: %s: %m\n", opt->trace_file);
+
     if (debug)
-        _dump_debug_stats(rshcount);
+        _dump_debug_stats();
 
     /*
      * Cancel signals thread and unblock SIGINT/SIGTSTP
@@ -1205,25 +2182,29 @@ int dsh(opt_t * opt)
 
     /* if -S, our exit value is the largest of the return codes */
     if (opt->ret_remote_rc) {
-        for (i = 0; t[i].host != NULL; i++) {
-            if (t[i].state == DSH_FAILED)
-                rc = RC_FAILED;
-            if (t[i].rc > rc)
-                rc = t[i].rc;
-        }
+        rc = summary.rc;
+        if (summary.failed && rc < RC_FAILED)
+            rc = RC_FAILED;
     }
 
-    /*
-     *  free hostnames allocated in hostlist_next()
-     *   and buffers allocated when initializing thread array
-     */
-    for (i = 0; t[i].host != NULL; i++) {
-        free(t[i].host);
-        cbuf_destroy (t[i].outbuf);
-        cbuf_destroy (t[i].errbuf);
+    /* output that could not be held in order is an error */
+    if (order_failed && rc == 0)
+        rc = 1;
+
+    for (i = 0; i < nslots; i++) {  /* cleanup */
+        if (t[i].hostbuf)
+            Free((void **) &t[i].hostbuf);
     }
+    Free((void **) &t);
+    Free((void **) &free_slots);
+    Free((void **) &nsignal);
+    hostlist_frozen_destroy(hosts);
+
+    if (statcmd)
+        Free((void **) &statcmd);
 
-    Free((void **) &t);         /* cleanup */
+    if (use_outdir)
+        outdir_fini ();
 
     return rc;
 }
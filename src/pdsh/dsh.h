@@ -40,10 +40,17 @@
 #include "src/pdsh/opt.h"
 #include "src/pdsh/cbuf.h"
 #include "src/pdsh/rcmd.h"
+#include "src/pdsh/outdir.h"
+#include "src/pdsh/timing.h"
 
 #define INTR_TIME		1       /* secs */
 #define WDOG_POLL 		2       /* secs */
 
+/* default output buffering limits (PDSH_HOST_BUFFER_SIZE and
+ *  PDSH_OUTPUT_MEMORY_LIMIT) */
+#define DFLT_HOST_BUFFER_SIZE      (128*1024)
+#define DFLT_OUTPUT_MEMORY_LIMIT   (64*1024*1024)
+
 /* some handy SP constants */
 /* NOTE: degenerate case of one node per frame, nodes would be 1, 17, 33,... */
 #define MAX_SP_NODES 		512
@@ -56,14 +63,17 @@ typedef enum { DSH_NEW, DSH_RCMD, DSH_READING, DSH_DONE,
 typedef struct thd {
     pthread_t thread;
     pthread_attr_t attr;
-    state_t state;              /* thread state */
-    char *host;                 /* host name */
+    int state;                  /* thread state (state_t) */
+    char *host;                 /* host name, NULL if slot is free */
+    char *hostbuf;              /* slot's host name buffer */
+    int hostbuf_size;           /* allocated size of hostbuf */
     char *luser;                /* local username */
     char *ruser;                /* remote username */
     bool resolve_hosts;         /* resolve hosts in thread? */
     time_t start;               /* time stamp for start */
     time_t connect;             /* time stamp for connect */
     time_t finish;              /* time stamp for finish */
+    timing_t ts;                /* monotonic phase timestamps (ns) */
     char *cmd;                  /* command */
 
     bool dsh_sopt;              /* true if -s (sep stderr/out) */
@@ -80,6 +90,10 @@ typedef struct thd {
     char *pcp_progname;         /* program name */
     char *outfile_name;         /* outfile name */
     int rc;                     /* remote return code (-S) */
+    int signal;                 /* signal that killed remote command */
+    bool read_rc;               /* rc is in a trailer on stdout (-S, -k) */
+    char *rc_line;              /* held line that may be the rc trailer */
+    int rc_len;                 /* length of rc_line */
     int nodeid;                 /* node index */
     int nnodes;                 /* number of nodes in job */
     
@@ -87,6 +101,13 @@ typedef struct thd {
 
     cbuf_t outbuf;              /* output buffer */
     cbuf_t errbuf;              /* stderr buffer  */
+    outdir_file_t outfile;      /* stdout file (-o) */
+    outdir_file_t errfile;      /* stderr file (-o) */
+    int buffered;               /* bytes counted against output budget */
+    bool partial[2];            /* line partially written on stream  */
+    int npolls;                 /* poll wakeups, for debug stats */
+    int nreads;                 /* read calls on rcmd fds */
+    long nbytes;                /* bytes read from rcmd fds */
 
     bool labels;                /* display host: labels */
     char addr[IP_ADDR_LEN];     /* IP address */
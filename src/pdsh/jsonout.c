@@ -0,0 +1,321 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <sys/time.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "src/common/xmalloc.h"
+#include "jsonout.h"
+
+/*
+ *  Records are formatted into a buffer on the stack when they fit.
+ */
+#define JSONOUT_BUFSIZE 4096
+
+/*
+ *  Longest possible escaped form of a single byte: \u00XX
+ */
+#define JSON_ESCAPE_MAX 6
+
+struct jbuf {
+    char *data;
+    int len;
+    int size;
+};
+
+static void _jbuf_init (struct jbuf *b, char *stackbuf, int size)
+{
+    b->data = stackbuf;
+    b->len = 0;
+    b->size = size;
+}
+
+/*
+ *  Ensure room for [n] more bytes in [b]. The first time the stack
+ *   buffer is outgrown the data is moved to the heap.
+ */
+static void _jbuf_reserve (struct jbuf *b, char *stackbuf, int n)
+{
+    int size = b->size;
+
+    if (b->len + n <= b->size)
+        return;
+
+    while (size < b->len + n)
+        size *= 2;
+
+    if (b->data == stackbuf) {
+        char *p = Malloc (size);
+        memcpy (p, b->data, b->len);
+        b->data = p;
+    }
+    else
+        Realloc ((void **) &b->data, size);
+    b->size = size;
+}
+
+static void _jbuf_free (struct jbuf *b, char *stackbuf)
+{
+    if (b->data != stackbuf)
+        Free ((void **) &b->data);
+}
+
+/*
+ *  Append a raw string. Caller has reserved space.
+ */
+static void _jbuf_cat (struct jbuf *b, const char *s)
+{
+    int n = strlen (s);
+    memcpy (b->data + b->len, s, n);
+    b->len += n;
+}
+
+/*
+ *  Match the [len] bytes at [s] against the UTF-8 sequence that starts
+ *   with s[0], setting [np] to its length (0 if s[0] cannot start one).
+ *   Returns the number of leading bytes that fit, at most *np. Overlong
+ *   forms, surrogates and code points above U+10FFFF are rejected.
+ */
+static int _utf8_match (const unsigned char *s, int len, int *np)
+{
+    unsigned char lo = 0x80, hi = 0xbf;
+    int i, n;
+
+    if (s[0] >= 0xc2 && s[0] <= 0xdf)
+        n = 2;
+    else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+        n = 3;
+        if (s[0] == 0xe0)
+            lo = 0xa0;
+        else if (s[0] == 0xed)
+            hi = 0x9f;
+    }
+    else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        n = 4;
+        if (s[0] == 0xf0)
+            lo = 0x90;
+        else if (s[0] == 0xf4)
+            hi = 0x8f;
+    }
+    else {
+        *np = 0;
+        return (0);
+    }
+
+    *np = n;
+    if (len < 2 || s[1] < lo || s[1] > hi)
+        return (1);
+    for (i = 2; i < n && i < len; i++) {
+        if (s[i] < 0x80 || s[i] > 0xbf)
+            break;
+    }
+    return (i);
+}
+
+/*
+ *  Return the length of the well-formed UTF-8 sequence at the start of
+ *   the [len] bytes at [s], or 0 if there is none.
+ */
+static int _utf8_seqlen (const unsigned char *s, int len)
+{
+    int n;
+    return (_utf8_match (s, len, &n) == n ? n : 0);
+}
+
+int jsonout_utf8_partial (const char *data, int len)
+{
+    const unsigned char *s = (const unsigned char *) data;
+    int i, n;
+
+    for (i = 1; i <= 3 && i <= len; i++) {
+        if (s[len - i] >= 0x80 && s[len - i] <= 0xbf)
+            continue;
+        if (_utf8_match (s + len - i, i, &n) == i && i < n)
+            return (i);
+        break;
+    }
+    return (0);
+}
+
+/*
+ *  Append [len] bytes of [s] as a quoted JSON string. Caller has
+ *   reserved (len * JSON_ESCAPE_MAX + 2) bytes.
+ *
+ *  Control characters, quote and backslash are escaped. Valid UTF-8
+ *   sequences are copied unmodified; any other byte is replaced by
+ *   U+FFFD so the record is always valid JSON.
+ */
+static void _jbuf_cat_string (struct jbuf *b, const char *s, int len)
+{
+    static const char hex[] = "0123456789abcdef";
+    char *p = b->data + b->len;
+    int i, n;
+
+    *p++ = '"';
+    for (i = 0; i < len; i++) {
+        unsigned char c = s[i];
+
+        if (c >= 0x80) {
+            if ((n = _utf8_seqlen ((const unsigned char *) s + i, len - i))) {
+                memcpy (p, s + i, n);
+                p += n;
+                i += n - 1;
+            }
+            else {
+                memcpy (p, "\\ufffd", 6);
+                p += 6;
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':  *p++ = '\\'; *p++ = '"';  break;
+        case '\\': *p++ = '\\'; *p++ = '\\'; break;
+        case '\n': *p++ = '\\'; *p++ = 'n';  break;
+        case '\r': *p++ = '\\'; *p++ = 'r';  break;
+        case '\t': *p++ = '\\'; *p++ = 't';  break;
+        case '\b': *p++ = '\\'; *p++ = 'b';  break;
+        case '\f': *p++ = '\\'; *p++ = 'f';  break;
+        default:
+            if (c < 0x20 || c == 0x7f) {
+                memcpy (p, "\\u00", 4);
+                p += 4;
+                *p++ = hex[c >> 4];
+                *p++ = hex[c & 0xf];
+            }
+            else
+                *p++ = c;
+        }
+    }
+    *p++ = '"';
+
+    b->len = p - b->data;
+}
+
+/*
+ *  Start a record of [type] for [host], including the current time.
+ */
+static void _record_begin (struct jbuf *b, char *stackbuf,
+                           const char *type, const char *host)
+{
+    struct timeval tv;
+    char tbuf [64];
+    int hlen = strlen (host);
+
+    gettimeofday (&tv, NULL);
+    snprintf (tbuf, sizeof (tbuf), ",\"time\":%ld.%06ld",
+              (long) tv.tv_sec, (long) tv.tv_usec);
+
+    _jbuf_reserve (b, stackbuf, 64 + hlen * JSON_ESCAPE_MAX + sizeof (tbuf));
+    _jbuf_cat (b, "{\"type\":\"");
+    _jbuf_cat (b, type);
+    _jbuf_cat (b, "\",\"host\":");
+    _jbuf_cat_string (b, host, hlen);
+    _jbuf_cat (b, tbuf);
+}
+
+static void _record_end (struct jbuf *b, char *stackbuf)
+{
+    _jbuf_reserve (b, stackbuf, 2);
+    _jbuf_cat (b, "}\n");
+
+    fwrite (b->data, 1, b->len, stdout);
+}
+
+void jsonout_line (const char *host, const char *stream,
+                   const char *data, int len)
+{
+    char stackbuf [JSONOUT_BUFSIZE];
+    struct jbuf b;
+    bool partial = true;
+
+    if (len > 0 && data[len - 1] == '\n') {
+        partial = false;
+        len--;
+    }
+
+    _jbuf_init (&b, stackbuf, sizeof (stackbuf));
+    _record_begin (&b, stackbuf, "output", host);
+
+    _jbuf_reserve (&b, stackbuf, 64 + len * JSON_ESCAPE_MAX);
+    _jbuf_cat (&b, ",\"stream\":\"");
+    _jbuf_cat (&b, stream);
+    _jbuf_cat (&b, "\",\"line\":");
+    _jbuf_cat_string (&b, data, len);
+    if (partial)
+        _jbuf_cat (&b, ",\"partial\":true");
+
+    _record_end (&b, stackbuf);
+    _jbuf_free (&b, stackbuf);
+}
+
+void jsonout_exit (const char *host, const char *status, int rc,
+                   double connect_time, double command_time)
+{
+    char stackbuf [JSONOUT_BUFSIZE];
+    char tmp [256];
+    struct jbuf b;
+
+    _jbuf_init (&b, stackbuf, sizeof (stackbuf));
+    _record_begin (&b, stackbuf, "exit", host);
+
+    snprintf (tmp, sizeof (tmp),
+              ",\"status\":\"%s\",\"rc\":%d,"
+              "\"connect_time\":%.6f,\"command_time\":%.6f",
+              status, rc, connect_time, command_time);
+    _jbuf_reserve (&b, stackbuf, strlen (tmp));
+    _jbuf_cat (&b, tmp);
+
+    _record_end (&b, stackbuf);
+    _jbuf_free (&b, stackbuf);
+}
+
+void jsonout_flush (void)
+{
+    fflush (stdout);
+}
+
+void jsonout_fputs_string (FILE *fp, const char *s)
+{
+    char stackbuf [JSONOUT_BUFSIZE];
+    struct jbuf b;
+    int len = strlen (s);
+
+    _jbuf_init (&b, stackbuf, sizeof (stackbuf));
+    _jbuf_reserve (&b, stackbuf, len * JSON_ESCAPE_MAX + 2);
+    _jbuf_cat_string (&b, s, len);
+    fwrite (b.data, 1, b.len, fp);
+    _jbuf_free (&b, stackbuf);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,105 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _JSONOUT_H
+#define _JSONOUT_H
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include "src/common/macros.h"  /* bool */
+
+/*
+ *  JSON lines output (pdsh -O json).
+ *
+ *  Every line of remote output is written to stdout as a single JSON
+ *   object on its own line:
+ *
+ *   {"type":"output","host":"foo","stream":"stdout","time":T,"line":"..."}
+ *
+ *   where T is the local time the line was received, in seconds since
+ *   the epoch with microsecond precision. The trailing newline is not
+ *   included in "line". Data that did not end in a newline (or was
+ *   split because it was too long) carries an extra "partial":true
+ *   member and continues in the next record for the same host and stream.
+ *
+ *  When a host completes, a final record is written:
+ *
+ *   {"type":"exit","host":"foo","time":T,"status":"done","rc":0,
+ *    "connect_time":C,"command_time":D}
+ *
+ *   status is one of "done", "failed" or "canceled". rc is the exit
+ *   status of the remote command, which is always collected when JSON
+ *   output is selected. C and D are the time in seconds, with
+ *   nanosecond resolution, taken to connect and to run the command.
+ *
+ *  Strings are valid UTF-8: bytes of remote output that are not part
+ *   of a well-formed UTF-8 sequence are replaced by "\ufffd".
+ *
+ *  Each record is written with a single stdio call, so records from
+ *   different hosts are never interleaved.
+ */
+
+/*
+ *  Write an output record for [len] bytes of [data] read from [stream]
+ *   ("stdout" or "stderr") of [host]. A single trailing newline in [data]
+ *   terminates the line, otherwise the record is marked partial.
+ */
+void jsonout_line (const char *host, const char *stream,
+                   const char *data, int len);
+
+/*
+ *  Return the number of bytes at the end of the [len] bytes at [data]
+ *   that start a UTF-8 sequence cut off before its end, or 0. Holding
+ *   them back for the next record of a long line keeps a character split
+ *   across records from being replaced.
+ */
+int jsonout_utf8_partial (const char *data, int len);
+
+/*
+ *  Write the final exit record for [host].
+ */
+void jsonout_exit (const char *host, const char *status, int rc,
+                   double connect_time, double command_time);
+
+/*
+ *  Flush records buffered in stdout.
+ */
+void jsonout_flush (void);
+
+/*
+ *  Write [s] to [fp] as a quoted JSON string, escaped as in records.
+ */
+void jsonout_fputs_string (FILE *fp, const char *s);
+
+#endif /* !_JSONOUT_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
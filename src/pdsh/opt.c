@@ -42,9 +42,14 @@
 #endif
 
 #include <errno.h>
+#include <limits.h>             /* INT_MAX, LONG_MAX */
 
 #include <regex.h>
+#include <fnmatch.h>
 #include <ctype.h>
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "src/common/hostlist.h"
 #include "src/common/err.h"
@@ -67,7 +72,10 @@
 #define OPT_USAGE_DSH "\
 Usage: pdsh [-options] command ...\n\
 -S                return largest of remote command return values\n\
--k                fail fast on connect failure or non-zero return code\n"
+-k                fail fast on connect failure or non-zero return code\n\
+-o dir            write output from each host to a file in dir\n\
+-O format         set output format to text (default) or json\n\
+-B order          group output by host, in host or completion order\n"
 
 /* -s option only useful on AIX */
 #if	HAVE_MAGIC_RSHELL_CLEANUP
@@ -114,9 +122,9 @@ Usage: rpdcp [-options] src [src2...] dir\n\
 /* undocumented "-K" option -  keep domain name in output */
 
 #if	HAVE_MAGIC_RSHELL_CLEANUP
-#define DSH_ARGS	"sSk"
+#define DSH_ARGS	"sSko:O:B:"
 #else
-#define DSH_ARGS    "Sk"
+#define DSH_ARGS    "Sko:O:B:"
 #endif
 #define PCP_ARGS	"pryzZe:"
 #define GEN_ARGS	"hLNKR:M:t:cqf:w:x:l:u:bI:dVT:Q"
@@ -395,6 +403,17 @@ void opt_default(opt_t * opt, char *argv0)
     opt->dshpath = NULL;
     opt->getstat = NULL;
     opt->ret_remote_rc = false;
+    opt->outdir = NULL;
+    opt->outdir_max_open = 0;
+    opt->output_format = OUTPUT_TEXT;
+    opt->host_buffer_size = DFLT_HOST_BUFFER_SIZE;
+    opt->output_memory_limit = DFLT_OUTPUT_MEMORY_LIMIT;
+    opt->output_order = OUTORDER_NONE;
+    opt->order_memory_limit = DFLT_OUTPUT_MEMORY_LIMIT;
+    opt->progress_fd = -1;
+    opt->progress_interval = 1;
+    opt->timing_file = NULL;
+    opt->trace_file = NULL;
     opt->cmd = NULL;
     opt->stdin_unavailable = false;
 #if	HAVE_MAGIC_RSHELL_CLEANUP
@@ -438,6 +457,51 @@ static int string_to_int (const char *val, int *p2int)
     return (0);
 }
 
+/*
+ *  Convert [val], with optional K, M, or G suffix, to a size in bytes.
+ */
+static int string_to_size (const char *val, long *psize)
+{
+    char *p;
+    unsigned long n;
+
+    errno = 0;
+    n = strtoul (val, &p, 10);
+    if (errno || p == val)
+        return (-1);
+
+    /*
+     *  Check each multiplication, since a wrapped result may fall
+     *   back under LONG_MAX.
+     */
+    switch (*p) {
+    case 'G': case 'g':
+        if (n > LONG_MAX / 1024)
+            return (-1);
+        n *= 1024;
+    case 'M': case 'm':
+        if (n > LONG_MAX / 1024)
+            return (-1);
+        n *= 1024;
+    case 'K': case 'k':
+        if (n > LONG_MAX / 1024)
+            return (-1);
+        n *= 1024;
+        p++;
+    case '\0':
+        break;
+    default:
+        return (-1);
+    }
+
+    if (*p != '\0' || n > LONG_MAX)
+        return (-1);
+
+    *psize = (long) n;
+
+    return (0);
+}
+
 /*
  * Override default options with environment variables.
  *	opt (IN/OUT)	option struct	
@@ -458,6 +522,42 @@ void opt_env(opt_t * opt)
         if (string_to_int (rhs, &opt->command_timeout) < 0)
             errx ("%p: Invalid environment variable PDSH_COMMAND_TIMEOUT=%s\n", rhs);
 
+    if ((rhs = getenv("PDSH_OUTDIR_MAX_FILES")) != NULL)
+        if (string_to_int (rhs, &opt->outdir_max_open) < 0)
+            errx ("%p: Invalid environment variable PDSH_OUTDIR_MAX_FILES=%s\n",
+                  rhs);
+
+    if ((rhs = getenv("PDSH_HOST_BUFFER_SIZE")) != NULL)
+        if (string_to_size (rhs, &opt->host_buffer_size) < 0)
+            errx ("%p: Invalid environment variable PDSH_HOST_BUFFER_SIZE=%s\n",
+                  rhs);
+
+    if ((rhs = getenv("PDSH_OUTPUT_MEMORY_LIMIT")) != NULL)
+        if (string_to_size (rhs, &opt->output_memory_limit) < 0)
+            errx ("%p: Invalid environment variable PDSH_OUTPUT_MEMORY_LIMIT=%s\n",
+                  rhs);
+
+    if ((rhs = getenv("PDSH_ORDER_MEMORY_LIMIT")) != NULL)
+        if (string_to_size (rhs, &opt->order_memory_limit) < 0)
+            errx ("%p: Invalid environment variable PDSH_ORDER_MEMORY_LIMIT=%s\n",
+                  rhs);
+
+    if ((rhs = getenv("PDSH_PROGRESS")) != NULL)
+        if (string_to_int (rhs, &opt->progress_fd) < 0 || opt->progress_fd < 0)
+            errx ("%p: Invalid environment variable PDSH_PROGRESS=%s\n", rhs);
+
+    if ((rhs = getenv("PDSH_PROGRESS_INTERVAL")) != NULL)
+        if (string_to_int (rhs, &opt->progress_interval) < 0
+            || opt->progress_interval <= 0)
+            errx ("%p: Invalid environment variable PDSH_PROGRESS_INTERVAL=%s\n",
+                  rhs);
+
+    if ((rhs = getenv("PDSH_TIMING_FILE")) != NULL && *rhs != '\0')
+        opt->timing_file = Strdup(rhs);
+
+    if ((rhs = getenv("PDSH_TRACE_FILE")) != NULL && *rhs != '\0')
+        opt->trace_file = Strdup(rhs);
+
     if ((rhs = getenv("PDSH_RCMD_TYPE")) != NULL)
         opt->rcmd_name = Strdup(rhs);
 
@@ -695,6 +795,34 @@ void opt_args(opt_t * opt, int argc, char *argv[])
         case 'k':
             opt->kill_on_fail = true;
             break;
+        case 'o':              /* per-host output files */
+            if (pdsh_personality() == DSH) {
+                Free ((void **) &opt->outdir);
+                opt->outdir = Strdup(optarg);
+            }
+            else
+                goto test_module_option;
+            break;
+        case 'O':              /* output format */
+            if (pdsh_personality() != DSH)
+                goto test_module_option;
+            if (strcmp (optarg, "text") == 0)
+                opt->output_format = OUTPUT_TEXT;
+            else if (strcmp (optarg, "json") == 0)
+                opt->output_format = OUTPUT_JSON;
+            else
+                errx ("%p: Invalid output format `%s' passed to -O.\n", optarg);
+            break;
+        case 'B':              /* host-ordered output */
+            if (pdsh_personality() != DSH)
+                goto test_module_option;
+            if (strcmp (optarg, "host") == 0)
+                opt->output_order = OUTORDER_HOST;
+            else if (strcmp (optarg, "completion") == 0)
+                opt->output_order = OUTORDER_COMPLETION;
+            else
+                errx ("%p: Invalid output order `%s' passed to -B.\n", optarg);
+            break;
         default: test_module_option:
             if (mod_process_opt(opt, c, optarg) < 0)
                _usage(opt);
@@ -788,16 +916,26 @@ void opt_args(opt_t * opt, int argc, char *argv[])
 static void wcoll_expand (opt_t *opt)
 {
     hostlist_t hl = opt->wcoll;
+    hostlist_iterator_t i;
     char *hosts;
 
     /*
-     *  Create new hostlist for wcoll
+     *  Create new hostlist for wcoll. Walk the old list with an
+     *   iterator rather than shifting from its head, which would
+     *   memmove the range array once per host. Only names which
+     *   still contain a bracket need to be parsed again.
      */
     opt->wcoll = hostlist_create ("");
-    while ((hosts = hostlist_shift (hl))) {
-        hostlist_push (opt->wcoll, hosts);
+    if (!(i = hostlist_iterator_create (hl)))
+        errx ("%p: Out of memory\n");
+    while ((hosts = hostlist_next (i))) {
+        if (strchr (hosts, '['))
+            hostlist_push (opt->wcoll, hosts);
+        else
+            hostlist_push_host (opt->wcoll, hosts);
         free (hosts);
     }
+    hostlist_iterator_destroy (i);
 
     hostlist_destroy (hl);
 }
@@ -850,6 +988,18 @@ bool opt_verify(opt_t * opt)
     if (mod_postop(opt) > 0)
         verified = false;
 
+    if (personality == DSH && opt->outdir
+        && opt->output_format != OUTPUT_TEXT) {
+        err("%p: -o may only be used with text output format\n");
+        verified = false;
+    }
+
+    if (personality == DSH && opt->output_order != OUTORDER_NONE
+        && (opt->outdir || opt->output_format != OUTPUT_TEXT)) {
+        err("%p: -B may only be used with text output to stdout\n");
+        verified = false;
+    }
+
     /* can't prompt for command if stdin was used for wcoll */
     if (personality == DSH && opt->stdin_unavailable && !opt->cmd) {
         _usage(opt);
@@ -872,6 +1022,12 @@ bool opt_verify(opt_t * opt)
             err("%p: command timeout must be >= 0\n");
             verified = false;
         }
+
+        if (opt->host_buffer_size < 1024 || opt->host_buffer_size > INT_MAX) {
+            err("%p: host buffer size must be between 1K and %dM\n",
+                INT_MAX / (1024 * 1024));
+            verified = false;
+        }
     }
 
     /* PCP: must have source and destination filename(s) */
@@ -982,6 +1138,7 @@ bool opt_verify(opt_t * opt)
 void opt_list(opt_t * opt)
 {
     char wcoll_str[1024];
+    char limit_str[64];
     int n;
 
     if (personality == DSH) {
@@ -990,6 +1147,12 @@ void opt_list(opt_t * opt)
             BOOLSTR(opt->separate_stderr));
         out("Path prepended to cmd	%s\n", STRORNULL(opt->dshpath));
         out("Appended to cmd         %s\n", STRORNULL(opt->getstat));
+        out("Output directory	%s\n", STRORNULL(opt->outdir));
+        out("Output format		%s\n",
+            opt->output_format == OUTPUT_JSON ? "json" : "text");
+        out("Output order		%s\n",
+            opt->output_order == OUTORDER_HOST ? "host" :
+            opt->output_order == OUTORDER_COMPLETION ? "completion" : "none");
         out("Command:		%s\n", STRORNULL(opt->cmd));
     } else {
         char infiles [4096];
@@ -1018,6 +1181,9 @@ void opt_list(opt_t * opt)
         out("Connect timeout (secs)	%d\n", opt->connect_timeout);
         out("Command timeout (secs)	%d\n", opt->command_timeout);
         out("Fanout			%d\n", opt->fanout);
+        out("Host buffer size	%d\n", (int) opt->host_buffer_size);
+        snprintf(limit_str, sizeof(limit_str), "%ld", opt->output_memory_limit);
+        out("Output memory limit	%s\n", limit_str);
         out("Display hostname labels	%s\n", BOOLSTR(opt->labels));
         out("Debugging       	%s\n", BOOLSTR(opt->debug));
 
@@ -1055,6 +1221,12 @@ void opt_free(opt_t * opt)
         Free((void **) &pdsh_options);
     if (opt->dshpath)
         Free((void **) &opt->dshpath);
+    if (opt->outdir)
+        Free((void **) &opt->outdir);
+    if (opt->timing_file)
+        Free((void **) &opt->timing_file);
+    if (opt->trace_file)
+        Free((void **) &opt->trace_file);
     if (opt->local_program_path)
         Free((void **) &opt->local_program_path);
     if (opt->remote_program_path)
@@ -1235,8 +1407,13 @@ void free_f (void *x)
     Free (&x);
 }
 
+/*
+ *  A host filter from -w or -x: a regular expression, or a shell
+ *   glob pattern if `glob' is set.
+ */
 struct regex_info {
     int     exclude;
+    int     glob;
     int     cflags;
     int     eflags;
     int     compiled;
@@ -1278,20 +1455,156 @@ struct regex_info * regex_info_create (const char *r, int exclude)
     return (re);
 }
 
+struct regex_info * glob_info_create (const char *pattern, int exclude)
+{
+    struct regex_info *re = Malloc (sizeof (*re));
 
-void hostlist_filter_regex (hostlist_t hl, struct regex_info *re)
+    re->pattern = Strdup (pattern);
+    re->exclude = exclude;
+    re->glob = 1;
+    return (re);
+}
+
+/*
+ *  Hosts per filter thread: smaller wcolls are filtered in the
+ *   calling thread.
+ */
+#define FILTER_HOSTS_PER_THREAD 32768
+#define FILTER_MAX_THREADS      16
+
+struct host_filter {
+    hostlist_t           hl;      /* hosts to filter                      */
+    hostlist_t           result;  /* hosts of hl passing every filter     */
+    struct regex_info ** res;     /* NULL terminated array of filters     */
+    int                  copy;    /* compile a private copy of each regex */
+};
+
+static void * host_filter_run (struct host_filter *f)
 {
-    char *host;
     hostlist_iterator_t i;
+    struct regex_info **re;
+    regex_t *copies = NULL;
+    regex_t **regs;
+    char *host;
+    size_t size = 0;
+    int n, len;
+
+    /*
+     *  regexec(3) may serialize callers sharing a compiled expression,
+     *   so when several threads filter at once each compiles its own copy.
+     *   Otherwise the expressions compiled by regex_info_create() are used.
+     */
+    for (n = 0; f->res[n]; n++) {;}
+    regs = Malloc ((n + 1) * sizeof (regex_t *));
+    if (f->copy)
+        copies = Malloc ((n + 1) * sizeof (regex_t));
+    for (n = 0; f->res[n]; n++) {
+        re = &f->res[n];
+        if ((*re)->glob)
+            continue;
+        if (!f->copy)
+            regs[n] = &(*re)->reg;
+        else if (regcomp (&copies[n], (*re)->pattern, (*re)->cflags))
+            errx ("%p: Failed to compile \"%s\"\n", (*re)->pattern);
+        else
+            regs[n] = &copies[n];
+    }
 
-    i = hostlist_iterator_create (hl);
-    while ((host = hostlist_next (i))) {
-        int rc = regexec (&re->reg, host, 0, NULL, re->eflags);
-        if ((re->exclude && rc == 0) || (!re->exclude && rc == REG_NOMATCH))
-            hostlist_remove (i);
-        free (host);
+    if (!(i = hostlist_iterator_create (f->hl)))
+        errx ("%p: Out of memory\n");
+    while ((len = hostlist_next_r (i, NULL, 0)) > 0) {
+        if (len >= size)
+            size = len + 1;
+    }
+    host = Malloc (size + 1);
+    hostlist_iterator_reset (i);
+
+    f->result = hostlist_create ("");
+    while (hostlist_next_r (i, host, size + 1) > 0) {
+        for (n = 0, re = f->res; *re; n++, re++) {
+            int match = (*re)->glob ?
+                fnmatch ((*re)->pattern, host, 0) == 0 :
+                regexec (regs[n], host, 0, NULL, (*re)->eflags) == 0;
+            if (match == (*re)->exclude)
+                break;
+        }
+        if (*re == NULL)
+            hostlist_push_host (f->result, host);
     }
     hostlist_iterator_destroy (i);
+    Free ((void **) &host);
+
+    if (f->copy) {
+        for (n = 0; f->res[n]; n++) {
+            if (!f->res[n]->glob)
+                regfree (&copies[n]);
+        }
+        Free ((void **) &copies);
+    }
+    Free ((void **) &regs);
+    return (NULL);
+}
+
+static int host_filter_nthreads (hostlist_t hl)
+{
+    int n = hostlist_count (hl) / FILTER_HOSTS_PER_THREAD;
+#ifdef _SC_NPROCESSORS_ONLN
+    long ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+    if (ncpus > 0 && n > ncpus)
+        n = ncpus;
+#endif
+    if (n > FILTER_MAX_THREADS)
+        n = FILTER_MAX_THREADS;
+    return (n > 1 ? n : 1);
+}
+
+/*
+ *  Return a new hostlist holding the hosts of hl, in order, which pass
+ *   every filter in the NULL terminated array res. Hosts are matched in
+ *   a single pass and collected into the result instead of being
+ *   removed from hl one at a time. Large lists are split between
+ *   threads.
+ */
+hostlist_t hostlist_filter_regex (hostlist_t hl, struct regex_info **res)
+{
+    struct host_filter f[FILTER_MAX_THREADS];
+    hostlist_t parts[FILTER_MAX_THREADS];
+    pthread_t tids[FILTER_MAX_THREADS];
+    int j, rc, n = host_filter_nthreads (hl);
+    hostlist_t result;
+
+    if (n == 1) {
+        f[0].hl = hl;
+        f[0].res = res;
+        f[0].copy = 0;
+        host_filter_run (&f[0]);
+        return (f[0].result);
+    }
+
+    if ((n = hostlist_split (hl, n, parts)) < 0)
+        errx ("%p: Failed to split hostlist: %m\n");
+
+    for (j = 0; j < n; j++) {
+        f[j].hl = parts[j];
+        f[j].res = res;
+        f[j].copy = 1;
+        if ((rc = pthread_create (&tids[j], NULL,
+                                  (void *(*)(void *)) host_filter_run,
+                                  &f[j])))
+            errx ("%p: pthread_create: %s\n", strerror (rc));
+    }
+    for (j = 0; j < n; j++)
+        pthread_join (tids[j], NULL);
+
+    result = f[0].result;
+    for (j = 0; j < n; j++) {
+        if (j > 0) {
+            hostlist_push_list (result, f[j].result);
+            hostlist_destroy (f[j].result);
+        }
+        hostlist_destroy (parts[j]);
+    }
+    return (result);
 }
 
 
@@ -1364,6 +1677,13 @@ static int wcoll_arg_process (char *arg, opt_t *opt)
 
         list_push (regex_list, re);
     }
+    else if (strpbrk (p, "*?")) {
+        /*
+         *  Hostnames cannot contain glob characters, so treat the
+         *   argument as a shell pattern on which to filter wcoll.
+         */
+        list_push (regex_list, glob_info_create (p, excluded));
+    }
     else {
         if (excluded) {
             list_push (exclude_list, Strdup (p));
@@ -1399,24 +1719,35 @@ static int wcoll_args_process (opt_t *opt, char * args)
 
 static void wcoll_apply_regex (opt_t *opt, List regexs)
 {
+    struct regex_info **res;
     struct regex_info *re;
     ListIterator i;
+    hostlist_t hl;
+    int n = 0;
 
-    if (!opt->wcoll || !regexs)
+    if (!opt->wcoll || !regexs || list_is_empty (regexs))
         return;
 
     /*
-     *  filter any supplied regular expression args
+     *  filter any supplied regular expression and glob args
      */
+    res = Malloc ((list_count (regexs) + 1) * sizeof (*res));
     i = list_iterator_create (regexs);
     while ((re = list_next (i)))
-        hostlist_filter_regex (opt->wcoll, re);
+        res[n++] = re;
     list_iterator_destroy (i);
+
+    hl = hostlist_filter_regex (opt->wcoll, res);
+    hostlist_destroy (opt->wcoll);
+    opt->wcoll = hl;
+
+    Free ((void **) &res);
 }
 
 static void wcoll_apply_excluded (opt_t *opt, List excludes)
 {
     ListIterator i;
+    hostlist_t hl;
     char *arg;
 
     if (!opt->wcoll || !excludes)
@@ -1425,10 +1756,15 @@ static void wcoll_apply_excluded (opt_t *opt, List excludes)
     /*
      *  filter explicitly excluded hosts:
      */
+    hl = hostlist_create ("");
     i = list_iterator_create (excludes);
     while ((arg = list_next (i)))
-        hostlist_delete (opt->wcoll, arg);
+        hostlist_push (hl, arg);
     list_iterator_destroy (i);
+
+    if (hostlist_subtract (opt->wcoll, hl) < 0)
+        errx ("%p: failed to apply excluded hosts: %m\n");
+    hostlist_destroy (hl);
 }
 
 /*
@@ -36,6 +36,7 @@
 #include "src/common/macros.h"
 #include "src/common/list.h"
 #include "src/common/hostlist.h"
+#include "outorder.h"
 
 #define MAX_GENDATTR	64
 
@@ -46,6 +47,9 @@
 /* set to 0x1 and 0x2 so we can do bitwise operations with DSH and PCP */
 typedef enum { DSH = 0x1, PCP = 0x2} pers_t;
 
+/* output formats for -O */
+typedef enum { OUTPUT_TEXT, OUTPUT_JSON } outfmt_t;
+
 typedef struct {
 
     /* common options */
@@ -79,6 +83,17 @@ typedef struct {
     char *getstat;              /* optional echo $? appended to cmd */
     bool ret_remote_rc;         /* -S: return largest remote return val */
     bool labels;                /* display host: before output */
+    char *outdir;               /* -o: write host output to files in dir */
+    int outdir_max_open;        /* max simultaneously open output files */
+    outfmt_t output_format;     /* -O: text or json */
+    long host_buffer_size;      /* max output buffered per host stream */
+    long output_memory_limit;   /* max output buffered for all hosts */
+    outorder_t output_order;    /* -B: emit host output contiguously */
+    long order_memory_limit;    /* max output held in memory for -B */
+    int progress_fd;            /* live status line fd, or -1 */
+    int progress_interval;      /* secs between status lines */
+    char *timing_file;          /* write per-host phase timings here */
+    char *trace_file;           /* write a trace-event timeline here */
 
     /* PCP-specific options */
     bool preserve;              /* -p */
@@ -0,0 +1,446 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>       /* getrlimit */
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/common/err.h"
+#include "outdir.h"
+
+/*
+ *  Flush a file's buffer once it holds this many bytes ...
+ */
+#define OUTDIR_BUFSIZE          65536
+
+/*
+ *  ... or once its oldest data has been buffered this long (secs).
+ */
+#define OUTDIR_FLUSH_INTERVAL   1
+
+/*
+ *  Lower bound for the number of simultaneously open files.
+ */
+#define OUTDIR_MIN_OPEN         8
+
+struct outdir_file {
+    pthread_mutex_t mutex;          /* protects buffer and write offset    */
+    char *path;                     /* full path to output file            */
+    bool created;                   /* true once the file has been created */
+    off_t offset;                   /* offset of next write                */
+    char *buf;                      /* pending data (allocated on demand)  */
+    int used;                       /* bytes pending in buf                */
+    time_t stamp;                   /* time oldest pending data was queued */
+
+    /*  The following are protected by outdir.lru_mutex:
+     */
+    int fd;                         /* -1 if file is not currently open    */
+    int busy;                       /* nonzero while fd is in use          */
+    struct outdir_file *lru_prev;   /* list of open files, most recent ... */
+    struct outdir_file *lru_next;   /*  ... first                          */
+
+    /*  The following are protected by outdir.files_mutex:
+     */
+    struct outdir_file *prev;       /* list of all files                   */
+    struct outdir_file *next;
+};
+
+static struct {
+    char *dir;
+    int max_open;
+    int nopen;
+    pthread_mutex_t lru_mutex;
+    struct outdir_file *lru_head;
+    struct outdir_file *lru_tail;
+    pthread_mutex_t files_mutex;
+    struct outdir_file *files;
+} outdir = {
+    NULL, 0, 0,
+    PTHREAD_MUTEX_INITIALIZER, NULL, NULL,
+    PTHREAD_MUTEX_INITIALIZER, NULL
+};
+
+#define outdir_mutex_lock(pmutex)                                             \
+ do {                                                                         \
+      if ((errno = pthread_mutex_lock (pmutex)))                              \
+           errx ("%s:%d: mutex_lock: %m", __FILE__, __LINE__);                \
+  } while (0)
+
+#define outdir_mutex_unlock(pmutex)                                           \
+ do {                                                                         \
+      if ((errno = pthread_mutex_unlock (pmutex)))                            \
+           errx ("%s:%d: mutex_unlock: %m", __FILE__, __LINE__);              \
+  } while (0)
+
+
+/*
+ *  Choose a default limit on open files: leave room for two fds
+ *   per active connection plus some slop.
+ */
+static int _default_max_open (int fanout)
+{
+    struct rlimit rlim[1];
+    long n;
+
+    if (getrlimit (RLIMIT_NOFILE, rlim) < 0 || rlim->rlim_cur == RLIM_INFINITY)
+        return (1024);
+
+    n = (long) rlim->rlim_cur - (2 * fanout) - 64;
+
+    return (n < OUTDIR_MIN_OPEN ? OUTDIR_MIN_OPEN : (int) n);
+}
+
+int outdir_init (const char *dir, int max_open, int fanout)
+{
+    struct stat st;
+
+    if (stat (dir, &st) < 0) {
+        if (errno != ENOENT || mkdir (dir, 0755) < 0)
+            return (-1);
+    }
+    else if (!S_ISDIR (st.st_mode)) {
+        errno = ENOTDIR;
+        return (-1);
+    }
+
+    outdir.dir = Strdup (dir);
+    outdir.max_open = max_open > 0 ? max_open : _default_max_open (fanout);
+
+    return (0);
+}
+
+void outdir_fini (void)
+{
+    if (outdir.dir)
+        Free ((void **) &outdir.dir);
+}
+
+static void _lru_unlink (struct outdir_file *f)
+{
+    if (f->lru_prev)
+        f->lru_prev->lru_next = f->lru_next;
+    else
+        outdir.lru_head = f->lru_next;
+
+    if (f->lru_next)
+        f->lru_next->lru_prev = f->lru_prev;
+    else
+        outdir.lru_tail = f->lru_prev;
+
+    f->lru_prev = f->lru_next = NULL;
+}
+
+static void _lru_push (struct outdir_file *f)
+{
+    f->lru_prev = NULL;
+    f->lru_next = outdir.lru_head;
+    if (outdir.lru_head)
+        outdir.lru_head->lru_prev = f;
+    outdir.lru_head = f;
+    if (outdir.lru_tail == NULL)
+        outdir.lru_tail = f;
+}
+
+static void _file_close (struct outdir_file *f)
+{
+    if (f->fd < 0)
+        return;
+    if (close (f->fd) < 0)
+        err ("%p: %s: close: %m\n", f->path);
+    f->fd = -1;
+    _lru_unlink (f);
+    outdir.nopen--;
+}
+
+/*
+ *  Close least recently used files until there is room to open
+ *   another. Files currently being written are skipped, so the limit
+ *   may be briefly exceeded if every open file is in use.
+ *
+ *  Called with lru_mutex held.
+ */
+static void _lru_evict (void)
+{
+    struct outdir_file *f = outdir.lru_tail;
+
+    while (f && outdir.nopen >= outdir.max_open) {
+        struct outdir_file *prev = f->lru_prev;
+        if (!f->busy)
+            _file_close (f);
+        f = prev;
+    }
+}
+
+/*
+ *  Return an open descriptor for [f], opening the file if necessary,
+ *   and mark it busy so it is not closed from under us.
+ *   Release with _file_put().
+ */
+static int _file_get (struct outdir_file *f)
+{
+    int flags = O_WRONLY | O_CREAT;
+
+    outdir_mutex_lock (&outdir.lru_mutex);
+
+    if (f->fd >= 0) {
+        _lru_unlink (f);
+        _lru_push (f);
+    }
+    else {
+        _lru_evict ();
+
+        /*
+         *  Truncate any existing file the first time it is opened,
+         *   but never again, as we will be writing at f->offset.
+         */
+        if (!f->created)
+            flags |= O_TRUNC;
+
+        if ((f->fd = open (f->path, flags, 0644)) < 0) {
+            outdir_mutex_unlock (&outdir.lru_mutex);
+            return (-1);
+        }
+        fcntl (f->fd, F_SETFD, FD_CLOEXEC);
+        f->created = true;
+        _lru_push (f);
+        outdir.nopen++;
+    }
+
+    f->busy++;
+    outdir_mutex_unlock (&outdir.lru_mutex);
+
+    return (f->fd);
+}
+
+static void _file_put (struct outdir_file *f)
+{
+    outdir_mutex_lock (&outdir.lru_mutex);
+    f->busy--;
+    outdir_mutex_unlock (&outdir.lru_mutex);
+}
+
+static int _pwrite_all (int fd, const char *data, size_t len, off_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pwrite (fd, data, len, offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return (-1);
+        }
+        data += n;
+        offset += n;
+        len -= n;
+    }
+    return (0);
+}
+
+/*
+ *  Write [len] bytes of [data] to the file at its current offset.
+ *   Called with f->mutex held.
+ */
+static int _file_write (struct outdir_file *f, const char *data, int len)
+{
+    int fd;
+    int rc;
+
+    if ((fd = _file_get (f)) < 0)
+        return (-1);
+
+    if ((rc = _pwrite_all (fd, data, len, f->offset)) == 0)
+        f->offset += len;
+
+    _file_put (f);
+
+    return (rc);
+}
+
+/*
+ *  Called with f->mutex held. Pending data is discarded on error so a
+ *   failing file cannot grow without bound.
+ */
+static int _file_flush (struct outdir_file *f)
+{
+    int rc;
+
+    if (f->used == 0)
+        return (0);
+
+    rc = _file_write (f, f->buf, f->used);
+    f->used = 0;
+
+    return (rc);
+}
+
+outdir_file_t outdir_file_create (const char *host, const char *suffix)
+{
+    struct outdir_file *f = Malloc (sizeof (*f));
+    char *p;
+    int n;
+
+    assert (outdir.dir != NULL);
+
+    memset (f, 0, sizeof (*f));
+    pthread_mutex_init (&f->mutex, NULL);
+    f->fd = -1;
+
+    xstrcat (&f->path, outdir.dir);
+    xstrcat (&f->path, "/");
+    n = strlen (f->path);
+    xstrcat (&f->path, (char *) host);
+    /*
+     *  Never let a host name escape the output directory
+     */
+    p = f->path + n;
+    while ((p = strchr (p, '/')))
+        *p = '_';
+    if (suffix) {
+        xstrcat (&f->path, ".");
+        xstrcat (&f->path, (char *) suffix);
+    }
+
+    outdir_mutex_lock (&outdir.files_mutex);
+    f->next = outdir.files;
+    if (outdir.files)
+        outdir.files->prev = f;
+    outdir.files = f;
+    outdir_mutex_unlock (&outdir.files_mutex);
+
+    return (f);
+}
+
+int outdir_file_write (outdir_file_t f, const void *data, int len)
+{
+    int rc = 0;
+
+    outdir_mutex_lock (&f->mutex);
+
+    if (f->used + len > OUTDIR_BUFSIZE)
+        rc = _file_flush (f);
+
+    if (rc < 0)
+        ;
+    else if (len >= OUTDIR_BUFSIZE)
+        /*
+         *  Large writes bypass the buffer entirely
+         */
+        rc = _file_write (f, data, len);
+    else {
+        if (f->buf == NULL)
+            f->buf = Malloc (OUTDIR_BUFSIZE);
+        if (f->used == 0)
+            f->stamp = time (NULL);
+        memcpy (f->buf + f->used, data, len);
+        f->used += len;
+
+        if (time (NULL) - f->stamp >= OUTDIR_FLUSH_INTERVAL)
+            rc = _file_flush (f);
+    }
+
+    outdir_mutex_unlock (&f->mutex);
+
+    return (rc < 0 ? -1 : len);
+}
+
+int outdir_file_flush (outdir_file_t f)
+{
+    int rc;
+
+    outdir_mutex_lock (&f->mutex);
+    rc = _file_flush (f);
+    outdir_mutex_unlock (&f->mutex);
+
+    return (rc);
+}
+
+void outdir_file_destroy (outdir_file_t f)
+{
+    if (f == NULL)
+        return;
+
+    outdir_mutex_lock (&outdir.files_mutex);
+    if (f->prev)
+        f->prev->next = f->next;
+    else
+        outdir.files = f->next;
+    if (f->next)
+        f->next->prev = f->prev;
+    outdir_mutex_unlock (&outdir.files_mutex);
+
+    if (outdir_file_flush (f) < 0)
+        err ("%p: %s: write: %m\n", f->path);
+
+    outdir_mutex_lock (&outdir.lru_mutex);
+    _file_close (f);
+    outdir_mutex_unlock (&outdir.lru_mutex);
+
+    pthread_mutex_destroy (&f->mutex);
+    if (f->buf)
+        Free ((void **) &f->buf);
+    Free ((void **) &f->path);
+    Free ((void **) &f);
+}
+
+void outdir_flush_expired (void)
+{
+    struct outdir_file *f;
+    time_t now = time (NULL);
+
+    outdir_mutex_lock (&outdir.files_mutex);
+    for (f = outdir.files; f != NULL; f = f->next) {
+        outdir_mutex_lock (&f->mutex);
+        if (f->used && (now - f->stamp >= OUTDIR_FLUSH_INTERVAL)) {
+            if (_file_flush (f) < 0)
+                err ("%p: %s: write: %m\n", f->path);
+        }
+        outdir_mutex_unlock (&f->mutex);
+    }
+    outdir_mutex_unlock (&outdir.files_mutex);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,99 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _OUTDIR_H
+#define _OUTDIR_H
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+/*
+ *  Per-host output files (pdsh -o DIR).
+ *
+ *  Each host's stdout is written to DIR/host and its stderr to
+ *   DIR/host.err. Output is collected in a per-file buffer and written
+ *   with pwrite(2) at the file's current offset once the buffer fills
+ *   or its oldest data is older than the flush interval, so files may
+ *   be closed and reopened at will. The number of files held open at
+ *   once is capped, and the least recently used file is closed when
+ *   another must be opened.
+ *
+ *  A file is not created until its first flush, so hosts that produce
+ *   no output on a stream get no file for it.
+ */
+
+typedef struct outdir_file * outdir_file_t;
+
+/*
+ *  Initialize the output directory [dir], creating it if it does
+ *   not exist. At most [max_open] files will be held open at once
+ *   (0 picks a limit based on RLIMIT_NOFILE and [fanout]).
+ *
+ *  Returns 0 on success, -1 with errno set on failure.
+ */
+int outdir_init (const char *dir, int max_open, int fanout);
+
+/*
+ *  Free output directory state. All files must have been destroyed
+ *   with outdir_file_destroy() first.
+ */
+void outdir_fini (void);
+
+/*
+ *  Create a buffered writer for [host]. If [suffix] is non-NULL it is
+ *   appended to the filename, e.g. "host.err".
+ */
+outdir_file_t outdir_file_create (const char *host, const char *suffix);
+
+/*
+ *  Append [len] bytes of [data] to file [f].
+ *   Returns [len] on success, -1 with errno set on failure.
+ */
+int outdir_file_write (outdir_file_t f, const void *data, int len);
+
+/*
+ *  Write any buffered data for [f] to disk.
+ *   Returns 0 on success, -1 with errno set on failure.
+ */
+int outdir_file_flush (outdir_file_t f);
+
+/*
+ *  Flush [f], close its descriptor if open and free it.
+ */
+void outdir_file_destroy (outdir_file_t f);
+
+/*
+ *  Flush all files holding data older than the flush interval.
+ *   Called periodically so idle hosts do not sit on buffered output.
+ */
+void outdir_flush_expired (void);
+
+#endif /* !_OUTDIR_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
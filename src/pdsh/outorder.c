@@ -0,0 +1,382 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "src/common/err.h"
+#include "outorder.h"
+
+/*
+ *  Stored output is a sequence of records, each a header followed by
+ *   [len] bytes of data, so stdout and stderr from a host are written
+ *   out in the order they arrived.
+ */
+struct record {
+    int stream;
+    int len;
+};
+
+/*
+ *  A run of whole records moved to the spill file.
+ */
+struct extent {
+    off_t offset;
+    long len;
+};
+
+struct host_store {
+    char *buf;                      /* stored records in memory            */
+    int used;                       /* bytes used in buf                   */
+    int size;                       /* bytes allocated for buf             */
+    struct extent *ext;             /* older records in the spill file     */
+    int next;                       /* extents used                        */
+    int maxext;                     /* extents allocated                   */
+    bool done;                      /* host has completed                  */
+};
+
+/*
+ *  All hosts spill into a single temporary file, so the number of open
+ *   files does not grow with the number of hosts holding output.
+ */
+static struct {
+    pthread_mutex_t mutex;          /* protects all of the below           */
+    outorder_t order;
+    long memory_limit;              /* max bytes stored in memory, or 0    */
+    long buffered;                  /* bytes stored in memory              */
+    FILE *spill;                    /* shared spill file, once created     */
+    off_t spill_end;                /* end of data in the spill file       */
+    long spilled;                   /* bytes of stored output in the file  */
+    bool failed;                    /* output not held or not written      */
+    int nhosts;
+    int next;                       /* host whose turn it is (host order)  */
+    struct host_store *hosts;
+} outorder = { PTHREAD_MUTEX_INITIALIZER, OUTORDER_NONE, 0, 0, NULL, 0, 0,
+               false, 0, 0, NULL };
+
+
+static void _stream_write (int stream, const char *data, int len)
+{
+    fwrite (data, 1, len, stream == 0 ? stdout : stderr);
+}
+
+static void _store_append (struct host_store *h, const void *data, int len)
+{
+    if (h->used + len > h->size) {
+        h->size = MAX (h->size * 2, h->used + len);
+        h->size = MAX (h->size, 4096);
+        if (h->buf)
+            Realloc ((void **) &h->buf, h->size);
+        else
+            h->buf = Malloc (h->size);
+    }
+    memcpy (h->buf + h->used, data, len);
+    h->used += len;
+    outorder.buffered += len;
+}
+
+static int _write_at (int fd, const char *buf, int len, off_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pwrite (fd, buf, len, offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return (-1);
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return (0);
+}
+
+static void _extent_append (struct host_store *h, off_t offset, long len)
+{
+    struct extent *e = h->next ? &h->ext[h->next - 1] : NULL;
+
+    if (e && e->offset + e->len == offset) {
+        e->len += len;
+        return;
+    }
+    if (h->next == h->maxext) {
+        h->maxext = MAX (h->maxext * 2, 8);
+        if (h->ext)
+            Realloc ((void **) &h->ext, h->maxext * sizeof (*h->ext));
+        else
+            h->ext = Malloc (h->maxext * sizeof (*h->ext));
+    }
+    h->ext[h->next].offset = offset;
+    h->ext[h->next].len = len;
+    h->next++;
+}
+
+/*
+ *  Move the in-memory output of [h] to the end of the spill file.
+ */
+static int _store_spill (struct host_store *h)
+{
+    if (!outorder.spill && !(outorder.spill = tmpfile ())) {
+        err ("%p: unable to create temporary file for output: %m\n");
+        return (-1);
+    }
+    if (_write_at (fileno (outorder.spill), h->buf, h->used,
+                   outorder.spill_end) < 0) {
+        err ("%p: writing ordered output to temporary file: %m\n");
+        return (-1);
+    }
+    _extent_append (h, outorder.spill_end, h->used);
+    outorder.spill_end += h->used;
+    outorder.spilled += h->used;
+    outorder.buffered -= h->used;
+    Free ((void **) &h->buf);
+    h->used = h->size = 0;
+    return (0);
+}
+
+static void _emit_records (const char *p, int len)
+{
+    const char *end = p + len;
+
+    while (p < end) {
+        struct record r;
+        memcpy (&r, p, sizeof (r));
+        p += sizeof (r);
+        _stream_write (r.stream, p, r.len);
+        p += r.len;
+    }
+}
+
+static int _read_at (int fd, void *buf, int len, off_t offset)
+{
+    ssize_t n;
+
+    while ((n = pread (fd, buf, len, offset)) < 0 && errno == EINTR)
+        ;
+    if (n == 0)
+        errno = EIO;            /* spill file is shorter than recorded */
+    return (n > 0 ? n : -1);
+}
+
+static int _emit_extent (struct extent *e)
+{
+    int fd = fileno (outorder.spill);
+    off_t offset = e->offset;
+    off_t end = e->offset + e->len;
+    struct record r;
+    char buf[8192];
+    int n;
+
+    while (offset < end) {
+        if (_read_at (fd, &r, sizeof (r), offset) != sizeof (r))
+            return (-1);
+        offset += sizeof (r);
+        while (r.len > 0) {
+            if ((n = _read_at (fd, buf, MIN (r.len, sizeof (buf)), offset)) < 0)
+                return (-1);
+            _stream_write (r.stream, buf, n);
+            offset += n;
+            r.len -= n;
+        }
+    }
+    return (0);
+}
+
+/*
+ *  Write out and free all output stored for [h].
+ */
+static void _store_emit (struct host_store *h)
+{
+    int i;
+
+    for (i = 0; i < h->next; i++) {
+        if (!outorder.failed && _emit_extent (&h->ext[i]) < 0) {
+            err ("%p: reading ordered output from temporary file: %m\n");
+            outorder.failed = true;
+        }
+        outorder.spilled -= h->ext[i].len;
+    }
+    Free ((void **) &h->ext);
+    h->next = h->maxext = 0;
+
+    /*
+     *  Reuse the spill file from the start once it holds nothing
+     */
+    if (outorder.spill && outorder.spilled == 0 && outorder.spill_end) {
+        if (ftruncate (fileno (outorder.spill), 0) == 0)
+            outorder.spill_end = 0;
+    }
+
+    if (h->used) {
+        _emit_records (h->buf, h->used);
+        outorder.buffered -= h->used;
+    }
+    Free ((void **) &h->buf);
+    h->used = h->size = 0;
+    fflush (stdout);
+    fflush (stderr);
+}
+
+/*
+ *  While over the memory limit, move the largest in-memory store to disk.
+ *   If output cannot be moved to disk, write the largest store out of
+ *   order instead, so the limit still holds and no output is lost.
+ */
+static void _enforce_memory_limit (void)
+{
+    while (outorder.memory_limit
+           && outorder.buffered > outorder.memory_limit) {
+        struct host_store *largest = NULL;
+        int i;
+
+        for (i = 0; i < outorder.nhosts; i++) {
+            struct host_store *h = &outorder.hosts[i];
+            if (!largest || h->used > largest->used)
+                largest = h;
+        }
+        if (!largest || largest->used == 0)
+            break;
+        if (outorder.failed || _store_spill (largest) < 0) {
+            if (!outorder.failed)
+                err ("%p: writing held output out of order\n");
+            outorder.failed = true;
+            _store_emit (largest);
+        }
+    }
+}
+
+/*
+ *  Move to the next host in target order whose output may be written
+ *   directly, writing out the stored output of each host passed over.
+ */
+static void _advance (void)
+{
+    while (outorder.next < outorder.nhosts) {
+        struct host_store *h = &outorder.hosts[outorder.next];
+        _store_emit (h);
+        if (!h->done)
+            break;
+        outorder.next++;
+    }
+}
+
+void outorder_init (int nhosts, outorder_t order, long memory_limit)
+{
+    assert (order != OUTORDER_NONE);
+
+    outorder.order = order;
+    outorder.memory_limit = memory_limit;
+    outorder.buffered = 0;
+    outorder.spill = NULL;
+    outorder.spill_end = 0;
+    outorder.spilled = 0;
+    outorder.failed = false;
+    outorder.nhosts = nhosts;
+    outorder.next = 0;
+    outorder.hosts = Malloc (nhosts * sizeof (struct host_store));
+}
+
+void outorder_write (int host, int stream, const char *label,
+                     const char *data, int len)
+{
+    struct host_store *h;
+    struct record r;
+
+    assert (host >= 0 && host < outorder.nhosts);
+
+    pthread_mutex_lock (&outorder.mutex);
+
+    h = &outorder.hosts[host];
+    if (outorder.order == OUTORDER_HOST && host == outorder.next) {
+        if (label)
+            _stream_write (stream, label, strlen (label));
+        _stream_write (stream, data, len);
+        fflush (stream == 0 ? stdout : stderr);
+    }
+    else {
+        r.stream = stream;
+        r.len = (label ? strlen (label) : 0) + len;
+        _store_append (h, &r, sizeof (r));
+        if (label)
+            _store_append (h, label, strlen (label));
+        _store_append (h, data, len);
+        _enforce_memory_limit ();
+    }
+
+    pthread_mutex_unlock (&outorder.mutex);
+}
+
+void outorder_done (int host)
+{
+    assert (host >= 0 && host < outorder.nhosts);
+
+    pthread_mutex_lock (&outorder.mutex);
+
+    outorder.hosts[host].done = true;
+    if (outorder.order == OUTORDER_COMPLETION)
+        _store_emit (&outorder.hosts[host]);
+    else if (host == outorder.next)
+        _advance ();
+
+    pthread_mutex_unlock (&outorder.mutex);
+}
+
+int outorder_fini (void)
+{
+    int i;
+    int rc;
+
+    pthread_mutex_lock (&outorder.mutex);
+    for (i = 0; i < outorder.nhosts; i++)
+        _store_emit (&outorder.hosts[i]);
+    Free ((void **) &outorder.hosts);
+    outorder.nhosts = 0;
+    if (outorder.spill)
+        fclose (outorder.spill);
+    outorder.spill = NULL;
+    rc = outorder.failed ? -1 : 0;
+    pthread_mutex_unlock (&outorder.mutex);
+
+    return (rc);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,89 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _OUTORDER_H
+#define _OUTORDER_H
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+/*
+ *  Host-ordered output (pdsh -B).
+ *
+ *  Output from each host is written out contiguously instead of being
+ *   interleaved line by line with other hosts. In host order, hosts are
+ *   emitted in the order of the target list: the first host not yet
+ *   complete streams its output directly, and output from later hosts
+ *   is stored until every host before them has completed. In completion
+ *   order, each host's output is stored and written out when the host
+ *   completes.
+ *
+ *  Stored output is kept in memory until the total exceeds a limit,
+ *   after which the largest stores are moved to a temporary file shared
+ *   by all hosts. If that fails, the largest stores are written out of
+ *   order instead, so the limit holds and no output is lost.
+ */
+
+typedef enum {
+    OUTORDER_NONE,                  /* output is not reordered           */
+    OUTORDER_HOST,                  /* emit hosts in target list order   */
+    OUTORDER_COMPLETION             /* emit hosts as they complete       */
+} outorder_t;
+
+/*
+ *  Initialize ordered output for [nhosts] hosts, numbered 0 to
+ *   nhosts - 1 in target list order. Stored output beyond
+ *   [memory_limit] bytes is moved to a temporary file (0 for no limit).
+ */
+void outorder_init (int nhosts, outorder_t order, long memory_limit);
+
+/*
+ *  Write output [data] of [len] bytes from [stream] (0 for stdout,
+ *   1 for stderr) of host [host], preceded by [label] if non-NULL.
+ *   The output is written immediately if it is this host's turn,
+ *   otherwise it is stored.
+ */
+void outorder_write (int host, int stream, const char *label,
+                     const char *data, int len);
+
+/*
+ *  Mark [host] complete, writing out any output now due.
+ */
+void outorder_done (int host);
+
+/*
+ *  Write out all remaining stored output in host order and free
+ *   ordered output state. Returns -1 if any output was written out of
+ *   order or lost because the temporary file could not be used.
+ */
+int outorder_fini (void);
+
+#endif /* !_OUTORDER_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -85,6 +85,9 @@
 #include "src/common/xmalloc.h"
 #include "pcp_client.h"
 #include "wcoll.h"
+#include "progress.h"
+#include "timing.h"
+#include "trace.h"
 
 #ifndef MAXPATHNAMELEN
 #define MAXPATHNAMELEN MAXPATHLEN
@@ -191,6 +194,7 @@ static int _pcp_write(int fd, char *buf, int size)
         }
         towrite -= outbytes;
         bufp += outbytes;
+        progress_add_bytes (PROGRESS_PCP, outbytes);
     }
     return size;
 }
@@ -344,6 +348,8 @@ int pcp_sendfile(struct pcp_client *pcp, char *file, char *output_file)
         goto fail;
 
     if (S_ISREG(sb.st_mode)) {
+        unsigned long long start = timing_now ();
+
         /* 5: SEND data */
         if (_pcp_send_file_data(pcp->outfd, file, pcp->host) < 0)
             goto fail;
@@ -355,6 +361,9 @@ int pcp_sendfile(struct pcp_client *pcp, char *file, char *output_file)
         /* 7: RECV response code */
         if (pcp_response(pcp->infd, pcp->host) < 0)
             goto fail;
+
+        trace_span_copy ("pdcp", file, start, timing_now (),
+                         "bytes", (long) sb.st_size);
     }
 
     result = 1;                 /* indicate success */
@@ -97,6 +97,9 @@ char rcsid[] = "$Id$";
 #include "src/common/err.h"
 #include "pcp_server.h"
 #include "opt.h"
+#include "progress.h"
+#include "timing.h"
+#include "trace.h"
 
 #ifndef roundup
 #  define roundup(x, y) ((((x) + ((y) - 1)) / (y)) * (y))
@@ -223,6 +226,7 @@ _sink(struct pcp_server *svr, char *targ, BUF *bufp) {
     int amt, count, exists, mask, mode;
     int ofd, setimes, targisdir, cursize = 0;
     char *np, *buf = NULL, *namebuf = NULL;
+    unsigned long long start;
 
 #define	atime	tv[0]
 #define	mtime	tv[1]
@@ -394,6 +398,7 @@ bad:
         cp = bp->buf;
         count = 0;
         wrerr = NO;
+        start = timing_now ();
         for (i = 0; i < size; i += BUFSIZ) {
             amt = BUFSIZ;
             if (i + amt > size)
@@ -407,6 +412,7 @@ bad:
                 }
                 amt -= j;
                 cp += j;
+                progress_add_bytes (PROGRESS_PCP, j);
             } while (amt > 0);
             if (count == bp->cnt) {
                 if (wrerr == NO && write(ofd, bp->buf, count) != count)
@@ -422,6 +428,7 @@ bad:
             wrerr = DISPLAYED;
         }
         (void)close(ofd);
+        trace_span_copy ("pdcp", np, start, timing_now (), "bytes", (long) size);
         if (_response(svr) < 0)
             goto end_server;
         if (setimes && wrerr == NO) {
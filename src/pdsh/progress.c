@@ -0,0 +1,251 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "src/common/macros.h"
+#include "src/common/fd.h"
+#include "src/common/xatomic.h"
+#include "src/common/hist.h"
+#include "dsh.h"
+#include "opt.h"
+#include "progress.h"
+#include "timing.h"
+
+#define NSTATES         (DSH_CANCELED + 1)
+
+static struct {
+    int enabled;
+    int fd;
+    int interval;
+    int tty;
+    int nhosts;
+    unsigned long long start;
+
+    long nstate[NSTATES];           /* hosts currently in each state_t     */
+    long nconnects;                 /* hosts that have connected           */
+    long nbytes[PROGRESS_NBYTES];
+    hist_t connect;
+    hist_t command;
+
+    /* values at the previous report, for rates */
+    unsigned long long last;
+    long last_connects;
+    long last_bytes[PROGRESS_NBYTES];
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int done;
+} progress = { 0, -1 };
+
+static char * _fmt_rate (char *buf, size_t len, double bytes_per_sec)
+{
+    const char *unit[] = { "B", "KB", "MB", "GB", "TB" };
+    int i = 0;
+
+    while (bytes_per_sec >= 1024.0 && i < 4) {
+        bytes_per_sec /= 1024.0;
+        i++;
+    }
+    snprintf (buf, len, "%.1f %s/s", bytes_per_sec, unit[i]);
+    return (buf);
+}
+
+static long _nstate (state_t state)
+{
+    return (xatomic_load (&progress.nstate[state]));
+}
+
+/*
+ *  Write one status line. With `final' the rates are averaged over
+ *   the whole run and the line is always terminated with a newline.
+ */
+static void _report (int final)
+{
+    char line[512];
+    char out[32], pcp[32];
+    char c50[16], c99[16], r50[16], r99[16];
+    unsigned long long now = timing_now ();
+    unsigned long long since = final ? progress.start : progress.last;
+    double secs = (now - since) / 1000000000.0;
+    long nbytes[PROGRESS_NBYTES];
+    long nconnects = xatomic_load (&progress.nconnects);
+    long canceled = _nstate (DSH_CANCELED);
+    double rate[PROGRESS_NBYTES];
+    int i, n;
+
+    if (secs <= 0.0)
+        secs = 1e-6;
+
+    for (i = 0; i < PROGRESS_NBYTES; i++) {
+        nbytes[i] = xatomic_load (&progress.nbytes[i]);
+        rate[i] = (nbytes[i] - (final ? 0 : progress.last_bytes[i])) / secs;
+        progress.last_bytes[i] = nbytes[i];
+    }
+
+    n = snprintf (line, sizeof (line),
+                  "%s%s: %ld/%d done, %ld failed",
+                  progress.tty ? "\r" : "",
+                  pdsh_personality () == DSH ? "pdsh" : "pdcp",
+                  _nstate (DSH_DONE), progress.nhosts, _nstate (DSH_FAILED));
+    if (canceled)
+        n += snprintf (line + n, sizeof (line) - n, ", %ld canceled", canceled);
+    n += snprintf (line + n, sizeof (line) - n,
+                   " | %ld pending, %ld connecting, %ld running"
+                   " | out %s, pcp %s | %.1f conn/s"
+                   " | connect p50 %s p99 %s | command p50 %s p99 %s%s%s",
+                   _nstate (DSH_NEW), _nstate (DSH_RCMD),
+                   _nstate (DSH_READING),
+                   _fmt_rate (out, sizeof (out), rate[PROGRESS_OUTPUT]),
+                   _fmt_rate (pcp, sizeof (pcp), rate[PROGRESS_PCP]),
+                   (nconnects - (final ? 0 : progress.last_connects)) / secs,
+                   timing_fmt (c50, sizeof (c50),
+                               hist_percentile (progress.connect, 50)),
+                   timing_fmt (c99, sizeof (c99),
+                               hist_percentile (progress.connect, 99)),
+                   timing_fmt (r50, sizeof (r50),
+                               hist_percentile (progress.command, 50)),
+                   timing_fmt (r99, sizeof (r99),
+                               hist_percentile (progress.command, 99)),
+                   progress.tty ? "\033[K" : "",
+                   (final || !progress.tty) ? "\n" : "");
+
+    progress.last = now;
+    progress.last_connects = nconnects;
+
+    fd_write_n (progress.fd, line, MIN (n, (int) sizeof (line) - 1));
+}
+
+static void * _progress_thread (void *arg)
+{
+    struct timeval tv;
+    struct timespec ts;
+
+    pthread_mutex_lock (&progress.mutex);
+    while (!progress.done) {
+        gettimeofday (&tv, NULL);
+        ts.tv_sec = tv.tv_sec + progress.interval;
+        ts.tv_nsec = tv.tv_usec * 1000;
+        if (pthread_cond_timedwait (&progress.cond, &progress.mutex, &ts)
+            == ETIMEDOUT && !progress.done)
+            _report (0);
+    }
+    pthread_mutex_unlock (&progress.mutex);
+    return (NULL);
+}
+
+int progress_init (int fd, int interval, int nhosts)
+{
+    int i;
+
+    if (fcntl (fd, F_GETFL) < 0)
+        return (-1);
+
+    progress.fd = fd;
+    progress.interval = interval > 0 ? interval : 1;
+    progress.tty = isatty (fd);
+    progress.nhosts = nhosts;
+    progress.start = progress.last = timing_now ();
+    for (i = 0; i < NSTATES; i++)
+        progress.nstate[i] = 0;
+    progress.nstate[DSH_NEW] = nhosts;
+    progress.done = 0;
+    progress.connect = hist_create ();
+    progress.command = hist_create ();
+
+    pthread_mutex_init (&progress.mutex, NULL);
+    pthread_cond_init (&progress.cond, NULL);
+    if ((errno = pthread_create (&progress.thread, NULL,
+                                 _progress_thread, NULL)))
+        return (-1);
+
+    progress.enabled = 1;
+    return (0);
+}
+
+void progress_fini (void)
+{
+    if (!progress.enabled)
+        return;
+
+    pthread_mutex_lock (&progress.mutex);
+    progress.done = 1;
+    pthread_cond_signal (&progress.cond);
+    pthread_mutex_unlock (&progress.mutex);
+    pthread_join (progress.thread, NULL);
+
+    _report (1);
+    progress.enabled = 0;
+
+    hist_destroy (progress.connect);
+    hist_destroy (progress.command);
+}
+
+void progress_state (int old, int new)
+{
+    if (!progress.enabled || old == new)
+        return;
+    xatomic_add (&progress.nstate[old], -1);
+    xatomic_add (&progress.nstate[new], 1);
+    if (new == DSH_READING)
+        xatomic_add (&progress.nconnects, 1);
+}
+
+void progress_add_bytes (progress_bytes_t type, long n)
+{
+    if (progress.enabled && n > 0)
+        xatomic_add (&progress.nbytes[type], n);
+}
+
+void progress_connect_time (unsigned long long ns)
+{
+    if (progress.enabled)
+        hist_add (progress.connect, ns);
+}
+
+void progress_command_time (unsigned long long ns)
+{
+    if (progress.enabled)
+        hist_add (progress.command, ns);
+}
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
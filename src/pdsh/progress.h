@@ -0,0 +1,86 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _PROGRESS_H
+#define _PROGRESS_H
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+/*
+ *  Live progress display (PDSH_PROGRESS).
+ *
+ *  A reporting thread writes a one line summary of the run to a file
+ *   descriptor at a fixed interval: hosts pending, connecting, running,
+ *   done and failed, output and pdcp data rates, connect rate, and
+ *   p50/p99 connect and command times. Worker threads only update
+ *   atomic counters and histogram buckets, so the reporter never has to
+ *   lock or scan the thread array.
+ *
+ *  All functions except progress_init() are no-ops when the display
+ *   is not enabled.
+ */
+
+typedef enum {
+    PROGRESS_OUTPUT,            /* bytes of remote stdout/stderr read   */
+    PROGRESS_PCP,               /* bytes of file data copied by pdcp    */
+    PROGRESS_NBYTES
+} progress_bytes_t;
+
+/*
+ *  Start the reporting thread, writing to `fd' every `interval' seconds
+ *   for a run of `nhosts' hosts, all initially in state DSH_NEW.
+ *   Returns -1 with errno set if `fd' is not open.
+ */
+int progress_init (int fd, int interval, int nhosts);
+
+/*
+ *  Stop the reporting thread and write a final summary line.
+ */
+void progress_fini (void);
+
+/*
+ *  Record a host moving from state `old' to state `new' (state_t).
+ */
+void progress_state (int old, int new);
+
+/*
+ *  Account `n' bytes of type `type'.
+ */
+void progress_add_bytes (progress_bytes_t type, long n);
+
+/*
+ *  Record a completed connect or command taking `ns' nanoseconds.
+ */
+void progress_connect_time (unsigned long long ns);
+void progress_command_time (unsigned long long ns);
+
+#endif /* !_PROGRESS_H */
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
@@ -67,7 +67,19 @@ struct node_rcmd_info {
     struct rcmd_module *rmod;
 };
 
-static List host_info_list = NULL;
+/*
+ *  Per-host rcmd settings, in an open addressed hash table keyed on
+ *   hostname so that registration and lookup are constant time per host
+ *   even when a module such as genders registers every host in a large
+ *   wcoll.
+ */
+struct host_info_table {
+    struct node_rcmd_info **tab;    /* NULL if slot is empty            */
+    int size;                       /* table size, a power of two       */
+    int count;                      /* number of hosts in table         */
+};
+
+static struct host_info_table *host_info = NULL;
 static List rcmd_module_list = NULL;
 
 static struct rcmd_module *default_rcmd_module = NULL;
@@ -130,6 +142,7 @@ struct rcmd_module * rcmd_module_create (mod_t mod)
     rmod->rcmd_destroy = (RcmdDestroyF) mod_get_rcmd_destroy (mod);
 
     rmod->options.resolve_hosts = 1;
+    rmod->options.exit_status = 0;
 
     return (rmod);
 
@@ -148,17 +161,77 @@ static int find_rcmd_module (struct rcmd_module *x, char *name)
     return (strcmp (x->name, name) == 0);
 }
 
-static int find_host (struct node_rcmd_info *x, char *hostname)
+static unsigned long host_info_hash (const char *host)
+{
+    unsigned long h = 2166136261UL;
+    while (*host)
+        h = (h ^ (unsigned char) *host++) * 16777619UL;
+    return (h);
+}
+
+static struct host_info_table * host_info_table_create (void)
 {
-    return (strcmp (x->hostname, hostname) == 0);
+    struct host_info_table *t = Malloc (sizeof (*t));
+
+    t->size = 256;
+    t->count = 0;
+    t->tab = Malloc (t->size * sizeof (struct node_rcmd_info *));
+
+    return (t);
+}
+
+static void host_info_table_destroy (struct host_info_table *t)
+{
+    int i;
+
+    if (t == NULL)
+        return;
+
+    for (i = 0; i < t->size; i++)
+        node_rcmd_info_destroy (t->tab[i]);
+    Free ((void **) &t->tab);
+    Free ((void **) &t);
+}
+
+/*
+ *  Return the slot holding host, or the empty slot where it belongs.
+ */
+static struct node_rcmd_info ** 
+host_info_slot (struct host_info_table *t, const char *host)
+{
+    unsigned long h = host_info_hash (host);
+    struct node_rcmd_info **np;
+
+    for (;; h++) {
+        np = &t->tab[h & (t->size - 1)];
+        if (*np == NULL || strcmp ((*np)->hostname, host) == 0)
+            return (np);
+    }
+}
+
+static void host_info_table_grow (struct host_info_table *t)
+{
+    struct node_rcmd_info **old = t->tab;
+    int oldsize = t->size;
+    int i;
+
+    t->size = oldsize * 2;
+    t->tab = Malloc (t->size * sizeof (struct node_rcmd_info *));
+
+    for (i = 0; i < oldsize; i++) {
+        if (old[i])
+            *host_info_slot (t, old[i]->hostname) = old[i];
+    }
+
+    Free ((void **) &old);
 }
 
 static struct node_rcmd_info * host_rcmd_info (char *host)
 {
-    if (host_info_list == NULL)
+    if (host_info == NULL)
         return (NULL);
 
-    return (list_find_first (host_info_list, (ListFindF) find_host, host));
+    return (*host_info_slot (host_info, host));
 }
 
 static struct rcmd_module * rcmd_module_register (char *name)
@@ -201,27 +274,28 @@ static int hostlist_register_rcmd (const char *hosts, struct rcmd_module *rmod,
     if (hl == NULL)
         return (-1);
     
-    if (host_info_list == NULL)
-        host_info_list = list_create ((ListDelF) node_rcmd_info_destroy);
+    if (host_info == NULL)
+        host_info = host_info_table_create ();
 
     while ((host = hostlist_pop (hl))) {
-        struct node_rcmd_info *n = NULL;
+        struct node_rcmd_info **np = host_info_slot (host_info, host);
 
         /* 
          *  Do not override previously installed host info. First registered
          *   rcmd type for a host wins. This allows command line to override
          *   everything else.
          */
-        if (list_find_first (host_info_list, (ListFindF) find_host, host))
-            continue;
-
-        if ((n = node_rcmd_info_create (host, user, rmod)) == NULL)
-            errx ("Failed to create rcmd info for host \"%s\"\n", host);
-
-        list_append (host_info_list, n);
+        if (*np == NULL) {
+            if ((*np = node_rcmd_info_create (host, user, rmod)) == NULL)
+                errx ("Failed to create rcmd info for host \"%s\"\n", host);
+
+            /*  Keep the table at most 3/4 full
+             */
+            if (++host_info->count * 4 > host_info->size * 3)
+                host_info_table_grow (host_info);
+        }
 
         free (host);
-    
     }
 
     hostlist_destroy (hl);
@@ -294,6 +368,7 @@ struct rcmd_info * rcmd_info_create (struct rcmd_module *rmod)
     r->opts = &rmod->options;
     r->arg = NULL;
     r->ruser = NULL;
+    r->connected = false;
 
     return (r);
 }
@@ -345,19 +420,30 @@ int rcmd_connect (struct rcmd_info *rcmd, char *ahost, char *addr,
     if (rcmd->ruser)
         remuser = rcmd->ruser;
 
+    rcmd->connected = true;
     rcmd->fd = (*rcmd->rmod->rcmd) (ahost, addr, locuser, remuser, cmd, nodeid, 
                                     error_fd ? &rcmd->efd : NULL, &rcmd->arg);
     return (rcmd->fd);
 }
 
-int rcmd_destroy (struct rcmd_info *rcmd)
+int rcmd_destroy (struct rcmd_info *rcmd, int *sigp)
 {
     int rc = 0;
 
+    if (sigp)
+        *sigp = 0;
     if (rcmd == NULL)
         return (0);
-    if (rcmd->rmod->rcmd_destroy)
+    /*
+     *  Module has nothing to clean up if the host was never connected
+     */
+    if (rcmd->rmod->rcmd_destroy && rcmd->connected)
         rc = (*rcmd->rmod->rcmd_destroy) (rcmd->arg);
+    if (rcmd->opts->exit_status && rc < 0) {
+        if (sigp)
+            *sigp = -rc;
+        rc = 128 - rc;
+    }
     rcmd_info_destroy (rcmd);
 
     return (rc);
@@ -400,8 +486,8 @@ int rcmd_init (opt_t *opt)
 
 int rcmd_exit (void)
 {
-    if (host_info_list)
-        list_destroy (host_info_list);
+    host_info_table_destroy (host_info);
+    host_info = NULL;
     if (rcmd_module_list)
         list_destroy (rcmd_module_list);
 
@@ -419,6 +505,9 @@ int rcmd_opt_set (int id, void * value)
         case RCMD_OPT_RESOLVE_HOSTS: 
             current_rcmd_module->options.resolve_hosts = (long int) value;
             break;
+        case RCMD_OPT_EXIT_STATUS:
+            current_rcmd_module->options.exit_status = (long int) value;
+            break;
         default:
             errno = EINVAL;
             return (-1);
@@ -31,9 +31,12 @@
 
 struct rcmd_options {
 	bool resolve_hosts;
+	bool exit_status;     /* module rcmd_destroy returns remote exit
+	                         status, or -signo if killed by a signal */
 };
 
 #define RCMD_OPT_RESOLVE_HOSTS 0x1
+#define RCMD_OPT_EXIT_STATUS   0x2
 
 struct rcmd_info {
 	int                   fd;
@@ -42,6 +45,7 @@ struct rcmd_info {
 	struct rcmd_options  *opts;
 	char                 *ruser;
 	void                 *arg;
+	bool                  connected;    /* rcmd_connect() was called */
 };
 
 
@@ -82,9 +86,12 @@ int rcmd_connect (struct rcmd_info *rcmd, char *host, char *addr,
 		  bool err);
 
 /*
- *  Destroy rcmd connections
+ *  Destroy rcmd connections and return the module's exit code for the
+ *   host. If the module collects the remote exit status and the remote
+ *   command was killed by a signal, 128 + signo is returned and signo is
+ *   stored in [sigp] (if non-NULL). Otherwise *sigp is set to 0.
  */
-int rcmd_destroy (struct rcmd_info *);
+int rcmd_destroy (struct rcmd_info *, int *sigp);
 
 /*
  *  Send a signal over the specified remote connection
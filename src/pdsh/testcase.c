@@ -34,17 +34,23 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "src/common/err.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 #include "src/common/pipecmd.h"
 #include "src/common/fd.h"
+#include "src/common/xpoll.h"
+#include "src/common/hist.h"
+#include "src/common/hostlist.h"
+#include "cbuf.h"
 #include "dsh.h"
 
 typedef enum { FAIL, PASS } testresult_t;
@@ -56,10 +62,28 @@ typedef struct {
 
 static testresult_t _test_xstrerrorcat(void);
 static testresult_t _test_pipecmd(void);
+static testresult_t _test_cbuf_lines(void);
+static testresult_t _test_xpollset(void);
+static testresult_t _test_hist(void);
+static testresult_t _test_hostlist_setops(void);
+static testresult_t _test_hostset(void);
+static testresult_t _test_hostlist_next_r(void);
+static testresult_t _test_hostlist_split(void);
+static testresult_t _test_hostlist_uniq(void);
+static testresult_t _test_hostlist_freeze(void);
 
 static testcase_t testcases[] = {
     /* 0 */ {"xstrerrorcat", &_test_xstrerrorcat},
     /* 1 */ {"pipecmd",      &_test_pipecmd},
+    /* 2 */ {"cbuf_lines",   &_test_cbuf_lines},
+    /* 3 */ {"xpollset",     &_test_xpollset},
+    /* 4 */ {"hist",         &_test_hist},
+    /* 5 */ {"hostlist_setops", &_test_hostlist_setops},
+    /* 6 */ {"hostset",      &_test_hostset},
+    /* 7 */ {"hostlist_next_r", &_test_hostlist_next_r},
+    /* 8 */ {"hostlist_split", &_test_hostlist_split},
+    /* 9 */ {"hostlist_uniq", &_test_hostlist_uniq},
+    /* 10 */ {"hostlist_freeze", &_test_hostlist_freeze},
 };
 
 static void _testmsg(int testnum, testresult_t result)
@@ -116,6 +140,685 @@ static testresult_t _test_pipecmd(void)
     return PASS;
 }
 
+static double _elapsed(struct timeval *start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return ((now.tv_sec - start->tv_sec)
+            + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+/*
+ *  Return the length of the next line in [cb], and if it is complete
+ *   check it against [line]. With [zerocopy], the line is examined in
+ *   place with cbuf_peek_line_iov(), otherwise it is copied into [buf].
+ */
+static int _cbuf_next_line(cbuf_t cb, char *buf, const char *line,
+                           int linelen, int zerocopy)
+{
+    struct iovec span[2];
+    int nspan, off, i, n;
+    char c;
+
+    if (!zerocopy) {
+        if ((n = cbuf_peek_line(cb, &c, 1, 1)) <= 0)
+            return n;
+        if (n != linelen || cbuf_read(cb, buf, n) != n)
+            return -1;
+        return (memcmp(buf, line, linelen) == 0 ? n : -1);
+    }
+
+    if ((n = cbuf_peek_line_iov(cb, span, &nspan, 1)) <= 0)
+        return n;
+    if (n != linelen)
+        return -1;
+    for (i = 0, off = 0; i < nspan; off += span[i++].iov_len) {
+        if (memcmp(span[i].iov_base, line + off, span[i].iov_len) != 0)
+            return -1;
+    }
+    cbuf_drop(cb, n);
+    return n;
+}
+
+/*
+ *  Write [nlines] lines of [linelen] bytes (including newline) to [cb]
+ *   in [chunk] byte pieces, reading complete lines back out the same
+ *   way dsh does: look for the next line after each write, then
+ *   consume it. Verify every line read and report throughput.
+ */
+static testresult_t _cbuf_lines_run(const char *name, cbuf_t cb,
+                                    int linelen, int nlines, int chunk,
+                                    int zerocopy)
+{
+    char *line = Malloc(linelen);
+    char *buf = Malloc(linelen + 1);
+    struct timeval start;
+    double secs;
+    char rate[64];
+    int written = 0;
+    int nread = 0;
+    int total = linelen * nlines;
+    int i, n;
+
+    for (i = 0; i < linelen - 1; i++)
+        line[i] = 'a' + (i % 26);
+    line[linelen - 1] = '\n';
+
+    gettimeofday(&start, NULL);
+    while (written < total) {
+        int off = written % linelen;
+        int len = chunk < linelen - off ? chunk : linelen - off;
+
+        if (cbuf_write(cb, line + off, len, NULL) != len) {
+            err("%P: cbuf_lines: %s: short write: %m\n", name);
+            goto fail;
+        }
+        written += len;
+
+        while ((n = _cbuf_next_line(cb, buf, line, linelen, zerocopy)) > 0)
+            nread++;
+        if (n < 0) {
+            err("%P: cbuf_lines: %s: line %d corrupt\n", name, nread);
+            goto fail;
+        }
+    }
+    secs = _elapsed(&start);
+
+    if (nread != nlines || cbuf_used(cb) != 0) {
+        err("%P: cbuf_lines: %s: read %d of %d lines\n", name, nread, nlines);
+        goto fail;
+    }
+
+    /* out() has no floating point conversions */
+    snprintf(rate, sizeof(rate), "%.0f lines/s, %.1f MB/s",
+             nlines / secs, total / secs / (1024 * 1024));
+    out("%P: cbuf_lines: %s: %d lines of %d bytes: %s\n",
+        name, nlines, linelen, rate);
+
+    Free((void **) &line);
+    Free((void **) &buf);
+    return PASS;
+fail:
+    Free((void **) &line);
+    Free((void **) &buf);
+    return FAIL;
+}
+
+/*
+ *  Run the line tests on both a locked and an unlocked cbuf, so the
+ *   cost of the cbuf mutex on the read path can be compared. The small
+ *   chunk case makes the most cbuf calls per byte. The unlocked cbuf
+ *   is also read in place, as dsh does for text output.
+ */
+static testresult_t _test_cbuf_lines(void)
+{
+    testresult_t result = PASS;
+    int unlocked;
+
+    for (unlocked = 0; unlocked <= 1; unlocked++) {
+        cbuf_t cb = unlocked ? cbuf_create_unlocked(64, 1024 * 1024)
+                             : cbuf_create(64, 1024 * 1024);
+        const char *s = unlocked ? "unlocked" : "locked";
+        char name[64];
+
+        cbuf_opt_set(cb, CBUF_OPT_OVERWRITE, CBUF_NO_DROP);
+
+        /*  Odd chunk sizes keep lines wrapping around the end of the ring. */
+        snprintf(name, sizeof(name), "%s short", s);
+        if (_cbuf_lines_run(name, cb, 80, 200000, 4093, 0) == FAIL)
+            result = FAIL;
+        snprintf(name, sizeof(name), "%s small chunks", s);
+        if (_cbuf_lines_run(name, cb, 80, 200000, 61, 0) == FAIL)
+            result = FAIL;
+        snprintf(name, sizeof(name), "%s long", s);
+        if (_cbuf_lines_run(name, cb, 512 * 1024, 32, 4093, 0) == FAIL)
+            result = FAIL;
+        if (unlocked) {
+            if (_cbuf_lines_run("in place short", cb, 80, 200000, 4093, 1)
+                == FAIL)
+                result = FAIL;
+            if (_cbuf_lines_run("in place long", cb, 512 * 1024, 32, 4093, 1)
+                == FAIL)
+                result = FAIL;
+        }
+
+        cbuf_destroy(cb);
+    }
+    return result;
+}
+
+static testresult_t _test_xpollset(void)
+{
+    testresult_t result = FAIL;
+    struct xpollfd ready[2];
+    xpollset_t ps;
+    FILE *fp = NULL;
+    int p1[2], p2[2];
+    int n;
+
+    if (pipe(p1) < 0 || pipe(p2) < 0)
+        return FAIL;
+    if (!(ps = xpollset_create(2)))
+        return FAIL;
+
+    if (xpollset_add(ps, p1[0], XPOLLREAD) < 0
+        || xpollset_add(ps, p2[0], XPOLLREAD) < 0) {
+        err("%P: xpollset: add: %m\n");
+        goto out;
+    }
+    if ((n = xpollset_wait(ps, ready, 2, 0)) != 0) {
+        err("%P: xpollset: %d fds ready with no data\n", n);
+        goto out;
+    }
+
+    if (write(p2[1], "x", 1) != 1)
+        goto out;
+    n = xpollset_wait(ps, ready, 2, 1000);
+    if (n != 1 || ready[0].fd != p2[0] || !(ready[0].revents & XPOLLREAD)) {
+        err("%P: xpollset: expected fd %d readable, got %d ready\n", p2[0], n);
+        goto out;
+    }
+
+    /*  A closed writer is reported */
+    close(p1[1]);
+    n = xpollset_wait(ps, ready, 1, 1000);
+    if (n != 1) {
+        err("%P: xpollset: expected 1 ready with maxready 1, got %d\n", n);
+        goto out;
+    }
+    if (xpollset_remove(ps, p2[0]) < 0) {
+        err("%P: xpollset: remove: %m\n");
+        goto out;
+    }
+    n = xpollset_wait(ps, ready, 2, 1000);
+    if (n != 1 || ready[0].fd != p1[0]
+        || !(ready[0].revents & (XPOLLREAD|XPOLLERR))) {
+        err("%P: xpollset: expected hangup on fd %d\n", p1[0]);
+        goto out;
+    }
+    if (xpollset_remove(ps, p1[0]) < 0) {
+        err("%P: xpollset: remove: %m\n");
+        goto out;
+    }
+    close(p1[0]);
+
+    /*  Removing an fd that is not in the set fails and leaves the set
+     *   size alone, so the set still holds exactly maxfds fds */
+    if (xpollset_remove(ps, p2[0]) == 0 || xpollset_remove(ps, p1[0]) == 0) {
+        err("%P: xpollset: remove of fd not in set succeeded\n");
+        goto out;
+    }
+    if ((n = dup(p2[0])) < 0)
+        goto out;
+    if (xpollset_add(ps, p2[0], XPOLLREAD) < 0
+        || xpollset_add(ps, p2[1], XPOLLREAD) < 0) {
+        err("%P: xpollset: add after remove: %m\n");
+        close(n);
+        goto out;
+    }
+    if (xpollset_add(ps, n, XPOLLREAD) == 0 || errno != ENOSPC) {
+        err("%P: xpollset: added more than maxfds fds\n");
+        close(n);
+        goto out;
+    }
+    close(n);
+
+    /*  A regular file, which epoll refuses, is still watched */
+    if (xpollset_remove(ps, p2[1]) < 0 || !(fp = tmpfile()))
+        goto out;
+    if (xpollset_add(ps, fileno(fp), XPOLLREAD) < 0) {
+        err("%P: xpollset: add regular file: %m\n");
+        goto out;
+    }
+    n = xpollset_wait(ps, ready, 2, 1000);
+    if (n < 1 || (ready[0].fd != fileno(fp)
+                  && (n < 2 || ready[1].fd != fileno(fp)))
+        || xpollset_remove(ps, fileno(fp)) < 0) {
+        err("%P: xpollset: expected regular file fd %d ready\n", fileno(fp));
+        goto out;
+    }
+    result = PASS;
+out:
+    if (fp)
+        fclose(fp);
+    xpollset_destroy(ps);
+    close(p2[0]);
+    close(p2[1]);
+    return result;
+}
+
+/*
+ *  Percentiles of a histogram must be exact for small values and
+ *   within the bucket resolution (about 3%) for large ones.
+ */
+static int _hist_check(hist_t h, double pct, double expected)
+{
+    unsigned long long v = hist_percentile(h, pct);
+    double lo = expected * 0.96, hi = expected * 1.04;
+
+    if (v < lo || v > hi) {
+        char str[128];
+        snprintf(str, sizeof(str), "p%g = %llu, expected %.0f", pct, v, expected);
+        err("%P: hist: %s\n", str);
+        return (-1);
+    }
+    return (0);
+}
+
+static testresult_t _test_hist(void)
+{
+    testresult_t result = FAIL;
+    hist_t h = hist_create();
+    unsigned long long v;
+
+    if (hist_percentile(h, 50) != 0 || hist_count(h) != 0)
+        goto out;
+
+    for (v = 1; v <= 20; v++)
+        hist_add(h, v);
+    if (hist_percentile(h, 50) != 10 || hist_percentile(h, 100) != 20) {
+        err("%P: hist: small values not exact\n");
+        goto out;
+    }
+    hist_destroy(h);
+
+    h = hist_create();
+    for (v = 1; v <= 100000; v++)
+        hist_add(h, v * 1000);
+    if (hist_count(h) != 100000)
+        goto out;
+    if (_hist_check(h, 50, 50000000.0) < 0
+        || _hist_check(h, 90, 90000000.0) < 0
+        || _hist_check(h, 99, 99000000.0) < 0
+        || _hist_check(h, 99.9, 99900000.0) < 0)
+        goto out;
+
+    hist_add(h, ~0ULL);
+    if (hist_percentile(h, 100) < (~0ULL / 100) * 96)
+        goto out;
+
+    result = PASS;
+out:
+    hist_destroy(h);
+    return result;
+}
+
+/*
+ *  Return 0 if hostlist hl contains exactly the hosts in `expected',
+ *   in the same order.
+ */
+static int _hostlist_check(const char *op, hostlist_t hl, const char *expected)
+{
+    hostlist_t e = hostlist_create(expected);
+    char got[1024], want[1024];
+    int rc = 0;
+
+    hostlist_deranged_string(hl, sizeof(got), got);
+    hostlist_deranged_string(e, sizeof(want), want);
+    if (strcmp(got, want) != 0) {
+        err("%P: hostlist %s: expected \"%s\" got \"%s\"\n", op, want, got);
+        rc = -1;
+    }
+    hostlist_destroy(e);
+    return rc;
+}
+
+static testresult_t _test_hostlist_setops(void)
+{
+    struct {
+        char *op;
+        char *h1;
+        char *h2;
+        char *result;
+    } tests[] = {
+        { "intersect",  "n[1-20]",       "n[5-8,15-30]",  "n[5-8,15-20]" },
+        { "difference", "n[1-20]",       "n[5-8,15-30]",  "n[1-4,9-14]"  },
+        { "intersect",  "n[01-09]",      "n0[3-5]",       "n[03-05]"     },
+        { "intersect",  "n1[0-5]",       "n[12-20]",      "n[12-15]"     },
+        { "difference", "n[8-12]",       "n[9-10]",       "n[8,11-12]"   },
+        { "difference", "n[08-12]",      "n9",            "n[08-12]"     },
+        { "difference", "z,n5,a,n1",     "n1,b",          "z,n5,a"       },
+        { "intersect",  "foo,bar,n1",    "bar,n[1-2]",    "bar,n1"       },
+        { "intersect",  "x123456789012345678901234", "x123456789012345678901234",
+                        "x123456789012345678901234"                      },
+        { "union",      "b,a",           "a,c",           "b,a,c"        },
+        { "symmetric_difference", "n[1-5]", "n[4-8]",     "n[1-3,6-8]"   },
+        { "subtract",   "n[1-3],n[1-3]", "n2",            "n[1,3],n[1,3]" },
+        { NULL, NULL, NULL, NULL }
+    };
+    testresult_t result = PASS;
+    int i;
+
+    for (i = 0; tests[i].op; i++) {
+        hostlist_t h1 = hostlist_create(tests[i].h1);
+        hostlist_t h2 = hostlist_create(tests[i].h2);
+        hostlist_t r = NULL;
+
+        if (strcmp(tests[i].op, "intersect") == 0)
+            r = hostlist_intersect(h1, h2);
+        else if (strcmp(tests[i].op, "difference") == 0)
+            r = hostlist_difference(h1, h2);
+        else if (strcmp(tests[i].op, "union") == 0)
+            r = hostlist_union(h1, h2);
+        else if (strcmp(tests[i].op, "symmetric_difference") == 0)
+            r = hostlist_symmetric_difference(h1, h2);
+        else if (hostlist_subtract(h1, h2) == 2)
+            r = hostlist_copy(h1);
+
+        if (r == NULL || _hostlist_check(tests[i].op, r, tests[i].result) < 0)
+            result = FAIL;
+
+        hostlist_destroy(r);
+        hostlist_destroy(h1);
+        hostlist_destroy(h2);
+    }
+    return result;
+}
+
+static testresult_t _test_hostset(void)
+{
+    hostset_t set = hostset_create("n[1-10]");
+    hostset_t big = hostset_create("");
+    testresult_t result = PASS;
+    char buf[1024];
+    char *host;
+    int i;
+
+#define HOSTSET_CHECK(expr)                                                \
+    do {                                                                   \
+        if (!(expr)) {                                                     \
+            err("%P: hostset: check failed: %s\n", #expr);                \
+            result = FAIL;                                                 \
+        }                                                                  \
+    } while (0)
+
+    HOSTSET_CHECK(hostset_insert(set, "n[5-15],m1,n12") == 6);
+    HOSTSET_CHECK(hostset_count(set) == 16);
+    HOSTSET_CHECK(hostset_find_host(set, "n15"));
+    HOSTSET_CHECK(hostset_find_host(set, "m1"));
+    HOSTSET_CHECK(!hostset_find_host(set, "n16"));
+    HOSTSET_CHECK(!hostset_find_host(set, "n"));
+    HOSTSET_CHECK(hostset_within(set, "n[2-4],m1"));
+    HOSTSET_CHECK(!hostset_within(set, "n[2-20]"));
+    HOSTSET_CHECK(hostset_delete(set, "n[3-4],x") == 2);
+    HOSTSET_CHECK(hostset_delete_host(set, "n3") == 0);
+    HOSTSET_CHECK(hostset_count(set) == 14);
+    HOSTSET_CHECK(hostset_ranged_string(set, sizeof(buf), buf) >= 0
+                  && strcmp(buf, "m1,n[1-2,5-15]") == 0);
+    HOSTSET_CHECK((host = hostset_shift(set)) && strcmp(host, "m1") == 0);
+    free(host);
+    HOSTSET_CHECK(!hostset_find_host(set, "m1"));
+    HOSTSET_CHECK(hostset_count(set) == 13);
+
+    /*  Inserted ranges print as given */
+    hostset_destroy(set);
+    set = hostset_create("x[02-03]");
+    HOSTSET_CHECK(hostset_insert(set, "x0[18-30]") == 13);
+    HOSTSET_CHECK(hostset_insert(set, "x0[20-25],x02") == 0);
+    HOSTSET_CHECK(hostset_ranged_string(set, sizeof(buf), buf) >= 0
+                  && strcmp(buf, "x[02-03],x0[18-30]") == 0);
+
+    for (i = 0; i < 100000; i += 10000) {
+        snprintf(buf, sizeof(buf), "n[%d-%d]", i + 1, i + 10000);
+        hostset_insert(big, buf);
+    }
+    HOSTSET_CHECK(hostset_find_host(big, "n99999"));
+    HOSTSET_CHECK(hostset_delete_host(big, "n50000") == 1);
+    HOSTSET_CHECK(!hostset_find_host(big, "n50000"));
+    HOSTSET_CHECK(hostset_count(big) == 99999);
+
+#undef HOSTSET_CHECK
+
+    hostset_destroy(set);
+    hostset_destroy(big);
+    return result;
+}
+
+static testresult_t _test_hostlist_next_r(void)
+{
+    const char *expected[] = { "n8", "n9", "n10", "foo", "x001", "x002", NULL };
+    hostlist_t hl = hostlist_create("n[8-10],foo,x[001-002]");
+    hostlist_iterator_t i = hostlist_iterator_create(hl);
+    testresult_t result = PASS;
+    char buf[64];
+    int j, len;
+
+    for (j = 0; expected[j]; j++) {
+        len = hostlist_next_r(i, buf, sizeof(buf));
+        if (len != strlen(expected[j]) || strcmp(buf, expected[j]) != 0) {
+            err("%P: hostlist_next_r: expected \"%s\" got \"%s\" (%d)\n",
+                expected[j], buf, len);
+            result = FAIL;
+        }
+    }
+    if ((len = hostlist_next_r(i, buf, sizeof(buf))) != 0) {
+        err("%P: hostlist_next_r: expected end of list, got %d\n", len);
+        result = FAIL;
+    }
+
+    /*
+     *  Truncated names are terminated and the iterator still advances
+     */
+    hostlist_iterator_reset(i);
+    hostlist_next_r(i, NULL, 0);
+    hostlist_next_r(i, NULL, 0);
+    if ((len = hostlist_next_r(i, buf, 3)) != 3 || strcmp(buf, "n1") != 0
+        || hostlist_next_r(i, buf, sizeof(buf)) != 3
+        || strcmp(buf, "foo") != 0) {
+        err("%P: hostlist_next_r: truncation failed\n");
+        result = FAIL;
+    }
+
+    hostlist_iterator_destroy(i);
+    hostlist_destroy(hl);
+    return result;
+}
+
+static testresult_t _test_hostlist_split(void)
+{
+    struct {
+        char *hosts;
+        int n;
+        char *parts[4];
+    } tests[] = {
+        { "n[1-10]",           3, { "n[1-4]", "n[5-8]", "n[9-10]", NULL } },
+        { "a,n[1-3],b,n[4-5]", 2, { "a,n[1-3]", "b,n[4-5]", NULL } },
+        { "x,y",               4, { "x", "y", NULL } },
+        { "",                  2, { "", NULL } },
+        { NULL, 0, { NULL } }
+    };
+    testresult_t result = PASS;
+    hostlist_t parts[4];
+    int i, j, n;
+
+    for (i = 0; tests[i].hosts; i++) {
+        hostlist_t hl = hostlist_create(tests[i].hosts);
+
+        n = hostlist_split(hl, tests[i].n, parts);
+        for (j = 0; j < n; j++) {
+            if (!tests[i].parts[j]
+                || _hostlist_check("split", parts[j], tests[i].parts[j]) < 0)
+                result = FAIL;
+            hostlist_destroy(parts[j]);
+        }
+        if (n < 0 || (n < 4 && tests[i].parts[n])) {
+            err("%P: hostlist_split: \"%s\": got %d parts\n",
+                tests[i].hosts, n);
+            result = FAIL;
+        }
+        hostlist_destroy(hl);
+    }
+    return result;
+}
+
+static testresult_t _test_hostlist_uniq(void)
+{
+    struct {
+        char *op;
+        char *hosts;
+        char *result;
+    } tests[] = {
+        { "uniq", "n[1-20],n15,n3",        "n[1-20]"         },
+        { "uniq", "n[001-099],n[100-105]", "n[001-105]"      },
+        { "uniq", "n5,n3,n[1-4],n10",      "n[1-5,10]"       },
+        { "uniq", "b,a,n2,a,b1,n1",        "a,b,b1,n[1-2]"   },
+        { "uniq", "n[9-11],n[09-11]",      "n[9-11],n09"     },
+        { "uniq", "x[1-3],x,x[2-5],x",     "x,x[1-5]"        },
+        { "sort", "n[1-3],n2,n[2-4]",      "n1,n2,n2,n2,n3,n3,n4" },
+        { "sort", "b,a,a,n2,n1",           "a,a,b,n[1-2]"    },
+        { "sort", "n10,n9,n[1-8]",         "n[1-10]"         },
+        { "sort", "n[7-11],n04",           "n[7-11],n04"     },
+        { "sort", "n[05-12],n[8-9]",       "n[8-9],n[05-12]" },
+        { "sort", "n12,n03,n15,n01",       "n[01,03,12,15]"  },
+        { "sort", "n08,n72",               "n[08,72]"        },
+        { "uniq", "n08,n72,n09,n08",       "n[08-09,72]"     },
+        { "uniq", "n10,n[9-11],n12",       "n[9-12]"         },
+        { NULL, NULL, NULL }
+    };
+    testresult_t result = PASS;
+    hostlist_t hl;
+    char host[64];
+    char *first;
+    int i, n = 50000;
+
+    for (i = 0; tests[i].op; i++) {
+        hl = hostlist_create(tests[i].hosts);
+        if (strcmp(tests[i].op, "uniq") == 0)
+            hostlist_uniq(hl);
+        else
+            hostlist_sort(hl);
+        if (_hostlist_check(tests[i].op, hl, tests[i].result) < 0)
+            result = FAIL;
+        hostlist_destroy(hl);
+    }
+
+    /*
+     *  Every host in n[1-50000] twice, in scrambled order
+     */
+    hl = hostlist_create("");
+    for (i = 0; i < 2 * n; i++) {
+        snprintf(host, sizeof(host), "n%d", 1 + (int) (i * 7919L % n));
+        hostlist_push_host(hl, host);
+    }
+    hostlist_sort(hl);
+    first = hostlist_nth(hl, 1);
+    if (hostlist_count(hl) != 2 * n || !first || strcmp(first, "n1") != 0) {
+        err("%P: hostlist_sort: large list sorted incorrectly\n");
+        result = FAIL;
+    }
+    free(first);
+    hostlist_uniq(hl);
+    if (hostlist_count(hl) != n
+        || hostlist_ranged_string(hl, sizeof(host), host) < 0
+        || strcmp(host, "n[1-50000]") != 0) {
+        err("%P: hostlist_uniq: large list not coalesced\n");
+        result = FAIL;
+    }
+    hostlist_destroy(hl);
+
+    return result;
+}
+
+/*
+ *  Look up every host of a frozen hostlist by name, starting at a
+ *   different offset in each thread. Returns the number of failures.
+ */
+static void *_frozen_reader(void *arg)
+{
+    hostlist_frozen_t f = ((void **) arg)[0];
+    long off = (long) ((void **) arg)[1];
+    int n = hostlist_frozen_count(f);
+    long nbad = 0;
+    char host[64];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        int j = (i + off) % n;
+        if (hostlist_frozen_nth(f, j, host, sizeof(host)) < 0
+            || hostlist_frozen_find(f, host) != j)
+            nbad++;
+    }
+    return ((void *) nbad);
+}
+
+static testresult_t _test_hostlist_freeze(void)
+{
+    struct {
+        char *hosts;
+        char *host;
+        int pos;
+    } tests[] = {
+        { "n[1-10]",              "n5",     4 },
+        { "n[1-10]",              "n05",   -1 },
+        { "n[01-10]",             "n05",    4 },
+        { "n[8-12],n[05-09]",     "n09",    9 },
+        { "n[8-12],n[05-09]",     "n9",     1 },
+        { "n0[1-5],n[1-5]",       "n03",    2 },
+        { "n0[1-5],n[1-5]",       "n3",     7 },
+        { "foo,n1,foo",           "foo",    0 },
+        { "foo,n1,foo",           "fo",    -1 },
+        { "rack1-n[1-4],1,x",     "1",      4 },
+        { "n[1-3],n2",            "n2",     1 },
+        { "",                     "n1",    -1 },
+        { NULL, NULL, 0 }
+    };
+    testresult_t result = PASS;
+    pthread_t thd[4];
+    void *args[4][2];
+    hostlist_frozen_t f;
+    hostlist_t hl;
+    char buf[64];
+    int i, pos;
+
+    for (i = 0; tests[i].hosts; i++) {
+        hl = hostlist_create(tests[i].hosts);
+        if (!(f = hostlist_freeze(hl)))
+            return FAIL;
+        if ((pos = hostlist_frozen_find(f, tests[i].host)) != tests[i].pos) {
+            err("%P: hostlist_frozen_find(\"%s\", \"%s\") = %d\n",
+                tests[i].hosts, tests[i].host, pos);
+            result = FAIL;
+        }
+        hostlist_frozen_destroy(f);
+        hostlist_destroy(hl);
+    }
+
+    /*
+     *  The snapshot is unaffected by later changes to the hostlist
+     */
+    hl = hostlist_create("n[1-10000]");
+    f = hostlist_freeze(hl);
+    hostlist_delete(hl, "n[1-10]");
+    hostlist_push(hl, "m1");
+    if (hostlist_frozen_count(f) != 10000
+        || hostlist_frozen_nth(f, 0, buf, sizeof(buf)) != 2
+        || strcmp(buf, "n1") != 0
+        || hostlist_frozen_nth(f, 10000, buf, sizeof(buf)) != -1
+        || hostlist_frozen_find(f, "m1") != -1) {
+        err("%P: hostlist_freeze: snapshot changed with hostlist\n");
+        result = FAIL;
+    }
+    hostlist_destroy(hl);
+
+    for (i = 0; i < 4; i++) {
+        args[i][0] = f;
+        args[i][1] = (void *) (long) (i * 2500);
+        pthread_create(&thd[i], NULL, _frozen_reader, args[i]);
+    }
+    for (i = 0; i < 4; i++) {
+        void *nbad;
+        pthread_join(thd[i], &nbad);
+        if (nbad != NULL) {
+            err("%P: hostlist_freeze: reader %d: %d lookups failed\n",
+                i, (int) (long) nbad);
+            result = FAIL;
+        }
+    }
+    hostlist_frozen_destroy(f);
+
+    return result;
+}
+
 void testcase(int testnum)
 {
     testresult_t result;
@@ -0,0 +1,80 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "timing.h"
+
+static const char *point_names[] = {
+    "create", "start", "resolved", "connected",
+    "first_byte", "last_byte", "reaped"
+};
+
+unsigned long long timing_now (void)
+{
+#if HAVE_CLOCK_GETTIME && defined (CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+        return ((unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+    {
+        struct timeval tv;
+        gettimeofday (&tv, NULL);
+        return ((unsigned long long) tv.tv_sec * 1000000000
+                + (unsigned long long) tv.tv_usec * 1000);
+    }
+}
+
+unsigned long long timing_mark (timing_t ts, timing_point_t p)
+{
+    return (ts[p] = timing_now ());
+}
+
+const char * timing_point_name (timing_point_t p)
+{
+    return (point_names[p]);
+}
+
+char * timing_fmt (char *buf, size_t len, unsigned long long ns)
+{
+    if (ns < 1000000)
+        snprintf (buf, len, "%.0fus", ns / 1000.0);
+    else if (ns < 1000000000)
+        snprintf (buf, len, "%.1fms", ns / 1000000.0);
+    else
+        snprintf (buf, len, "%.2fs", ns / 1000000000.0);
+    return (buf);
+}
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,83 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _TIMING_H
+#define _TIMING_H
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stddef.h>
+
+/*
+ *  Per-host phase timings.
+ *
+ *  Each host thread records a monotonic nanosecond timestamp as it
+ *   reaches each of the points below. A point not reached is left 0.
+ *   The rcmd module API returns only once a connection is fully set
+ *   up, so TIMING_CONNECTED covers both TCP connect and any
+ *   authentication handshake.
+ */
+typedef enum {
+    TIMING_CREATE,              /* thread about to be created            */
+    TIMING_START,               /* thread running                        */
+    TIMING_RESOLVED,            /* hostname resolved                     */
+    TIMING_CONNECTED,           /* rcmd_connect() returned               */
+    TIMING_FIRST_BYTE,          /* first output read from the host       */
+    TIMING_LAST_BYTE,           /* EOF on output, or copy complete       */
+    TIMING_REAPED,              /* rcmd_destroy() returned               */
+    TIMING_NPOINTS
+} timing_point_t;
+
+typedef unsigned long long timing_t[TIMING_NPOINTS];
+
+/*
+ *  Monotonic clock in nanoseconds.
+ */
+unsigned long long timing_now (void);
+
+/*
+ *  Record that `ts' reached point `p' now, and return the time.
+ */
+unsigned long long timing_mark (timing_t ts, timing_point_t p);
+
+/*
+ *  Name of point `p', for reports.
+ */
+const char * timing_point_name (timing_point_t p);
+
+/*
+ *  Format duration `ns' into `buf' with a unit suited to its size
+ *   (e.g. "850us", "12.3ms", "1.52s"), and return `buf'.
+ */
+char * timing_fmt (char *buf, size_t len, unsigned long long ns);
+
+#endif /* !_TIMING_H */
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
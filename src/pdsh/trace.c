@@ -0,0 +1,236 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "jsonout.h"
+#include "timing.h"
+#include "trace.h"
+
+#define TRACE_BUF_MINSIZE   64
+
+struct trace_span {
+    const char *cat;
+    char *name;
+    unsigned long long start;
+    unsigned long long end;
+    const char *argname;
+    long arg;
+    bool copied;                    /* name is ours to free                */
+};
+
+struct trace_buf {
+    int tid;
+    char *name;
+    struct trace_span *spans;
+    int nspans;
+    int size;
+    struct trace_buf *next;
+};
+
+static struct {
+    int enabled;
+    char *path;
+    unsigned long long start;       /* timeline origin                     */
+    pthread_key_t key;
+    pthread_mutex_t mutex;          /* protects bufs                       */
+    struct trace_buf *bufs;
+} trace = { 0, NULL, 0 };
+
+void trace_init (const char *path)
+{
+    trace.path = Strdup (path);
+    trace.start = timing_now ();
+    trace.bufs = NULL;
+    pthread_key_create (&trace.key, NULL);
+    pthread_mutex_init (&trace.mutex, NULL);
+    trace.enabled = 1;
+}
+
+int trace_enabled (void)
+{
+    return (trace.enabled);
+}
+
+void trace_thread (int tid, const char *name)
+{
+    struct trace_buf *b;
+
+    if (!trace.enabled)
+        return;
+
+    b = Malloc (sizeof (*b));
+    b->tid = tid;
+    b->name = Strdup (name);
+    b->spans = NULL;
+    b->nspans = b->size = 0;
+
+    pthread_mutex_lock (&trace.mutex);
+    b->next = trace.bufs;
+    trace.bufs = b;
+    pthread_mutex_unlock (&trace.mutex);
+
+    pthread_setspecific (trace.key, b);
+}
+
+static void _span_add (const char *cat, char *name, bool copied,
+                       unsigned long long start, unsigned long long end,
+                       const char *argname, long arg)
+{
+    struct trace_buf *b = pthread_getspecific (trace.key);
+    struct trace_span *s;
+
+    if (b == NULL) {
+        if (copied)
+            Free ((void **) &name);
+        return;
+    }
+
+    if (b->nspans == b->size) {
+        b->size = b->size ? b->size * 2 : TRACE_BUF_MINSIZE;
+        if (b->spans)
+            Realloc ((void **) &b->spans, b->size * sizeof (*s));
+        else
+            b->spans = Malloc (b->size * sizeof (*s));
+    }
+
+    s = &b->spans[b->nspans++];
+    s->cat = cat;
+    s->name = name;
+    s->copied = copied;
+    s->start = start;
+    s->end = end;
+    s->argname = argname;
+    s->arg = arg;
+}
+
+void trace_span (const char *cat, const char *name,
+                 unsigned long long start, unsigned long long end,
+                 const char *argname, long arg)
+{
+    if (trace.enabled)
+        _span_add (cat, (char *) name, false, start, end, argname, arg);
+}
+
+void trace_span_copy (const char *cat, const char *name,
+                      unsigned long long start, unsigned long long end,
+                      const char *argname, long arg)
+{
+    if (trace.enabled)
+        _span_add (cat, Strdup (name), true, start, end, argname, arg);
+}
+
+/*
+ *  Chrome trace times are in microseconds from an arbitrary origin.
+ */
+static double _usec (unsigned long long t)
+{
+    return ((t > trace.start ? t - trace.start : 0) / 1000.0);
+}
+
+static void _write_buf (FILE *fp, struct trace_buf *b)
+{
+    int i;
+
+    fprintf (fp, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+             "\"name\":\"thread_name\",\"args\":{\"name\":", b->tid);
+    jsonout_fputs_string (fp, b->name);
+    fprintf (fp, "}}");
+    fprintf (fp, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+             "\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}}",
+             b->tid, b->tid);
+
+    for (i = 0; i < b->nspans; i++) {
+        struct trace_span *s = &b->spans[i];
+
+        fprintf (fp, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"cat\":\"%s\","
+                 "\"name\":", b->tid, s->cat);
+        jsonout_fputs_string (fp, s->name);
+        fprintf (fp, ",\"ts\":%.3f,\"dur\":%.3f", _usec (s->start),
+                 s->end > s->start ? (s->end - s->start) / 1000.0 : 0.0);
+        if (s->argname)
+            fprintf (fp, ",\"args\":{\"%s\":%ld}", s->argname, s->arg);
+        fprintf (fp, "}");
+    }
+}
+
+static void _free_buf (struct trace_buf *b)
+{
+    int i;
+
+    for (i = 0; i < b->nspans; i++) {
+        if (b->spans[i].copied)
+            Free ((void **) &b->spans[i].name);
+    }
+    Free ((void **) &b->spans);
+    Free ((void **) &b->name);
+    Free ((void **) &b);
+}
+
+int trace_fini (void)
+{
+    struct trace_buf *b;
+    FILE *fp;
+    int rc = 0;
+
+    if (!trace.enabled)
+        return (0);
+    trace.enabled = 0;
+
+    if ((fp = fopen (trace.path, "w"))) {
+        fprintf (fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                 "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\","
+                 "\"args\":{\"name\":\"pdsh\"}}");
+        for (b = trace.bufs; b != NULL; b = b->next)
+            _write_buf (fp, b);
+        fprintf (fp, "\n]}\n");
+        rc = fclose (fp);
+    }
+    else
+        rc = -1;
+
+    while ((b = trace.bufs)) {
+        trace.bufs = b->next;
+        _free_buf (b);
+    }
+    Free ((void **) &trace.path);
+
+    return (rc);
+}
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
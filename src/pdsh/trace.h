@@ -0,0 +1,88 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+/*
+ *  Trace event export (PDSH_TRACE_FILE).
+ *
+ *  Spans recorded during the run are written at the end as a Chrome
+ *   trace-event JSON file, which can be loaded into chrome://tracing
+ *   or Perfetto to view the run as a timeline with one row per host.
+ *
+ *  Each thread that records spans first calls trace_thread() to get a
+ *   buffer of its own, so recording a span takes no lock. Buffers are
+ *   kept until trace_fini() writes them out.
+ *
+ *  All functions are no-ops unless trace_init() has been called.
+ *   Span times are timing_now() values.
+ */
+
+/*
+ *  Enable tracing, to be written to `path' by trace_fini().
+ */
+void trace_init (const char *path);
+
+/*
+ *  Return nonzero if tracing is enabled.
+ */
+int trace_enabled (void);
+
+/*
+ *  Give the calling thread a trace buffer, shown as row `tid' named
+ *   `name' in the timeline.
+ */
+void trace_thread (int tid, const char *name);
+
+/*
+ *  Record a span `name' of category `cat' from `start' to `end' in the
+ *   calling thread's buffer, with an optional integer argument `argname'
+ *   (may be NULL). `cat', `name' and `argname' must remain valid until
+ *   trace_fini(); trace_span_copy() makes its own copy of `name'.
+ */
+void trace_span (const char *cat, const char *name,
+                 unsigned long long start, unsigned long long end,
+                 const char *argname, long arg);
+void trace_span_copy (const char *cat, const char *name,
+                      unsigned long long start, unsigned long long end,
+                      const char *argname, long arg);
+
+/*
+ *  Write all recorded spans to the trace file and free the buffers.
+ *   Returns -1 with errno set if the file could not be written.
+ */
+int trace_fini (void);
+
+#endif /* !_TRACE_H */
+
+/*
+ * vi: tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,86 @@
+#!/bin/sh
+#
+#  Run pdsh and pdcp against the simulated rcmd module (test-modules/sim.c)
+#   and report throughput and resource usage for a fixed set of scenarios.
+#
+#  Usage: bench.sh [HOSTS]
+#
+#  Scenarios may be restricted with BENCH_SCENARIOS="name ..." and the
+#   fanout set with BENCH_FANOUT (default 64). Results are deterministic
+#   apart from timing, so runs can be compared before and after a change.
+#
+#  The sim module is loaded via PDSH_MODULE_DIR, which pdsh ignores when
+#   run as root.
+#
+srcdir=${srcdir:-.}
+builddir=${builddir:-.}
+hosts=${1:-${BENCH_HOSTS:-1000}}
+fanout=${BENCH_FANOUT:-64}
+
+pdsh=$(cd $builddir/../src/pdsh && pwd)/pdsh
+PDSH_MODULE_DIR=$(cd $builddir/test-modules/.libs && pwd)
+export PDSH_MODULE_DIR
+unset PDSH_RCMD_TYPE WCOLL PDSH_PROGRESS PDSH_TIMING_FILE PDSH_TRACE_FILE
+
+if test "$(id -u)" = "0"; then
+    echo >&2 "bench: must not be run as root (PDSH_MODULE_DIR is ignored)"
+    exit 1
+fi
+if ! test -x "$pdsh"; then
+    echo >&2 "bench: $pdsh not found. Please run make."
+    exit 1
+fi
+
+tmpdir=$(mktemp -d ${TMPDIR:-/tmp}/pdsh-bench.XXXXXX) || exit 1
+trap 'rm -rf $tmpdir' 0
+ln -s $pdsh $tmpdir/pdcp
+dd if=/dev/zero of=$tmpdir/file bs=1024 count=1024 2>/dev/null
+
+#  name  personality  PDSH_SIM  extra args
+scenarios="\
+connect  pdsh connect=20,lines=1
+output   pdsh lines=1000,length=80
+long     pdsh lines=10,length=65536
+rate     pdsh lines=1000,length=80,rate=400000
+stderr   pdsh lines=500,stderr=500
+fail     pdsh fail=25,connect=5
+retcode  pdsh rc=1 -S
+pdcp     pdcp lines=0
+"
+
+printf "%-8s %7s %9s %9s %11s %9s %10s %10s\n" \
+    scenario hosts elapsed hosts/s lines/s MB/s cpu maxrss
+echo "$scenarios" | while read name prog sim args; do
+    test -n "$name" || continue
+    if test -n "$BENCH_SCENARIOS"; then
+        case " $BENCH_SCENARIOS " in *" $name "*) ;; *) continue ;; esac
+    fi
+    case $prog in
+    pdsh) cmd="$pdsh" ; target="cmd" ;;
+    pdcp) cmd="$tmpdir/pdcp" ; target="$tmpdir/file /tmp" ;;
+    esac
+
+    PDSH_SIM=$sim $cmd -d -Rsim -f $fanout -w bench[1-$hosts] $args \
+        $target >$tmpdir/out 2>$tmpdir/err
+    lines=$(wc -l <$tmpdir/out)
+    bytes=$(wc -c <$tmpdir/out)
+    if test $prog = pdcp; then
+        bytes=$((hosts * 1048576))
+    fi
+
+    awk -v name=$name -v hosts=$hosts -v lines=$lines -v bytes=$bytes '
+        function secs(s) {
+            if (s ~ /us$/) return substr(s, 1, length(s) - 2) / 1e6
+            if (s ~ /ms$/) return substr(s, 1, length(s) - 2) / 1e3
+            return substr(s, 1, length(s) - 1) + 0
+        }
+        /^Elapsed:/  { elapsed = secs($2) }
+        /^CPU time:/ { cpu = secs($3) + secs($5) }
+        /^Max RSS:/  { rss = $3 }
+        END {
+            if (elapsed <= 0) elapsed = 1e-6
+            printf "%-8s %7d %8.3fs %9.0f %11.0f %9.1f %9.3fs %7d KB\n",
+                name, hosts, elapsed, hosts / elapsed, lines / elapsed,
+                bytes / elapsed / 1048576, cpu, rss
+        }' $tmpdir/err
+done
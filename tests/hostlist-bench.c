@@ -0,0 +1,146 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+/*
+ *  Time hostlist operations on large unsorted host lists.
+ *
+ *  Usage: hostlist-bench [HOSTS [SEED]]
+ *
+ *  HOSTS random hostnames (default 1000000) are drawn, with repeats,
+ *   from a few node and rack families of differing zero padding, then
+ *   pushed one at a time onto a hostlist in random order. Each
+ *   operation is then timed on a fresh copy of that list. Results are
+ *   reproducible for a given SEED apart from timing.
+ *
+ *  Parsing is timed first, for a multi-bracket expression and for a
+ *   bracketed list of HOSTS / 10 single values.
+ */
+
+#if     HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/common/hostlist.h"
+#include "src/common/err.h"
+
+static double _now (void)
+{
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+static void _random_host (char *buf, size_t len, long n)
+{
+    long r = random () % n;
+
+    switch (random () % 4) {
+    case 0:
+    case 1:
+        snprintf (buf, len, "node%ld", r);
+        break;
+    case 2:
+        snprintf (buf, len, "rack%ld-n%03ld", r % 100, r / 100 % 1000);
+        break;
+    default:
+        snprintf (buf, len, "io%06ld", r / 4);
+        break;
+    }
+}
+
+static void _time_op (const char *name, hostlist_t src,
+                      void (*op) (hostlist_t))
+{
+    char buf[256];
+    hostlist_t hl = hostlist_copy (src);
+    double t = _now ();
+
+    op (hl);
+    t = _now () - t;
+
+    hostlist_ranged_string (hl, sizeof (buf), buf);
+    printf ("%-8s %8d hosts %9.3fs  %.60s\n", name,
+            hostlist_count (hl), t, buf);
+    hostlist_destroy (hl);
+}
+
+static void _time_parse (const char *name, const char *str)
+{
+    double t = _now ();
+    hostlist_t hl = hostlist_create (str);
+
+    t = _now () - t;
+    if (hl == NULL)
+        errx ("%p: %s: failed to parse: %m\n", name);
+    printf ("%-8s %8d hosts %9.3fs\n", name, hostlist_count (hl), t);
+    hostlist_destroy (hl);
+}
+
+int main (int argc, char *argv[])
+{
+    long i, n = argc > 1 ? strtol (argv[1], NULL, 10) : 1000000;
+    unsigned int seed = argc > 2 ? strtoul (argv[2], NULL, 10) : 1;
+    char host[64];
+    hostlist_t hl;
+    char *list, *p;
+    double t;
+
+    err_init ("hostlist-bench");
+    if (n <= 0)
+        errx ("%p: invalid number of hosts\n");
+
+    _time_parse ("parse", "rack[1-200]-node[001-512]");
+
+    p = list = malloc (n + 16);
+    if (list == NULL)
+        errx ("%p: out of memory\n");
+    p += sprintf (p, "n[");
+    for (i = 1; i < n / 10; i++)
+        p += sprintf (p, "%s%ld", i > 1 ? "," : "", 2 * i);
+    sprintf (p, "]");
+    _time_parse ("parse", n / 10 > 1 ? list : "n[1]");
+    free (list);
+
+    srandom (seed);
+    hl = hostlist_create (NULL);
+    t = _now ();
+    for (i = 0; i < n; i++) {
+        _random_host (host, sizeof (host), n);
+        hostlist_push_host (hl, host);
+    }
+    printf ("%-8s %8d hosts %9.3fs\n", "push",
+            hostlist_count (hl), _now () - t);
+
+    _time_op ("uniq", hl, hostlist_uniq);
+    _time_op ("sort", hl, hostlist_sort);
+
+    hostlist_destroy (hl);
+    return (0);
+}
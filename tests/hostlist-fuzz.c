@@ -0,0 +1,239 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+/*
+ *  Check hostlist_create() against a naive expansion of random hostlist
+ *   expressions.
+ *
+ *  Usage: hostlist-fuzz [ITERATIONS [SEED]]
+ *
+ *  Each expression is a list of tokens made of literal text and up to
+ *   three bracketed range lists, sometimes with a malformed range. The
+ *   generator expands every token host by host as it goes, with the
+ *   zero padding rules of the original single bracket parser. The
+ *   hosts from hostlist_create() must match these in order. Malformed
+ *   ranges are fatal errors in pdsh, so those expressions are parsed
+ *   in a child process, which must exit with an error. Exits non-zero
+ *   on the first mismatch, printing the expression.
+ */
+
+#if     HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "src/common/hostlist.h"
+#include "src/common/err.h"
+
+#define MAXEXPR     4096
+#define MAXHOSTS    65536
+#define MAXBRACKETS 3
+
+struct range {
+    unsigned long lo, hi;
+    int width;
+};
+
+struct token {
+    char lit[MAXBRACKETS + 1][16];  /* text before each bracket, then suffix */
+    struct range r[MAXBRACKETS][4];
+    int nr[MAXBRACKETS];
+    int nbr;
+};
+
+static char expr[MAXEXPR];
+static char *hosts[MAXHOSTS];
+static int nhosts;
+
+static void _lit(char *buf, size_t len)
+{
+    const char *chars[] = { "n", "rack", "-", "x1", "0", ".ib", "a", "" };
+    snprintf(buf, len, "%s", chars[random() % 8]);
+}
+
+/*
+ *  Append the hosts of token t from bracket k onward to hosts[], where
+ *   name holds the first off characters of each hostname.
+ */
+static void _expand(struct token *t, int k, char *name, int off)
+{
+    unsigned long v;
+    int i;
+
+    if (k == t->nbr || k == MAXBRACKETS) {
+        if (nhosts == MAXHOSTS)
+            errx("%p: too many hosts\n");
+        strcpy(name + off, t->lit[k]);
+        hosts[nhosts++] = strdup(name);
+        return;
+    }
+    for (i = 0; i < t->nr[k]; i++) {
+        for (v = t->r[k][i].lo; v <= t->r[k][i].hi; v++) {
+            int n = sprintf(name + off, "%s%0*lu", t->lit[k],
+                            t->r[k][i].width, v);
+            _expand(t, k + 1, name, off + n);
+        }
+    }
+}
+
+/*
+ *  Append a random token to expr and its hosts to hosts[].
+ *   Returns 0, or -1 if the token is malformed.
+ */
+static int _token(void)
+{
+    struct token t;
+    char name[256];
+    char *p = expr + strlen(expr);
+    int bad = 0;
+    int i, j;
+
+    memset(&t, 0, sizeof(t));
+    t.nbr = random() % (MAXBRACKETS + 1);
+    for (i = 0; i < t.nbr; i++) {
+        _lit(t.lit[i], sizeof(t.lit[i]));
+        p += sprintf(p, "%s[", t.lit[i]);
+        t.nr[i] = 1 + random() % 3;
+        for (j = 0; j < t.nr[i]; j++) {
+            struct range *r = &t.r[i][j];
+            r->width = random() % 4;
+            r->lo = random() % 120;
+            r->hi = r->lo + random() % 5;
+            if (random() % 200 == 0) {
+                p += sprintf(p, "%s%lu-x", j ? "," : "", r->lo);
+                bad = 1;
+                continue;
+            }
+            if (random() % 200 == 0) {
+                p += sprintf(p, "%s%lu-%lu", j ? "," : "", r->hi + 1, r->lo);
+                bad = 1;
+                continue;
+            }
+            /*
+             *  The width of a range is the number of digits in its
+             *   lower bound as written
+             */
+            p += sprintf(p, "%s%0*lu", j ? "," : "", r->width, r->lo);
+            if (r->width < (int) snprintf(NULL, 0, "%lu", r->lo))
+                r->width = snprintf(NULL, 0, "%lu", r->lo);
+            if (r->hi != r->lo || random() % 2)
+                p += sprintf(p, "-%lu", r->hi);
+        }
+        p += sprintf(p, "]");
+    }
+    _lit(t.lit[t.nbr], sizeof(t.lit[t.nbr]));
+    if (t.nbr == 0 && t.lit[0][0] == '\0')
+        strcpy(t.lit[0], "host");
+    p += sprintf(p, "%s", t.lit[t.nbr]);
+
+    if (!bad)
+        _expand(&t, 0, name, 0);
+    return bad ? -1 : 0;
+}
+
+/*
+ *  Return 1 if hostlist_create() of a malformed expr fails
+ */
+static int _rejected(void)
+{
+    pid_t pid;
+    int status;
+
+    if ((pid = fork()) < 0)
+        errx("%p: fork: %m\n");
+    if (pid == 0) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDERR_FILENO);
+        _exit(hostlist_create(expr) ? 0 : 1);
+    }
+    if (waitpid(pid, &status, 0) < 0)
+        errx("%p: waitpid: %m\n");
+    return (!WIFEXITED(status) || WEXITSTATUS(status) != 0);
+}
+
+static void _clear(void)
+{
+    while (nhosts > 0)
+        free(hosts[--nhosts]);
+    expr[0] = '\0';
+}
+
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 10000;
+    unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+    long i;
+
+    err_init("hostlist-fuzz");
+    srandom(seed);
+
+    for (i = 0; i < iterations; i++) {
+        hostlist_iterator_t itr;
+        hostlist_t hl;
+        char *host;
+        int n, j, bad = 0;
+
+        _clear();
+        n = 1 + random() % 4;
+        for (j = 0; j < n; j++) {
+            if (j)
+                strcat(expr, ",");
+            if (_token() < 0)
+                bad = 1;
+        }
+
+        if (bad) {
+            if (!_rejected())
+                errx("%p: \"%s\": malformed expression accepted\n", expr);
+            continue;
+        }
+        if ((hl = hostlist_create(expr)) == NULL)
+            errx("%p: \"%s\": rejected: %m\n", expr);
+        if (hostlist_count(hl) != nhosts)
+            errx("%p: \"%s\": %d hosts, expected %d\n", expr,
+                 hostlist_count(hl), nhosts);
+
+        itr = hostlist_iterator_create(hl);
+        for (j = 0; (host = hostlist_next(itr)); j++) {
+            if (strcmp(host, hosts[j]) != 0)
+                errx("%p: \"%s\": host %d is %s, expected %s\n", expr, j,
+                     host, hosts[j]);
+            free(host);
+        }
+        hostlist_iterator_destroy(itr);
+        hostlist_destroy(hl);
+    }
+    _clear();
+    printf("hostlist-fuzz: %ld expressions OK\n", iterations);
+    return (0);
+}
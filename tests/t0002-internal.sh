@@ -12,4 +12,40 @@ test_expect_success 'working xstrerrorcat' '
 test_expect_success 'working pipecmd' '
 	pdsh -T1
 '
+test_expect_success 'cbuf line scanning' '
+	pdsh -T2 >output &&
+	grep PASS output
+'
+test_expect_success 'working xpollset' '
+	pdsh -T3 >output &&
+	grep PASS output
+'
+test_expect_success 'histogram percentiles' '
+	pdsh -T4 >output &&
+	grep PASS output
+'
+test_expect_success 'hostlist set operations' '
+	pdsh -T5 >output &&
+	grep PASS output
+'
+test_expect_success 'hostset membership' '
+	pdsh -T6 >output &&
+	grep PASS output
+'
+test_expect_success 'hostlist_next_r' '
+	pdsh -T7 >output &&
+	grep PASS output
+'
+test_expect_success 'hostlist_split' '
+	pdsh -T8 >output &&
+	grep PASS output
+'
+test_expect_success 'hostlist_uniq and hostlist_sort' '
+	pdsh -T9 >output &&
+	grep PASS output
+'
+test_expect_success 'frozen hostlist' '
+	pdsh -T10 >output &&
+	grep PASS output
+'
 test_done
@@ -43,6 +43,12 @@ test_expect_success 'pdsh -x option works with non-numeric suffix (gnats:120)' '
                         "foo0,foo1,foo3,foo4,foo5" \
                         "-x fooj,fooi,foo2"
 '
+test_expect_success 'pdsh -x matches hosts regardless of bracket placement' '
+	test_pdsh_wcoll "foo[01-12]" "foo01,foo10,foo11,foo12" "-x foo0[2-9]"
+'
+test_expect_success 'pdsh -x preserves order of remaining hosts' '
+	test_pdsh_wcoll "foo7,bar,foo[1-3],baz" "foo7,foo1,foo3,baz" "-x bar,foo2"
+'
 test_expect_success 'pdsh -w- reads from stdin' '
 	echo "foo1,foo2,foo3" | test_pdsh_wcoll "-" "foo1,foo2,foo3"
 '
@@ -107,6 +113,18 @@ test_expect_success 'regex exclusion works' '
 test_expect_success 'regex exclusion works from -x' '
 	test_pdsh_wcoll "foo[0-20]" "foo0,foo10,foo20" "-x/[1-9]$/"
 '
+test_expect_success 'glob filtering works' '
+	test_pdsh_wcoll "foo[0-20],bar[1-3],*0" "foo0,foo10,foo20"
+'
+test_expect_success 'glob exclusion works' '
+	test_pdsh_wcoll "foo[0-12],-foo?" "foo10,foo11,foo12"
+'
+test_expect_success 'glob exclusion works from -x' '
+	test_pdsh_wcoll "foo[0-20],bar[1-3]" "bar1,bar2,bar3" "-xfoo*"
+'
+test_expect_success 'regex and glob filters combine' '
+	test_pdsh_wcoll "foo[0-20],bar[1-3]" "foo11,foo12,foo13,foo14,foo15" "-w/1[1-5]$/,f*"
+'
 test_expect_success 'multiple -w options' '
 	test_pdsh_wcoll "foo[0-20]" "foo0,foo10,foo20" "-w-/[1-9]$/" &&
 	test_pdsh_wcoll "foo8" "foo8,foo9,foo10,foo11,foo12" "-w^wcoll" &&
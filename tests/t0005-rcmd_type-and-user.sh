@@ -14,6 +14,14 @@ test_expect_success 'user@hosts works for a subset of hosts' '
 	pdsh -S -Rexec -w u1@foo,u2@bar sh -c \
 		"if test %h = foo; then test %u = u1; else test %u = u2; fi"
 '
+test_expect_success 'first user@hosts registered for a host wins' '
+	pdsh -S -Rexec -w u1@foo[1-2],u2@foo[2-3] sh -c \
+		"if test %h = foo3; then test %u = u2; else test %u = u1; fi"
+'
+test_expect_success 'user@hosts works for many hosts' '
+	pdsh -S -Rexec -w u1@foo[1-1000],u2@bar[1-1000] sh -c \
+		"case %h in foo*) test %u = u1;; *) test %u = u2;; esac"
+'
 test_expect_success 'Can set rcmd_type via rcmd_type:hosts' '
     PDSH_RCMD_TYPE=ssh
 	pdsh -S -w exec:foo[1-10] true
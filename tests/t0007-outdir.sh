@@ -0,0 +1,56 @@
+#!/bin/sh
+
+test_description='pdsh -o per-host output files'
+
+. ${srcdir:-.}/test-lib.sh
+
+if ! test_have_prereq MOD_RCMD_EXEC; then
+	skip_all='skipping -o tests, exec module not available'
+	test_done
+fi
+
+test_expect_success 'pdsh -o writes stdout of each host to a file' '
+	pdsh -Rexec -w foo[1-3] -o out echo %h > output &&
+	test ! -s output &&
+	for h in foo1 foo2 foo3; do
+		echo $h > expected.$h &&
+		test_cmp expected.$h out/$h
+	done
+'
+test_expect_success 'pdsh -o writes stderr to host.err' '
+	pdsh -Rexec -w foo -o err sh -c "echo out; echo error >&2" &&
+	echo out > expected.out &&
+	echo error > expected.err &&
+	test_cmp expected.out err/foo &&
+	test_cmp expected.err err/foo.err
+'
+test_expect_success 'pdsh -o does not create files for empty streams' '
+	pdsh -Rexec -w foo -o empty true &&
+	test ! -e empty/foo &&
+	test ! -e empty/foo.err
+'
+test_expect_success 'pdsh -o truncates existing files' '
+	mkdir -p trunc &&
+	seq 1 100 > trunc/foo &&
+	pdsh -Rexec -w foo -o trunc echo hi &&
+	echo hi > expected.trunc &&
+	test_cmp expected.trunc trunc/foo
+'
+test_expect_success 'pdsh -o handles output with no trailing newline' '
+	perl -e "print \"a\" x 100000" > 100K &&
+	pdsh -Rexec -w foo -o nonl cat 100K &&
+	test_cmp 100K nonl/foo
+'
+test_expect_success 'pdsh -o works with more hosts than open files' '
+	seq 1 5000 > lines &&
+	PDSH_OUTDIR_MAX_FILES=2 pdsh -Rexec -f 8 -w foo[1-20] -o lru \
+		sh -c "seq 1 2500; sleep 1; seq 2501 5000" &&
+	for i in $(seq 1 20); do
+		test_cmp lines lru/foo$i || return 1
+	done
+'
+test_expect_success 'pdsh -o fails if dir is not a directory' '
+	touch notadir &&
+	test_must_fail pdsh -Rexec -w foo -o notadir echo hi
+'
+test_done
@@ -0,0 +1,88 @@
+#!/bin/sh
+
+test_description='pdsh -O json output format'
+
+. ${srcdir:-.}/test-lib.sh
+
+if ! test_have_prereq MOD_RCMD_EXEC; then
+	skip_all='skipping -O json tests, exec module not available'
+	test_done
+fi
+
+#
+#  Remove timestamps and durations, which vary from run to run
+#
+strip_time() {
+	sed -e 's/,"time":[0-9]*\.[0-9]*//' \
+	    -e 's/,"connect_time":[0-9.]*,"command_time":[0-9.]*//'
+}
+
+test_expect_success 'pdsh -O json writes output records' '
+	pdsh -Rexec -w foo -O json echo hello | strip_time > output &&
+	cat >expected <<-\EOF &&
+	{"type":"output","host":"foo","stream":"stdout","line":"hello"}
+	{"type":"exit","host":"foo","status":"done","rc":0}
+	EOF
+	test_cmp expected output
+'
+test_expect_success 'pdsh -O json writes stderr records to stdout' '
+	pdsh -Rexec -w foo -O json sh -c "echo oops >&2" 2>stderr \
+		| strip_time | grep output > output &&
+	test ! -s stderr &&
+	echo "{\"type\":\"output\",\"host\":\"foo\",\"stream\":\"stderr\",\"line\":\"oops\"}" >expected &&
+	test_cmp expected output
+'
+test_expect_success 'pdsh -O json escapes special characters' '
+	printf "a\"b\\\\c\td\001\n" > special &&
+	pdsh -Rexec -w foo -O json cat special | strip_time | grep output > output &&
+	cat >expected <<-\EOF &&
+	{"type":"output","host":"foo","stream":"stdout","line":"a\"b\\c\td\u0001"}
+	EOF
+	test_cmp expected output
+'
+test_expect_success 'pdsh -O json replaces invalid UTF-8' '
+	printf "a\303\251b\377c\355\240\200d\303\n" > utf8 &&
+	pdsh -Rexec -w foo -O json cat utf8 \
+		| sed -n -e "s/.*\"line\":\"\(.*\)\"}$/\1/p" > output &&
+	r="\\ufffd" &&
+	printf "a\303\251b%sc%s%s%sd%s\n" $r $r $r $r $r >expected &&
+	test_cmp expected output
+'
+test_expect_success 'pdsh -O json does not split characters of long lines' '
+	awk "BEGIN { for (i = 0; i < 3000; i++) printf \"a\303\251\342\202\254\"; print \"\" }" \
+		> long &&
+	PDSH_HOST_BUFFER_SIZE=1K pdsh -Rexec -w foo -O json cat long \
+		| grep "\"output\"" > output &&
+	test $(wc -l < output) -gt 1 &&
+	test_must_fail grep -F "\\ufffd" output &&
+	sed -n -e "s/.*\"line\":\"\([^\"]*\)\".*/\1/p" output | tr -d "\n" > joined &&
+	echo >> joined &&
+	test_cmp long joined
+'
+test_expect_success 'pdsh -O json marks output with no newline partial' '
+	pdsh -Rexec -w foo -O json printf abc | strip_time | grep output > output &&
+	cat >expected <<-\EOF &&
+	{"type":"output","host":"foo","stream":"stdout","line":"abc","partial":true}
+	EOF
+	test_cmp expected output
+'
+test_expect_success 'pdsh -O json reports exit code in exit record' '
+	pdsh -Rexec -w foo -O json sh -c "exit 3" | strip_time > output &&
+	grep "\"type\":\"exit\",\"host\":\"foo\",\"status\":\"done\",\"rc\":3}" output
+'
+test_expect_success 'pdsh -O json reports sub-second times' '
+	pdsh -Rexec -w foo -O json sleep 0.2 | grep exit > output &&
+	grep "\"command_time\":0\.[1-9][0-9]*}" output
+'
+test_expect_success 'pdsh -O json writes one exit record per host' '
+	pdsh -Rexec -w foo[1-10] -O json echo hi > output &&
+	test $(grep -c "\"type\":\"exit\"" output) -eq 10 &&
+	test $(grep -c "\"type\":\"output\"" output) -eq 10
+'
+test_expect_success 'pdsh -O rejects unknown formats' '
+	test_must_fail pdsh -Rexec -w foo -O xml echo hi
+'
+test_expect_success 'pdsh -O json cannot be used with -o' '
+	test_must_fail pdsh -Rexec -w foo -O json -o dir echo hi
+'
+test_done
@@ -0,0 +1,105 @@
+#!/bin/sh
+
+test_description='pdsh -B host-ordered output'
+
+. ${srcdir:-.}/test-lib.sh
+
+if ! test_have_prereq MOD_RCMD_EXEC; then
+	skip_all='skipping -B tests, exec module not available'
+	test_done
+fi
+
+#
+#  Each host prints a few lines with pauses in between, later hosts
+#   finishing first, so unordered output would interleave.
+#
+cmd='for i in 1 2 3; do echo %h $i; sleep 0.$((3-%n)); done'
+
+expected_lines() {
+	for h in "$@"; do
+		for i in 1 2 3; do echo "$h: $h $i"; done
+	done
+}
+
+test_expect_success '-B host groups output in target list order' '
+	expected_lines foo0 foo1 foo2 foo3 > expected &&
+	pdsh -B host -w foo[0-3] -Rexec sh -c "$cmd" > output &&
+	test_cmp expected output
+'
+test_expect_success '-B completion groups output in completion order' '
+	expected_lines foo3 foo2 foo1 > expected &&
+	pdsh -B completion -w foo[1-3] -Rexec sh -c "sleep 0.\$((3-%n))5; $cmd" \
+	    > output &&
+	test_cmp expected output
+'
+test_expect_success '-B host streams output of the first host' '
+	pdsh -B host -w foo[0-1] -Rexec \
+	    sh -c "echo %h; test %n -eq 0 && sleep 2; echo done" > output &
+	sleep 1 &&
+	echo "foo0: foo0" > expected &&
+	test_cmp expected output &&
+	wait
+'
+test_expect_success '-B host keeps hosts apart when fanout slots are reused' '
+	pdsh -B host -f 2 -w foo[0-3] -Rexec sh -c "echo %h a; \
+	    case %n in 0) sleep 0.4;; 2) sleep 1; echo %h b;; esac" > output &&
+	printf "foo0: foo0 a\nfoo1: foo1 a\nfoo2: foo2 a\nfoo2: foo2 b\nfoo3: foo3 a\n" \
+	    > expected &&
+	test_cmp expected output
+'
+test_expect_success '-B completion streams each host with fanout 1' '
+	pdsh -B completion -f 1 -w foo[0-2] -Rexec \
+	    sh -c "echo %h; test %n -eq 2 && sleep 2; echo done" > output &
+	sleep 1 &&
+	printf "foo0: foo0\nfoo0: done\nfoo1: foo1\nfoo1: done\n" > expected &&
+	test_cmp expected output &&
+	wait
+'
+test_expect_success '-B host keeps stderr with its host' '
+	pdsh -B host -w foo[0-2] -Rexec \
+	    sh -c "echo %h >&2; sleep 0.\$((2-%n))" 2> output &&
+	printf "foo0: foo0\nfoo1: foo1\nfoo2: foo2\n" > expected &&
+	test_cmp expected output
+'
+test_expect_success 'PDSH_ORDER_MEMORY_LIMIT spills output to temporary files' '
+	for h in foo0 foo1 foo2; do
+		seq 1 20000 | sed "s/^/$h: /"
+	done > expected &&
+	PDSH_ORDER_MEMORY_LIMIT=1K pdsh -B host -w foo[0-2] -Rexec \
+	    sh -c "sleep 0.\$((2-%n)); seq 1 20000" > output &&
+	test_cmp expected output
+'
+test_expect_success 'PDSH_ORDER_MEMORY_LIMIT spills many hosts with few open files' '
+	for i in $(seq 1 200); do
+		seq 1 100 | sed "s/^/foo$i: /"
+	done > expected &&
+	(
+		ulimit -n 64 &&
+		PDSH_ORDER_MEMORY_LIMIT=1K pdsh -B host -f 4 -w foo[1-200] -Rexec \
+		    sh -c "if [ %h = foo1 ]; then sleep 1; fi; seq 1 100"
+	) > output 2> errors &&
+	test_cmp expected output &&
+	test ! -s errors
+'
+test_expect_success '-B writes all output and fails if it cannot spill' '
+	for i in $(seq 1 20); do
+		seq 1 100 | sed "s/^/foo$i: /"
+	done | sort > expected &&
+	(
+		trap "" XFSZ &&
+		(
+			ulimit -f 1 &&
+			PDSH_ORDER_MEMORY_LIMIT=1K pdsh -B host -w foo[1-20] -Rexec \
+			    sh -c "if [ %h = foo1 ]; then sleep 1; fi; seq 1 100"
+			echo $? > rc
+		) | sort > output
+	) 2> errors &&
+	test_cmp expected output &&
+	test "$(cat rc)" = 1 &&
+	grep "out of order" errors
+'
+test_expect_success '-B rejects invalid order and -O json' '
+	test_must_fail pdsh -B foo -w foo -Rexec true &&
+	test_must_fail pdsh -B host -O json -w foo -Rexec true
+'
+test_done
@@ -0,0 +1,47 @@
+#!/bin/sh
+
+test_description='hostlist expression parsing'
+
+. ${srcdir:-.}/test-lib.sh
+
+test_expect_success 'multiple brackets expand to all combinations' '
+	pdsh -Q -w rack[1-2]-n[01-03] | tail -1 | tr , "\n" >output &&
+	cat >expected <<-EOF &&
+	rack1-n01
+	rack1-n02
+	rack1-n03
+	rack2-n01
+	rack2-n02
+	rack2-n03
+	EOF
+	test_cmp expected output
+'
+test_expect_success 'text after the last bracket is kept' '
+	pdsh -Q -w a[1-2]b[3,5].ib | tail -1 >output &&
+	echo "a1b3.ib,a1b5.ib,a2b3.ib,a2b5.ib" >expected &&
+	test_cmp expected output
+'
+test_expect_success 'large multi-bracket expression' '
+	pdsh -q -w rack[1-200]-node[001-512] \
+		-x rack[2-200]-node[001-512],rack1-node[002-511] \
+		| tail -1 >output &&
+	echo "rack1-node[001,512]" >expected &&
+	test_cmp expected output
+'
+#  n1,n3,n5,...,n24001
+odd=$(awk 'BEGIN { for (i = 1; i <= 24001; i += 2) printf "%s%d", (i > 1 ? "," : ""), i }')
+
+test_expect_success 'more than 10240 ranges in one bracket' '
+	pdsh -q -w "n[$odd]" -x n[3-16000],n[16001-23999] \
+		| tail -1 >output &&
+	echo "n[1,24001]" >expected &&
+	test_cmp expected output
+'
+test_expect_success 'malformed range is rejected' '
+	test_must_fail pdsh -Q -w rack[1-2]-n[3-1] 2>err &&
+	grep "Invalid range" err
+'
+test_expect_success 'parser matches naive expansion of random expressions' '
+	$PDSH_BUILD_DIR/tests/hostlist-fuzz 5000
+'
+test_done
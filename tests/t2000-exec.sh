@@ -38,4 +38,80 @@ test_expect_success 'exec cmd susbstitution works interactive mode' '
 test_debug '
 	echo Output: $OUTPUT
 '
+test_expect_success 'exec module returns exit status with -S' '
+	test_expect_code 7 pdsh -S -Rexec -w foo sh -c "exit 7"
+'
+test_expect_success 'exec module returns signal as 128+signo with -S' '
+	test_expect_code 137 pdsh -S -Rexec -w foo sh -c "kill -9 \$\$"
+'
+test_expect_success 'pdsh -k does not mistake exit status 255 for a signal' '
+	test_must_fail pdsh -k -Rexec -w foo sh -c "exit 255" 2>err &&
+	test_must_fail grep "killed by signal" err
+'
+test_expect_success 'pdsh -k reports a command killed by a signal' '
+	test_must_fail pdsh -k -Rexec -w foo sh -c "kill -9 \$\$" 2>err &&
+	grep "killed by signal 9" err
+'
+test_expect_success 'pdsh -S returns largest exit status with small fanout' '
+	test_expect_code 9 pdsh -S -Rexec -f 2 -w foo[0-9] sh -c "exit %n"
+'
+test_expect_success 'all hosts run when there are more hosts than fanout' '
+	pdsh -Rexec -f 3 -w foo[1-50] echo %h >output &&
+	test "$(sort -u output | wc -l)" = 50
+'
+test_expect_success 'pdsh -S does not alter output containing RC_MAGIC' '
+	OUTPUT=$(pdsh -S -Rexec -w foo echo XXRETCODE:5) &&
+	test "$OUTPUT" = "foo: XXRETCODE:5"
+'
+test_debug '
+	echo Output: $OUTPUT
+'
+test_expect_success 'pdsh -S works in interactive mode' '
+	echo "echo hi" | pdsh -S -Rexec -w foo > output &&
+	grep "foo: hi" output &&
+	! grep XXRETCODE output
+'
+test_expect_success 'pdsh -S output with no trailing newline is intact' '
+	OUTPUT=$(pdsh -N -S -Rexec -w foo printf abc) &&
+	test "$OUTPUT" = "abc"
+'
+test_expect_success 'large output is read intact across many reads' '
+	seq 1 100000 | sed "s/^/foo: /" > expected.seq &&
+	pdsh -d -Rexec -w foo seq 1 100000 > output.seq 2> debug.seq &&
+	test_cmp expected.seq output.seq &&
+	grep "^Output I/O:" debug.seq
+'
+test_expect_success 'PDSH_PROGRESS writes a final status line' '
+	PDSH_PROGRESS=3 pdsh -Rexec -w foo[1-3] echo hi >output 3>progress &&
+	test "$(wc -l < output)" = 3 &&
+	grep "^pdsh: 3/3 done, 0 failed | 0 pending, 0 connecting, 0 running" progress &&
+	grep "connect p50 .* p99 .* | command p50 .* p99 " progress
+'
+test_expect_success 'pdsh -d reports phase timing percentiles' '
+	pdsh -d -Rexec -w foo[1-3] true 2>debug &&
+	grep "^Connect: *Avg: .* p50: .* p90: .* p99: .* p999: .* (3 hosts)" debug &&
+	grep "^Total: *Avg: " debug
+'
+test_expect_success 'PDSH_TIMING_FILE writes per-host timings' '
+	PDSH_TIMING_FILE=timing pdsh -Rexec -w foo[1-3] echo hi >output &&
+	head -1 timing | grep "^#host	state	rc	create	start	resolved	connected	first_byte	last_byte	reaped$" &&
+	test "$(grep -c "^foo[1-3]	done	0	[0-9]" timing)" = 3
+'
+test_expect_success 'PDSH_TIMING_FILE includes every host with small fanout' '
+	PDSH_TIMING_FILE=timing pdsh -Rexec -f 2 -w foo[1-9] true &&
+	test "$(grep -c "^foo[1-9]	done	0	[0-9]" timing)" = 9
+'
+test_expect_success 'PDSH_TRACE_FILE writes a trace-event timeline' '
+	PDSH_TRACE_FILE=trace.json pdsh -Rexec -f 1 -w foo[1-3] echo hi >output &&
+	head -1 trace.json | grep "^{\"displayTimeUnit\":\"ms\",\"traceEvents\":\[$" &&
+	tail -1 trace.json | grep "^\]}$" &&
+	grep "\"name\":\"thread_name\",\"args\":{\"name\":\"foo3\"}" trace.json &&
+	test "$(grep -c "\"cat\":\"host\",\"name\":\"done\"" trace.json)" = 3 &&
+	grep "\"cat\":\"output\",\"name\":\"stdout\".*\"args\":{\"bytes\":3}" trace.json &&
+	grep "\"name\":\"fanout wait\"" trace.json
+'
+test_expect_success 'PDSH_PROGRESS rejects an invalid descriptor' '
+	test_must_fail env PDSH_PROGRESS=foo pdsh -Rexec -w foo echo hi &&
+	test_must_fail env PDSH_PROGRESS=9 pdsh -Rexec -w foo echo hi 9>&-
+'
 test_done
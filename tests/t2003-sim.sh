@@ -0,0 +1,55 @@
+#!/bin/sh
+
+test_description='pdsh simulated rcmd module (used by "make bench")'
+
+. ${srcdir:-.}/test-lib.sh
+
+#  The sim module is a test module loaded via PDSH_MODULE_DIR
+PDSH_MODULE_DIR=$PDSH_BUILD_DIR/tests/test-modules/.libs
+export PDSH_MODULE_DIR
+
+test_expect_success NOTROOT 'sim module loads' '
+	pdsh -L 2>&1 | grep -q "^Module: rcmd/sim"
+'
+test_expect_success NOTROOT 'sim module generates configured output' '
+	PDSH_SIM=lines=3,length=20 pdsh -Rsim -w host[1-4] x >output &&
+	test $(grep -c "^host[1-4]: " output) -eq 12 &&
+	test $(grep -c "^host2: " output) -eq 3
+'
+test_expect_success NOTROOT 'sim module generates stderr' '
+	PDSH_SIM=lines=0,stderr=2 pdsh -Rsim -w host[1-3] x 2>output &&
+	test $(grep -c "^host[1-3]: " output) -eq 6
+'
+test_expect_success NOTROOT 'sim module fails a fixed set of hosts' '
+	PDSH_SIM=fail=50 pdsh -Rsim -w host[0-99] x 2>&1 >/dev/null \
+		| grep "connection refused" | sort >err1 &&
+	test $(wc -l <err1) -eq 50 &&
+	PDSH_SIM=fail=50 pdsh -Rsim -w host[0-99] x 2>&1 >/dev/null \
+		| grep "connection refused" | sort >err2 &&
+	test_cmp err1 err2
+'
+test_expect_success NOTROOT 'sim module returns exit code via -S' '
+	PDSH_SIM=rc=3 pdsh -S -Rsim -w host[1-2] x >output
+	test $? = 3 &&
+	test_must_fail grep XXRETCODE output
+'
+test_expect_success NOTROOT 'sim module reports exit code with -O json' '
+	PDSH_SIM=rc=3,lines=1 pdsh -O json -Rsim -w host[1-2] x >output &&
+	test $(grep -c "\"status\":\"done\",\"rc\":3," output) -eq 2 &&
+	test_must_fail grep XXRETCODE output
+'
+test_expect_success NOTROOT 'sim module rejects bad PDSH_SIM' '
+	PDSH_SIM=lines=foo test_must_fail pdsh -Rsim -w host1 x 2>err &&
+	grep "invalid value" err
+'
+test_expect_success NOTROOT 'pdcp to sim module' '
+	ln -s $PDSH_BUILD_DIR/src/pdsh/pdsh pdcp &&
+	dd if=/dev/zero of=file bs=1024 count=256 2>/dev/null &&
+	./pdcp -Rsim -w host[1-10] file /tmp/file
+'
+test_expect_success NOTROOT 'pdsh -d reports resource usage' '
+	PDSH_SIM=lines=1 pdsh -d -Rsim -w host1 x 2>&1 >/dev/null \
+		| grep -q "^Max RSS:"
+'
+
+test_done
@@ -27,5 +27,37 @@ test_expect_success 'pdsh does not truncate even longer lines' "
 	pdsh -w foo -N -Rexec cat testfile2 > output2 &&
 	test_cmp testfile2 output2
 "
+test_expect_success 'PDSH_HOST_BUFFER_SIZE allows lines longer than 128K' "
+	dd if=/dev/urandom bs=1024 count=300 | $base64 | tr -d '\n' > testfile3 &&
+	echo >>testfile3 &&
+	PDSH_HOST_BUFFER_SIZE=1M pdsh -w foo -N -Rexec cat testfile3 > output3 &&
+	test_cmp testfile3 output3
+"
+test_expect_success 'lines longer than the host buffer are not truncated' "
+	PDSH_HOST_BUFFER_SIZE=1K pdsh -w foo -N -Rexec cat testfile3 > output5 &&
+	test_cmp testfile3 output5 &&
+	pdsh -w foo -N -Rexec cat testfile3 > output6 &&
+	test_cmp testfile3 output6
+"
+test_expect_success 'long lines split across reads are labeled once' '
+	PDSH_HOST_BUFFER_SIZE=1K pdsh -w foo -Rexec \
+	    sh -c "printf %05000d 0; echo; printf %05000d 1 >&2; echo >&2" \
+	    > output7 2> error7 &&
+	test $(wc -c < output7) -eq 5006 &&
+	test $(grep -c "foo" output7) -eq 1 &&
+	test $(wc -c < error7) -eq 5006 &&
+	test $(grep -c "foo" error7) -eq 1
+'
+test_expect_success 'invalid PDSH_HOST_BUFFER_SIZE is rejected' '
+	test_must_fail env PDSH_HOST_BUFFER_SIZE=1X pdsh -w foo -Rexec true &&
+	test_must_fail env PDSH_HOST_BUFFER_SIZE=10 pdsh -w foo -Rexec true &&
+	test_must_fail env PDSH_HOST_BUFFER_SIZE=17179869185G pdsh -w foo -Rexec true
+'
+test_expect_success 'PDSH_OUTPUT_MEMORY_LIMIT does not deadlock partial lines' '
+	PDSH_OUTPUT_MEMORY_LIMIT=1 pdsh -f 10 -w foo[0-19] -Rexec \
+	    sh -c "printf %s- start; sleep 0.2; echo end" | sort > output4 &&
+	for i in $(seq 0 19); do echo "foo$i: start-end"; done | sort > expected4 &&
+	test_cmp expected4 output4
+'
 
 test_done
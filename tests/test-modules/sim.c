@@ -0,0 +1,410 @@
+/*****************************************************************************\
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2007-2011 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2006 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  UCRL-CODE-2003-005.
+ *
+ *  This file is part of Pdsh, a parallel remote shell program.
+ *  For details, see <http://www.llnl.gov/linux/pdsh/>.
+ *
+ *  Pdsh is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Pdsh is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Pdsh; if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+\*****************************************************************************/
+
+/*
+ *  Simulated rcmd module for benchmarking pdsh and pdcp without a
+ *   cluster. Each "host" is served by a thread inside pdsh connected
+ *   through a socketpair, so many thousands of hosts can be emulated
+ *   on one machine and runs are reproducible.
+ *
+ *  Behavior is set by PDSH_SIM, a comma separated list of key=value:
+ *
+ *   connect=MS   connect latency in milliseconds (default 0)
+ *   lines=N      lines of stdout per host (default 10)
+ *   length=N     length of each line including newline (default 80)
+ *   stderr=N     lines of stderr per host (default 0)
+ *   rate=N       output bytes per second per host, 0 = no limit (default)
+ *   rc=N         remote exit code (default 0)
+ *   fail=PCT     percent of hosts whose connection fails (default 0).
+ *                Failing hosts are chosen from the host rank, so the
+ *                same hosts fail on every run.
+ *
+ *  For pdcp, file data is read and discarded following the rcp protocol.
+ *
+ *  The module does not collect exit status itself, so "pdsh -S" uses
+ *   the return code trailer path; a trailer is emitted when the command
+ *   asks for one.
+ */
+
+#if     HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/pdsh/opt.h"
+#include "src/pdsh/mod.h"
+#include "src/pdsh/rcmd.h"
+#include "src/common/err.h"
+#include "src/common/xmalloc.h"
+
+#define SIM_CHUNK   (64 * 1024)
+
+int pdsh_module_priority = DEFAULT_MODULE_PRIORITY;
+
+static int sim_init(opt_t *);
+static int sim_signal(int, void *arg, int);
+static int sim(char *, char *, char *, char *, char *, int, int *, void **);
+static int sim_destroy (void *arg);
+
+struct pdsh_module_operations sim_module_ops = {
+    (ModInitF)       NULL,
+    (ModExitF)       NULL,
+    (ModReadWcollF)  NULL,
+    (ModPostOpF)     NULL
+};
+
+struct pdsh_rcmd_operations sim_rcmd_ops = {
+    (RcmdInitF)    sim_init,
+    (RcmdSigF)     sim_signal,
+    (RcmdF)        sim,
+    (RcmdDestroyF) sim_destroy
+};
+
+struct pdsh_module_option sim_module_options[] =
+ {
+   PDSH_OPT_TABLE_END
+ };
+
+struct pdsh_module pdsh_module_info = {
+  "rcmd",
+  "sim",
+  "Mark Grondona <mgrondona@llnl.gov>",
+  "Simulated hosts for benchmarking (see PDSH_SIM)",
+  DSH | PCP,
+  &sim_module_ops,
+  &sim_rcmd_ops,
+  &sim_module_options[0],
+};
+
+static struct sim_config {
+    long connect;
+    long lines;
+    long length;
+    long errlines;
+    long rate;
+    int rc;
+    int fail;
+} conf = { 0, 10, 80, 0, 0, 0, 0 };
+
+struct sim_host {
+    pthread_t thread;
+    int fd;                 /* our end of the stdout socket */
+    int efd;                /* our end of the stderr socket, or -1 */
+    bool pcp;               /* act as a pdcp server */
+    bool trailer;           /* command asked for a return code trailer */
+    volatile int killed;    /* signaled by pdsh */
+};
+
+static void _sleep_ms (long ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    while (nanosleep (&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+static double _now (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static void _parse_config (const char *str)
+{
+    char *copy = Strdup (str);
+    char *tok, *save = NULL;
+
+    for (tok = strtok_r (copy, ",", &save); tok;
+         tok = strtok_r (NULL, ",", &save)) {
+        char *val = strchr (tok, '=');
+        char *end;
+        long n;
+
+        if (!val)
+            errx ("%p: PDSH_SIM: missing value for \"%s\"\n", tok);
+        *val++ = '\0';
+        n = strtol (val, &end, 10);
+        if (*val == '\0' || *end != '\0' || n < 0)
+            errx ("%p: PDSH_SIM: invalid value for %s: \"%s\"\n", tok, val);
+
+        if (strcmp (tok, "connect") == 0)
+            conf.connect = n;
+        else if (strcmp (tok, "lines") == 0)
+            conf.lines = n;
+        else if (strcmp (tok, "length") == 0 && n > 0)
+            conf.length = n;
+        else if (strcmp (tok, "stderr") == 0)
+            conf.errlines = n;
+        else if (strcmp (tok, "rate") == 0)
+            conf.rate = n;
+        else if (strcmp (tok, "rc") == 0)
+            conf.rc = n;
+        else if (strcmp (tok, "fail") == 0 && n <= 100)
+            conf.fail = n;
+        else
+            errx ("%p: PDSH_SIM: invalid setting \"%s=%s\"\n", tok, val);
+    }
+    Free ((void **) &copy);
+}
+
+static int sim_init(opt_t * opt)
+{
+    char *str;
+
+    if ((str = getenv ("PDSH_SIM")))
+        _parse_config (str);
+
+    if (rcmd_opt_set (RCMD_OPT_RESOLVE_HOSTS, 0) < 0)
+        errx ("%p: sim_init: rcmd_opt_set: %m\n");
+
+    return 0;
+}
+
+static int sim_signal(int fd, void *arg, int signum)
+{
+    if (arg)
+        ((struct sim_host *) arg)->killed = 1;
+    return 0;
+}
+
+static int _send (struct sim_host *h, int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0 && !h->killed) {
+        if ((n = send (fd, buf, len, MSG_NOSIGNAL)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return (-1);
+        }
+        buf += n;
+        len -= n;
+    }
+    return (h->killed ? -1 : 0);
+}
+
+/*
+ *  Write [nlines] lines of [conf.length] bytes to [fd], at no more than
+ *   conf.rate bytes per second if a rate is set.
+ */
+static int _send_lines (struct sim_host *h, int fd, long nlines)
+{
+    long per_chunk = conf.length < SIM_CHUNK ? SIM_CHUNK / conf.length : 1;
+    long size = per_chunk * conf.length;
+    char *chunk = Malloc (size);
+    double start = _now ();
+    long sent = 0;
+    long i;
+    int rc = 0;
+
+    for (i = 0; i < size; i++)
+        chunk[i] = ((i + 1) % conf.length == 0) ? '\n' : 'a' + i % 26;
+
+    while (nlines > 0 && rc == 0) {
+        long n = nlines < per_chunk ? nlines : per_chunk;
+
+        if (conf.rate) {
+            double ahead = (double) sent / conf.rate - (_now () - start);
+            if (ahead > 0.001)
+                _sleep_ms ((long) (ahead * 1000));
+        }
+        rc = _send (h, fd, chunk, n * conf.length);
+        sent += n * conf.length;
+        nlines -= n;
+    }
+
+    Free ((void **) &chunk);
+    return (rc);
+}
+
+static void * _sim_output (void *arg)
+{
+    struct sim_host *h = arg;
+    int rc = _send_lines (h, h->fd, conf.lines);
+
+    if (rc == 0 && h->efd >= 0)
+        rc = _send_lines (h, h->efd, conf.errlines);
+
+    if (rc == 0 && h->trailer) {
+        char trailer[64];
+        snprintf (trailer, sizeof (trailer), "%s%d\n", RC_MAGIC, conf.rc);
+        _send (h, h->fd, trailer, strlen (trailer));
+    }
+
+    close (h->fd);
+    if (h->efd >= 0)
+        close (h->efd);
+    return (NULL);
+}
+
+/*
+ *  Read a protocol line of at most [len] - 1 bytes into [buf].
+ */
+static int _read_line (int fd, char *buf, int len)
+{
+    int i = 0;
+
+    while (i < len - 1) {
+        ssize_t n = read (fd, &buf[i], 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return (-1);
+        if (buf[i++] == '\n')
+            break;
+    }
+    buf[i] = '\0';
+    return (i);
+}
+
+/*
+ *  Minimal rcp sink: acknowledge every message and discard file data.
+ */
+static void * _sim_pcp (void *arg)
+{
+    struct sim_host *h = arg;
+    char line[4096];
+    char *buf = Malloc (SIM_CHUNK);
+
+    if (_send (h, h->fd, "", 1) < 0)
+        goto done;
+
+    while (_read_line (h->fd, line, sizeof (line)) > 0) {
+        if (line[0] == 'C') {
+            unsigned int mode;
+            long long size;
+
+            if (sscanf (line, "C%o %lld", &mode, &size) != 2)
+                break;
+            if (_send (h, h->fd, "", 1) < 0)
+                break;
+            size++;     /* data is followed by a NUL byte */
+            while (size > 0) {
+                ssize_t n = read (h->fd, buf,
+                                  size < SIM_CHUNK ? size : SIM_CHUNK);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    goto done;
+                size -= n;
+            }
+        }
+        else if (line[0] != 'T' && line[0] != 'D' && line[0] != 'E')
+            break;
+
+        if (_send (h, h->fd, "", 1) < 0)
+            break;
+    }
+done:
+    Free ((void **) &buf);
+    close (h->fd);
+    if (h->efd >= 0)
+        close (h->efd);
+    return (NULL);
+}
+
+static int
+sim(char *ahost, char *addr, char *luser, char *ruser, char *cmd,
+    int rank, int *fd2p, void **arg)
+{
+    struct sim_host *h;
+    int sv[2], ev[2];
+
+    if (conf.connect)
+        _sleep_ms (conf.connect);
+
+    /*  37 is prime to 100, so each run of 100 ranks has exactly
+     *   conf.fail failures */
+    if ((rank * 37) % 100 < conf.fail) {
+        err ("%p: %S: sim: connection refused\n", ahost);
+        return (-1);
+    }
+
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        err ("%p: %S: sim: socketpair: %m\n", ahost);
+        return (-1);
+    }
+
+    h = Malloc (sizeof (*h));
+    h->fd = sv[1];
+    h->efd = -1;
+    h->pcp = (strstr (cmd, " -z ") != NULL);
+    h->trailer = (strstr (cmd, RC_MAGIC) != NULL);
+    h->killed = 0;
+
+    if (fd2p) {
+        if (socketpair (AF_UNIX, SOCK_STREAM, 0, ev) < 0) {
+            err ("%p: %S: sim: socketpair: %m\n", ahost);
+            close (sv[0]);
+            close (sv[1]);
+            Free ((void **) &h);
+            return (-1);
+        }
+        *fd2p = ev[0];
+        h->efd = ev[1];
+    }
+
+    if ((errno = pthread_create (&h->thread, NULL,
+                                 h->pcp ? _sim_pcp : _sim_output, h))) {
+        err ("%p: %S: sim: pthread_create: %m\n", ahost);
+        errx ("%p: sim: unable to continue\n");
+    }
+
+    *arg = h;
+    return (sv[0]);
+}
+
+static int
+sim_destroy (void *arg)
+{
+    struct sim_host *h = arg;
+    int rc;
+
+    if (h == NULL)      /* connection failed */
+        return (0);
+
+    rc = h->trailer ? 0 : conf.rc;
+    pthread_join (h->thread, NULL);
+    Free ((void **) &h);
+
+    return (rc);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */